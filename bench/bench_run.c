@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/*
+ * Runs a shell over a script, the way bench/shell_bench.sh measures
+ * it: the script is its standard input, and its standard output goes
+ * to /dev/null or to a file. Prints the seconds it took, its peak RSS
+ * in kB (the largest of the shell and of the commands it waited for)
+ * and its exit status.
+ * Usage: bench/bench_run [-o OUTPUT] SCRIPT COMMAND [ARG]...
+ */
+
+int
+main(int argc, char *argv[])
+{
+	const char * output = "/dev/null";
+	struct timespec start, end;
+	struct rusage usage;
+	int opt, status, in, out;
+	pid_t pid;
+
+	while((opt = getopt(argc, argv, "+o:")) != -1)
+	{
+		if(opt != 'o')
+		{
+			fprintf(stderr, "Usage: %s [-o OUTPUT] SCRIPT COMMAND [ARG]...\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+		output = optarg;
+	}
+	if(argc - optind < 2)
+	{
+		fprintf(stderr, "Usage: %s [-o OUTPUT] SCRIPT COMMAND [ARG]...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	in = open(argv[optind], O_RDONLY | O_CLOEXEC);
+	out = open(output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if(in == -1 || out == -1)
+	{
+		perror(in == -1 ? argv[optind] : output);
+		return EXIT_FAILURE;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pid = fork();
+	if(pid == -1)
+	{
+		perror("fork");
+		return EXIT_FAILURE;
+	}
+	if(pid == 0)
+	{
+		dup2(in, STDIN_FILENO);
+		dup2(out, STDOUT_FILENO);
+		execvp(argv[optind + 1], &argv[optind + 1]);
+		perror(argv[optind + 1]);
+		_exit(127);
+	}
+	if(wait4(pid, &status, 0, &usage) == -1)
+	{
+		perror("wait4");
+		return EXIT_FAILURE;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("%.6f %ld %d\n", (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9, usage.ru_maxrss,
+	       WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+
+	return 0;
+}
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Iterations per second of a loop run by msh (repeat N { ... }) against
+# the same pipeline fed to msh N times by an outer loop.
+# Usage: sh bench/loop_bench.sh [iterations] [pipeline]
+
+MSH=${MSH:-./msh}
+N=${1:-100000}
+BODY=${2:-X=1}
+
+now() {
+	date +%s.%N
+}
+
+rate() {
+	echo "$N $1 $2" | awk '{ printf "%.0f iterations/s\n", $1 / ($3 - $2) }'
+}
+
+start=$(now)
+echo "repeat $N { $BODY }" | $MSH > /dev/null
+printf "repeat:        "
+rate "$start" "$(now)"
+
+start=$(now)
+awk -v n="$N" -v body="$BODY" 'BEGIN { for (i = 0; i < n; i++) print body }' | $MSH > /dev/null
+printf "external loop: "
+rate "$start" "$(now)"
@@ -0,0 +1,222 @@
+#define _GNU_SOURCE
+#include <msh.h>
+#include <msh_parse.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Lines parsed per second by libmshparse, with 1 to N threads each
+ * parsing its share of a corpus into its own sequence, and how close
+ * that is to scaling linearly.
+ * Usage: bench/parse_bench [-t MAXTHREADS] [-r ROUNDS] [corpus]
+ * Without a corpus (one input per line), a generated one is used.
+ */
+
+#define BENCH_LINES 200000
+
+struct corpus {
+	char ** lines;
+	size_t count;
+};
+
+struct worker {
+	pthread_t thread;
+	struct corpus * corpus;
+	size_t first, last; //the lines [first, last) it parses
+	int rounds;
+	size_t pipelines;
+	int failed;
+};
+
+//Helper functions:
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+corpus_add(struct corpus *c, char *line)
+{
+	if((c->count & (c->count - 1)) == 0)
+	{
+		char ** grown = realloc(c->lines, (c->count == 0 ? 1 : c->count * 2) * sizeof(char *));
+
+		if(grown == NULL) return -1;
+		c->lines = grown;
+	}
+	c->lines[c->count++] = line;
+	return 0;
+}
+
+//inputs shaped like those of scripts: sequences of short pipelines, assignments and background jobs
+static int
+corpus_generate(struct corpus *c, size_t count)
+{
+	const char * shapes[] = {
+		"ls -l /usr/bin | grep -v %zu | wc -l",
+		"X%zu=abc; echo $X%zu | tr a-z A-Z | cat",
+		"sleep %zu &",
+		"cat file%zu.txt | sort | uniq -c | sort -rn | head -n 10 ; echo done",
+		"find . -name *.c -newer stamp%zu | xargs grep -l main",
+		"echo $(date +%%s) %zu 1> out.txt ; cat < out.txt | tee copy.txt",
+	};
+
+	for(size_t i = 0; i < count; i++)
+	{
+		const char * shape = shapes[i % (sizeof(shapes) / sizeof(shapes[0]))];
+		char * line;
+
+		if(asprintf(&line, shape, i, i) == -1 || corpus_add(c, line) == -1) return -1;
+	}
+	return 0;
+}
+
+static int
+corpus_read(struct corpus *c, const char *path)
+{
+	FILE * f = fopen(path, "r");
+	char * line = NULL;
+	size_t cap = 0;
+	ssize_t len;
+
+	if(f == NULL) return -1;
+	while((len = getline(&line, &cap, f)) != -1)
+	{
+		if(len > 0 && line[len - 1] == '\n') line[--len] = '\0';
+		if(len == 0) continue;
+		if(corpus_add(c, line) == -1) break;
+		line = NULL;
+		cap = 0;
+	}
+	free(line);
+	fclose(f);
+	return 0;
+}
+
+//parse the worker's lines into a sequence of its own, and free what was parsed
+static void *
+worker_run(void *data)
+{
+	struct worker * w = data;
+	struct msh_sequence * s = msh_sequence_alloc();
+
+	if(s == NULL)
+	{
+		w->failed++;
+		return NULL;
+	}
+	for(int r = 0; r < w->rounds; r++)
+	{
+		for(size_t i = w->first; i < w->last; i++)
+		{
+			struct msh_pipeline * p;
+
+			if(msh_sequence_parse(w->corpus->lines[i], s) != 0) w->failed++;
+			while((p = msh_sequence_pipeline(s)) != NULL)
+			{
+				w->pipelines++;
+				msh_pipeline_free(p);
+			}
+		}
+	}
+	msh_sequence_free(s);
+	return NULL;
+}
+
+//the seconds it takes n threads to parse the corpus
+static double
+bench_run(struct corpus *c, int n, int rounds, size_t *pipelines, int *failed)
+{
+	struct worker * workers = calloc(n, sizeof(struct worker));
+	double start;
+
+	if(workers == NULL) return -1;
+	*pipelines = 0;
+	*failed = 0;
+
+	start = now();
+	for(int i = 0; i < n; i++)
+	{
+		workers[i] = (struct worker) { .corpus = c, .first = c->count * i / n, .last = c->count * (i + 1) / n, .rounds = rounds };
+		if(pthread_create(&workers[i].thread, NULL, worker_run, &workers[i]) != 0)
+		{
+			n = i;
+			*failed = 1;
+			break;
+		}
+	}
+	for(int i = 0; i < n; i++)
+	{
+		pthread_join(workers[i].thread, NULL);
+		*pipelines += workers[i].pipelines;
+		*failed += workers[i].failed;
+	}
+	start = now() - start;
+	free(workers);
+
+	return start;
+}
+//end of helper functions
+
+int
+main(int argc, char *argv[])
+{
+	struct corpus c = { 0 };
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int max = cpus > 0 ? cpus : 1, rounds = 1, opt;
+	double base = 0;
+
+	while((opt = getopt(argc, argv, "t:r:")) != -1)
+	{
+		if(opt == 't') max = atoi(optarg);
+		else if(opt == 'r') rounds = atoi(optarg);
+		else
+		{
+			fprintf(stderr, "Usage: %s [-t MAXTHREADS] [-r ROUNDS] [corpus]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if(max < 1 || rounds < 1)
+	{
+		fprintf(stderr, "%s: the threads and rounds must be positive\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if((optind < argc ? corpus_read(&c, argv[optind]) : corpus_generate(&c, BENCH_LINES)) == -1 || c.count == 0)
+	{
+		perror(optind < argc ? argv[optind] : "corpus");
+		return EXIT_FAILURE;
+	}
+
+	printf("%zu lines x %d rounds, %ld cpus\n", c.count, rounds, cpus);
+	printf("threads   lines/s   speedup  efficiency\n");
+	for(int n = 1; n <= max; n = n < max && n * 2 > max ? max : n * 2)
+	{
+		size_t pipelines;
+		int failed;
+		double secs = bench_run(&c, n, rounds, &pipelines, &failed);
+		double rate = c.count * rounds / secs;
+
+		if(secs < 0)
+		{
+			perror("bench");
+			return EXIT_FAILURE;
+		}
+		if(n == 1) base = rate;
+		printf("%7d %9.0f %9.2f %10.0f%%%s\n", n, rate, rate / base, 100 * rate / base / n, failed ? "  (parse errors)" : "");
+		if(n == max) break;
+	}
+
+	for(size_t i = 0; i < c.count; i++) free(c.lines[i]);
+	free(c.lines);
+
+	return 0;
+}
@@ -0,0 +1,90 @@
+#!/bin/sh
+# End-to-end workloads, each a script fed to the shell in batch mode
+# (on its standard input), run REPEAT times; the median run is shown.
+# Usage: sh bench/shell_bench.sh [shell]...    (./msh by default)
+# e.g.   sh bench/shell_bench.sh ./msh dash bash
+#
+# The workloads only use what msh and POSIX shells have in common:
+#   true      N `true` commands, one per line
+#   pipeline  head -c BYTES /dev/zero piped through STAGES cats
+#   jobs      JOBS `true &` background jobs, then `wait`
+#   redirect  N/2 lines of `echo x 1> file ; cat < file 1> /dev/null`
+#   sequence  lines of 16 `true`s separated by `;`, N commands in all
+#   latency   N/10 `date +%s%N`, the time between two being the
+#             latency of launching a command (p50 and p99)
+# Peak RSS is the largest of the shell and the commands it waited for.
+# msh runs with its environment: e.g. MSH_ZYGOTE=1 or MSH_NOOPT=1 to
+# compare its launch and pipeline strategies.
+#
+# msh's optimizer rewrites some of the workloads (see msh_optimize.h):
+#   true, sequence  each `true` runs in the shell, without a fork
+#   redirect        `echo x 1> file` runs in the shell, `cat` forks
+#   pipeline        every `cat` would be dropped, leaving `head` alone:
+#                   it runs with MSH_NOOPT=1, so that msh runs the
+#                   STAGES cats (as native splice stages) like others
+#   jobs, latency   not rewritten
+
+N=${N:-10000}
+JOBS=${JOBS:-500}
+BYTES=${BYTES:-1073741824}
+STAGES=${STAGES:-4}
+REPEAT=${REPEAT:-3}
+RUN=${RUN:-bench/bench_run}
+SHELLS=${*:-./msh}
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT INT TERM
+# msh keeps no history of a script on its standard input, unless
+# MSH_HISTORY is set: an empty one turns it off, whatever the caller's
+MSH_HISTORY=
+export MSH_HISTORY
+
+if [ ! -x "$RUN" ]; then
+	echo "$RUN is missing: make bench/bench_run" >&2
+	exit 1
+fi
+
+# the scripts, generated once so that every shell runs the same ones
+awk -v n="$N" 'BEGIN { for (i = 0; i < n; i++) print "true" }' > "$TMP/true"
+awk -v b="$BYTES" -v s="$STAGES" 'BEGIN { l = "head -c " b " /dev/zero"; for (i = 0; i < s; i++) l = l " | cat"; print l " 1> /dev/null" }' > "$TMP/pipeline"
+awk -v n="$JOBS" 'BEGIN { for (i = 0; i < n; i++) print "true &"; print "wait" }' > "$TMP/jobs"
+awk -v n="$N" -v f="$TMP/redirect.txt" 'BEGIN { for (i = 0; i < n / 2; i++) print "echo x 1> " f " ; cat < " f " 1> /dev/null" }' > "$TMP/redirect"
+awk -v n="$N" 'BEGIN { l = "true"; for (i = 1; i < 16; i++) l = l " ; true"; for (i = 0; i < n / 16; i++) print l }' > "$TMP/sequence"
+awk -v n="$N" 'BEGIN { for (i = 0; i < n / 10; i++) print "date +%s%N" }' > "$TMP/latency"
+
+# run_median WORKLOAD SHELL [OUTPUT]: prints "seconds rss_kb" of the median run
+run_median() {
+	i=0
+	: > "$TMP/runs"
+	while [ $i -lt "$REPEAT" ]; do
+		"$RUN" -o "${3:-/dev/null}" "$TMP/$1" "$2" >> "$TMP/runs" || return 1
+		i=$((i + 1))
+	done
+	sort -n "$TMP/runs" | awk -v r="$REPEAT" 'NR == int((r + 1) / 2) { print $1, $2; if ($3 != 0) print "exit status " $3 > "/dev/stderr" }'
+}
+
+# report SHELL WORKLOAD COUNT UNIT: the rate of COUNT UNITs
+report() {
+	set -- "$1" "$2" "$3" "$4" $(run_median "$2" "$1")
+	printf "%-10s %-10s %9.3f s %12.0f %-11s %8d kB\n" "$1" "$2" "$5" "$(echo "$3 $5" | awk '{ print $1 / $2 }')" "$4" "$6"
+}
+
+printf "%-10s %-10s %11s %24s %11s\n" shell workload time rate "peak RSS"
+for sh in $SHELLS; do
+	report "$sh" true "$N" commands/s
+	(MSH_NOOPT=1; export MSH_NOOPT; report "$sh" pipeline "$(echo "$BYTES" | awk '{ print $1 / 1048576 }')" MB/s)
+	report "$sh" jobs "$((JOBS + 1))" commands/s
+	report "$sh" redirect "$(( (N + 1) / 2 * 2 ))" commands/s
+	report "$sh" sequence "$(( (N + 15) / 16 * 16 ))" commands/s
+
+	# the latency is measured on the last of the runs
+	set -- $(run_median latency "$sh" "$TMP/stamps")
+	awk 'NR > 1 { print ($1 - prev) / 1e6 } { prev = $1 }' "$TMP/stamps" | sort -n | awk -v sh="$sh" -v rss="$2" '
+		{ d[NR] = $1 }
+		END {
+			if (NR == 0) exit
+			p50 = sprintf("p50 %.3f ms", d[int(NR * 0.5 + 0.5)])
+			p99 = sprintf("p99 %.3f ms", d[int(NR * 0.99 + 0.5)])
+			printf "%-10s %-10s %11s %24s %8d kB\n", sh, "latency", p50, p99, rss
+		}'
+done
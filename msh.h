@@ -61,6 +61,10 @@ typedef enum {
 	MSH_ERR_SEQ_REDIR_OR_BACKGROUND_MISSING_CMD = -11,
 	/* The sequence still has pipelines, cannot add more  */
 	MSH_ERR_SEQ_BUSY = -12,
+	/* Provided both a pipe from the previous command *and* a stdin redirection  */
+	MSH_ERR_REDUNDANT_PIPE_INPUT = -13,
+	/* More than MSH_MAXBACKGROUND + 1 pipelines in a sequence */
+	MSH_ERR_TOO_MANY_PIPELINES = -14,
 } msh_err_t;
 
 /* Return a human-readable string corresponding to an msh error */
@@ -80,7 +84,9 @@ msh_pipeline_err2str(msh_err_t e)
 		"Could not execute program",
 		"Attempted to redirect output to pipe and to file redirection",
 		"A pipeline has a redirection or &, but no command",
-		"Attempted to parse into sequence, when it still has pipelines"
+		"Attempted to parse into sequence, when it still has pipelines",
+		"Attempted to redirect input from pipe and from file redirection",
+		"Too many pipelines in sequence"
 	};
 
 	return strs[-e];
@@ -99,3 +105,24 @@ void msh_init(void);
  * only return after the pipeline completes.
  */
 void msh_execute(struct msh_pipeline *p);
+
+/**
+ * `msh_execute_fds` is `msh_execute` for a pipeline whose standard
+ * output and error go to descriptors of its own, as for `$(...)` and
+ * `memo`, instead of the shell's: its last command (or the builtin
+ * printing) writes to `out`, and all its commands write their errors
+ * to `err`, unless they are redirected. The shell's own descriptors
+ * are left as they are. Such a pipeline runs like in a subshell:
+ * `exit` ends it, not the shell.
+ *
+ * - `@return` - `1` if the pipeline ran `exit`, `0` otherwise.
+ */
+int msh_execute_fds(struct msh_pipeline *p, int out, int err);
+
+/**
+ * `msh_execute_status` returns the exit status of the last pipeline
+ * run in the foreground: the exit code of its last command, or `128`
+ * plus the signal that terminated or stopped it. Builtins succeed
+ * with `0`, and pipelines run in the background too.
+ */
+int msh_execute_status(void);
@@ -0,0 +1,499 @@
+#define _GNU_SOURCE
+#include <msh.h>
+#include <msh_compile.h>
+#include <msh_parse.h>
+#include <msh_parse_internal.h>
+#include <msh_loop.h>
+#include <msh_util.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MSHC_MAGIC "MSHC"
+#define MSHC_VERSION 1
+#define MSHC_ORDER 0x01020304 //reads differently on a machine of the other byte order
+
+//followed by the lines, pipelines, words, commands and strings tables, in that order. A line's pipelines
+//follow those of the line before, and likewise for the commands of pipelines and the words of commands.
+struct mshc_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t order;
+	uint32_t size; //of the whole file
+	uint64_t checksum; //FNV-1a of everything after the header
+	uint32_t nlines;
+	uint32_t npipelines;
+	uint32_t ncommands;
+	uint32_t nwords; //each the offset of a string
+	uint32_t strings_size;
+	uint32_t unused;
+};
+
+typedef enum {
+	MSHC_SEQUENCE, //count pipelines
+	MSHC_LOOP, //the line at offset text, run by msh_loop_run
+} mshc_line_t;
+
+struct mshc_line {
+	uint16_t type;
+	uint16_t count;
+	uint32_t text;
+};
+
+struct mshc_pipeline {
+	uint32_t input; //the string typed, for jobs
+	uint16_t background;
+	uint16_t count; //of commands
+};
+
+//a command is the number of its words, the program first
+
+//a table being compiled
+struct table {
+	char * buf;
+	size_t len;
+	size_t cap;
+};
+
+struct compiler {
+	struct table lines, pipelines, commands, words, strings;
+	uint32_t * index; //offset + 1 of the strings added, by hash, 0 for an empty slot
+	size_t index_cap;
+	size_t nstrings;
+};
+
+//a compiled script, mapped and checked
+struct mshc_file {
+	const struct mshc_header * h;
+	const struct mshc_line * lines;
+	const struct mshc_pipeline * pipelines;
+	const uint32_t * words;
+	const uint16_t * commands;
+	const char * strings;
+};
+
+//Helper functions:
+
+
+static int
+table_add(struct table *t, const void *rec, size_t size)
+{
+	if(t->len + size > t->cap)
+	{
+		size_t cap = t->cap == 0 ? 256 : t->cap * 2;
+		char * grown;
+
+		while(cap < t->len + size) cap *= 2;
+		grown = realloc(t->buf, cap);
+		if(grown == NULL) return -1;
+		t->buf = grown;
+		t->cap = cap;
+	}
+	memcpy(t->buf + t->len, rec, size);
+	t->len += size;
+
+	return 0;
+}
+
+//the offset of a string in the strings table, which is added if it isn't there yet
+static int
+string_add(struct compiler *c, const char *str, uint32_t *off)
+{
+	size_t len = strlen(str) + 1, slot;
+
+	//at most half full, so that probes stay short
+	if((c->nstrings + 1) * 2 > c->index_cap)
+	{
+		size_t cap = c->index_cap == 0 ? 1024 : c->index_cap * 2;
+		uint32_t * index = calloc(cap, sizeof(uint32_t));
+
+		if(index == NULL) return -1;
+		for(size_t i = 0; i < c->index_cap; i++)
+		{
+			const char * s = c->strings.buf + c->index[i] - 1;
+
+			if(c->index[i] == 0) continue;
+			slot = msh_hash(MSH_HASH_INIT, s, strlen(s)) & (cap - 1);
+			while(index[slot] != 0) slot = (slot + 1) & (cap - 1);
+			index[slot] = c->index[i];
+		}
+		free(c->index);
+		c->index = index;
+		c->index_cap = cap;
+	}
+
+	slot = msh_hash(MSH_HASH_INIT, str, len - 1) & (c->index_cap - 1);
+	for(; c->index[slot] != 0; slot = (slot + 1) & (c->index_cap - 1))
+	{
+		if(strcmp(c->strings.buf + c->index[slot] - 1, str) == 0)
+		{
+			*off = c->index[slot] - 1;
+			return 0;
+		}
+	}
+
+	if(c->strings.len + len >= UINT32_MAX) return -1;
+	*off = c->strings.len;
+	if(table_add(&c->strings, str, len) == -1) return -1;
+	c->index[slot] = *off + 1;
+	c->nstrings++;
+
+	return 0;
+}
+
+static int
+pipeline_compile(struct compiler *c, struct msh_pipeline *p)
+{
+	struct mshc_pipeline rec = { .background = p->background_pipe };
+
+	if(string_add(c, p->pipe, &rec.input) == -1) return -1;
+	for(int i = 0; i < MSH_MAXCMNDS && p->pipeline_commands[i] != NULL; i++)
+	{
+		char ** args = p->pipeline_commands[i]->comm_arguments;
+		uint16_t count = 0;
+
+		for(; args[count] != NULL; count++)
+		{
+			uint32_t off;
+
+			if(string_add(c, args[count], &off) == -1 || table_add(&c->words, &off, sizeof(off)) == -1) return -1;
+		}
+		if(table_add(&c->commands, &count, sizeof(count)) == -1) return -1;
+		rec.count++;
+	}
+	return table_add(&c->pipelines, &rec, sizeof(rec));
+}
+
+//compile a line: a loop is kept as it is, a sequence is parsed into its pipelines
+static msh_err_t
+line_compile(struct compiler *c, char *line, struct msh_sequence *s)
+{
+	struct mshc_line rec = { .type = MSHC_SEQUENCE };
+	msh_err_t err;
+
+	if(msh_loop_line(line))
+	{
+		rec.type = MSHC_LOOP;
+		if(string_add(c, line, &rec.text) == -1) return MSH_ERR_NOMEM;
+		return table_add(&c->lines, &rec, sizeof(rec)) == -1 ? MSH_ERR_NOMEM : 0;
+	}
+
+	err = msh_sequence_parse(line, s);
+	if(err != 0) return err;
+	for(; s->cur < s->seq_pipeline_count; s->cur++)
+	{
+		struct msh_pipeline * p = s->sequence_pipelines[s->cur];
+
+		s->sequence_pipelines[s->cur] = NULL;
+		if(pipeline_compile(c, p) == -1) err = MSH_ERR_NOMEM;
+		msh_pipeline_free(p);
+		if(err != 0) return err;
+		rec.count++;
+	}
+	if(rec.count == 0) return 0;
+
+	return table_add(&c->lines, &rec, sizeof(rec)) == -1 ? MSH_ERR_NOMEM : 0;
+}
+
+
+//write the tables, to a temporary file first so that a compiled script is never seen half written
+static int
+compiler_write(struct compiler *c, const char *out)
+{
+	struct table * tables[] = { &c->lines, &c->pipelines, &c->words, &c->commands, &c->strings };
+	struct mshc_header h = {
+		.version = MSHC_VERSION,
+		.order = MSHC_ORDER,
+		.checksum = MSH_HASH_INIT,
+		.nlines = c->lines.len / sizeof(struct mshc_line),
+		.npipelines = c->pipelines.len / sizeof(struct mshc_pipeline),
+		.ncommands = c->commands.len / sizeof(uint16_t),
+		.nwords = c->words.len / sizeof(uint32_t),
+		.strings_size = c->strings.len,
+	};
+	uint64_t size = sizeof(h);
+	char * tmp;
+	int fd, ret = 0;
+
+	memcpy(h.magic, MSHC_MAGIC, sizeof(h.magic));
+	for(size_t i = 0; i < sizeof(tables) / sizeof(tables[0]); i++)
+	{
+		h.checksum = msh_hash(h.checksum, tables[i]->buf, tables[i]->len);
+		size += tables[i]->len;
+	}
+	if(size > UINT32_MAX)
+	{
+		errno = EFBIG;
+		return -1;
+	}
+	h.size = size;
+
+	if(asprintf(&tmp, "%s.tmp.%d", out, getpid()) == -1) return -1;
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if(fd == -1)
+	{
+		free(tmp);
+		return -1;
+	}
+	ret = msh_write_all(fd, (char *)&h, sizeof(h));
+	for(size_t i = 0; ret == 0 && i < sizeof(tables) / sizeof(tables[0]); i++) ret = msh_write_all(fd, tables[i]->buf, tables[i]->len);
+	if(close(fd) == -1 || ret == -1 || rename(tmp, out) == -1)
+	{
+		int saved = errno;
+
+		unlink(tmp);
+		errno = saved;
+		ret = -1;
+	}
+	free(tmp);
+
+	return ret;
+}
+
+//tells if the string at off is in the strings table
+static int
+string_valid(const struct mshc_file *f, uint32_t off)
+{
+	return off < f->h->strings_size;
+}
+
+//check everything the compiled script refers to before any of it is used
+static const char *
+file_check(struct mshc_file *f, const char *map, size_t size)
+{
+	const struct mshc_header * h = (const struct mshc_header *)map;
+	uint64_t expected = sizeof(*h), pipelines = 0, commands = 0, words = 0;
+
+	if(size < sizeof(*h) || memcmp(h->magic, MSHC_MAGIC, sizeof(h->magic)) != 0) return "not a compiled script";
+	if(h->version != MSHC_VERSION || h->order != MSHC_ORDER) return "compiled by another version of msh, or for another machine";
+
+	expected += (uint64_t)h->nlines * sizeof(struct mshc_line) + (uint64_t)h->npipelines * sizeof(struct mshc_pipeline);
+	expected += (uint64_t)h->nwords * sizeof(uint32_t) + (uint64_t)h->ncommands * sizeof(uint16_t) + h->strings_size;
+	if(h->size != size || expected != size) return "truncated";
+	if(msh_hash(MSH_HASH_INIT, map + sizeof(*h), size - sizeof(*h)) != h->checksum) return "corrupted";
+
+	f->h = h;
+	f->lines = (const struct mshc_line *)(map + sizeof(*h));
+	f->pipelines = (const struct mshc_pipeline *)(f->lines + h->nlines);
+	f->words = (const uint32_t *)(f->pipelines + h->npipelines);
+	f->commands = (const uint16_t *)(f->words + h->nwords);
+	f->strings = (const char *)(f->commands + h->ncommands);
+
+	//the checksum matches, so these only fail for files that weren't written by msh_compile
+	if(h->strings_size > 0 && f->strings[h->strings_size - 1] != '\0') return "invalid";
+	for(uint32_t i = 0; i < h->nlines; i++)
+	{
+		const struct mshc_line * l = &f->lines[i];
+
+		if(l->type == MSHC_LOOP && string_valid(f, l->text)) continue;
+		if(l->type != MSHC_SEQUENCE || l->count == 0 || l->count > MSH_MAXBACKGROUND + 1) return "invalid";
+		pipelines += l->count;
+	}
+	for(uint32_t i = 0; i < h->npipelines; i++)
+	{
+		const struct mshc_pipeline * p = &f->pipelines[i];
+
+		if(!string_valid(f, p->input) || p->count == 0 || p->count > MSH_MAXCMNDS) return "invalid";
+		commands += p->count;
+	}
+	for(uint32_t i = 0; i < h->ncommands; i++)
+	{
+		if(f->commands[i] == 0 || f->commands[i] > MSH_MAXARGS + 1) return "invalid";
+		words += f->commands[i];
+	}
+	for(uint32_t i = 0; i < h->nwords; i++)
+	{
+		if(!string_valid(f, f->words[i])) return "invalid";
+	}
+	//each table has as many records as the one before refers to
+	if(pipelines != h->npipelines || commands != h->ncommands || words != h->nwords) return "invalid";
+
+	return NULL;
+}
+
+//the position reached in each table of a compiled script
+struct cursor {
+	uint32_t pipeline;
+	uint32_t command;
+	uint32_t word;
+};
+
+//build the next pipeline of a compiled script, like the parser does
+static struct msh_pipeline *
+pipeline_load(const struct mshc_file *f, struct cursor *at)
+{
+	const struct mshc_pipeline * rec = &f->pipelines[at->pipeline++];
+	struct msh_pipeline * p = calloc(1, sizeof(struct msh_pipeline));
+
+	if(p == NULL) return NULL;
+	p->background_pipe = rec->background != 0;
+	p->pipeline_comm_count = rec->count + 1; //counted from 1 by the parser
+	p->pipe = strdup(f->strings + rec->input);
+	if(p->pipe == NULL) goto fail;
+
+	for(uint32_t i = 0; i < rec->count; i++)
+	{
+		uint16_t count = f->commands[at->command++];
+		const uint32_t * words = f->words + at->word;
+		struct msh_command * c = calloc(1, sizeof(struct msh_command));
+
+		if(c == NULL) goto fail;
+		p->pipeline_commands[i] = c;
+		c->comm_args_cap = MSH_MAXARGS + 2;
+		c->comm_arguments = calloc(c->comm_args_cap, sizeof(char *));
+		if(c->comm_arguments == NULL) goto fail;
+		c->command_last = i + 1 == rec->count;
+		c->comm_args_count = count + 1; //counted from 1 by the parser
+		at->word += count;
+		for(uint16_t k = 0; k < count; k++)
+		{
+			c->comm_arguments[k] = strdup(f->strings + words[k]);
+			if(c->comm_arguments[k] == NULL) goto fail;
+		}
+		c->command = strdup(c->comm_arguments[0]);
+		if(c->command == NULL) goto fail;
+	}
+	return p;
+fail:
+	msh_pipeline_free(p);
+	return NULL;
+}
+//end of helper functions
+
+int
+msh_compile(const char *script, const char *out)
+{
+	struct compiler c = { 0 };
+	struct msh_sequence * s = msh_sequence_alloc();
+	FILE * in = fopen(script, "re");
+	char * line = NULL;
+	size_t cap = 0;
+	ssize_t len;
+	int lineno = 0, ret = 0;
+
+	if(in == NULL || s == NULL)
+	{
+		fprintf(stderr, "msh: %s: %s\n", script, strerror(in == NULL ? errno : ENOMEM));
+		if(in != NULL) fclose(in);
+		if(s != NULL) msh_sequence_free(s);
+		return -1;
+	}
+
+	while((len = getline(&line, &cap, in)) != -1)
+	{
+		msh_err_t err;
+
+		lineno++;
+		if(len > 0 && line[len - 1] == '\n') line[--len] = '\0';
+		if(len == 0) break; //the shell stops at an empty line
+
+		err = line_compile(&c, line, s);
+		if(err != 0)
+		{
+			size_t pos = 0;
+
+			if(msh_sequence_error(s, NULL) == err) msh_sequence_error(s, &pos);
+			fprintf(stderr, "msh: %s:%d:%zu: %s\n", script, lineno, pos + 1, msh_pipeline_err2str(err));
+			ret = -1;
+			break;
+		}
+	}
+	if(ret == 0 && ferror(in))
+	{
+		fprintf(stderr, "msh: %s: %s\n", script, strerror(errno));
+		ret = -1;
+	}
+	if(ret == 0 && compiler_write(&c, out) == -1)
+	{
+		fprintf(stderr, "msh: %s: %s\n", out, strerror(errno));
+		ret = -1;
+	}
+
+	free(line);
+	fclose(in);
+	msh_sequence_free(s);
+	free(c.lines.buf);
+	free(c.pipelines.buf);
+	free(c.commands.buf);
+	free(c.words.buf);
+	free(c.strings.buf);
+	free(c.index);
+
+	return ret;
+}
+
+int
+msh_compile_run(const char *file, struct msh_sequence *s)
+{
+	struct mshc_file f;
+	struct cursor at = { 0 };
+	struct stat st;
+	const char * err;
+	char * map;
+	int fd = open(file, O_RDONLY | O_CLOEXEC), ret = 0;
+
+	if(fd == -1 || fstat(fd, &st) == -1)
+	{
+		fprintf(stderr, "msh: %s: %s\n", file, strerror(errno));
+		if(fd != -1) close(fd);
+		return -1;
+	}
+	map = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	close(fd);
+	if(map == MAP_FAILED)
+	{
+		fprintf(stderr, "msh: %s: %s\n", file, st.st_size > 0 ? strerror(errno) : "not a compiled script");
+		return -1;
+	}
+	err = file_check(&f, map, st.st_size);
+	if(err != NULL)
+	{
+		fprintf(stderr, "msh: %s: %s\n", file, err);
+		munmap(map, st.st_size);
+		return -1;
+	}
+
+	for(uint32_t i = 0; ret == 0 && i < f.h->nlines; i++)
+	{
+		const struct mshc_line * l = &f.lines[i];
+		struct msh_pipeline * p;
+
+		if(l->type == MSHC_LOOP)
+		{
+			char * line = strdup(f.strings + l->text); //the script is mapped read only
+
+			if(line == NULL) ret = -1;
+			else msh_loop_run(line);
+			free(line);
+			continue;
+		}
+
+		for(uint16_t k = 0; ret == 0 && k < l->count; k++)
+		{
+			p = pipeline_load(&f, &at);
+			if(p == NULL) ret = -1;
+			else if(msh_sequence_append(s, p) != 0)
+			{
+				msh_pipeline_free(p);
+				ret = -1;
+			}
+		}
+		//the line runs whole or not at all
+		while((p = msh_sequence_pipeline(s)) != NULL)
+		{
+			if(ret == 0) msh_execute(p);
+			else msh_pipeline_free(p);
+		}
+		if(msh_sequence_error(s, NULL) != 0) fprintf(stderr, "msh: %s: %s\n", file, msh_pipeline_err2str(msh_sequence_error(s, NULL)));
+	}
+	if(ret == -1) fprintf(stderr, "msh: %s: %s\n", file, msh_pipeline_err2str(MSH_ERR_NOMEM));
+	munmap(map, st.st_size);
+
+	return ret;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+/***
+ * Compiled scripts. `msh --compile script.msh -o script.mshc` parses
+ * a script once, and writes its sequences, pipelines and commands to
+ * a file that `msh script.mshc` runs without reading or splitting
+ * any of its lines again.
+ *
+ * The file is a header followed by tables of fixed size records: the
+ * lines, their pipelines, then the words and word counts of the
+ * commands, each table in the order of the one before it. Words refer
+ * to a table of NUL terminated strings by offset, and each string is
+ * stored once. Nothing in it is a pointer, so it is mapped as it is
+ * and used in place. Before a compiled script is run, its header
+ * (magic, version, byte order, size and checksum) and every count and
+ * offset in it are checked: a truncated, corrupted or foreign file is
+ * refused instead of being run.
+ *
+ * Words are stored as they were typed: `$` references and globs are
+ * expanded as their pipeline runs, like for a script that isn't
+ * compiled. Loops are kept as lines, which `msh_loop_run` parses once
+ * each time they run. Like when the shell reads a script, an empty
+ * line ends it.
+ */
+
+struct msh_sequence;
+
+/**
+ * `msh_compile` compiles a script, printing its errors on `stderr`.
+ *
+ * - `@script` - the script's path.
+ * - `@out` - the path of the compiled script, replaced only once it
+ *     is written whole.
+ * - `@return` - `0` on success, `-1` if the script has an error or
+ *     couldn't be read or written.
+ */
+int msh_compile(const char *script, const char *out);
+
+/**
+ * `msh_compile_run` runs a compiled script.
+ *
+ * - `@file` - the compiled script's path.
+ * - `@s` - the sequence into which its pipelines are queued, with its
+ *     expansion function set.
+ * - `@return` - `0` once it ran, `-1` if it couldn't be loaded (the
+ *     error is printed).
+ */
+int msh_compile_run(const char *file, struct msh_sequence *s);
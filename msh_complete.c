@@ -0,0 +1,318 @@
+#define _GNU_SOURCE
+#include <msh_complete.h>
+#include <msh_history.h>
+#include <msh_dircache.h>
+#include <msh_var.h>
+#include <ptrie.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#define MSH_MAXPATHDIRS 64
+#define MSH_MAXCOMPLETIONS 256
+#define MSH_MAXSEARCHED 32
+
+//the programs in PATH, NULL until the thread scanned it
+static struct ptrie * path_trie;
+static pthread_rwlock_t path_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+//the PATH directories, watched with inotify
+static char * path_dirs[MSH_MAXPATHDIRS];
+static int path_count;
+
+//the completions of a word, added as whole lines
+struct completions {
+	linenoiseCompletions * lc;
+	const char * line; //the line before the word
+	size_t line_len;
+};
+
+//Helper functions:
+
+static int
+is_program(int dirfd, const char *name)
+{
+	struct stat st;
+
+	if(fstatat(dirfd, name, &st, 0) == -1 || !S_ISREG(st.st_mode)) return 0;
+	return faccessat(dirfd, name, X_OK, 0) == 0;
+}
+
+//is name a program in any of the PATH directories?
+static int
+path_has_program(const char *name)
+{
+	for(int i = 0; i < path_count; i++)
+	{
+		int dirfd = open(path_dirs[i], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		int found;
+
+		if(dirfd == -1) continue;
+		found = is_program(dirfd, name);
+		close(dirfd);
+		if(found) return 1;
+	}
+	return 0;
+}
+
+static void
+path_scan(struct ptrie *pt, const char *dir)
+{
+	DIR * d = opendir(dir);
+	struct dirent * ent;
+
+	if(d == NULL) return;
+	while((ent = readdir(d)) != NULL)
+	{
+		if(ent->d_name[0] == '.' || ent->d_type == DT_DIR) continue;
+		//the same program in two directories is there once
+		if(ptrie_count(pt, ent->d_name) == 0 && is_program(dirfd(d), ent->d_name)) ptrie_add(pt, ent->d_name);
+	}
+	closedir(d);
+}
+
+//a program was added, removed, renamed or chmod'ed in a PATH directory
+static void
+path_update(const char *name)
+{
+	int found = path_has_program(name);
+
+	pthread_rwlock_wrlock(&path_lock);
+	if(found && ptrie_count(path_trie, name) == 0) ptrie_add(path_trie, name);
+	else if(!found) ptrie_remove(path_trie, name);
+	pthread_rwlock_unlock(&path_lock);
+}
+
+static void *
+path_thread(void *arg)
+{
+	char * path = arg, * save = NULL;
+	struct ptrie * pt;
+	int watch_fd;
+	char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t n;
+
+	//watch the directories before scanning them, not to miss a program
+	watch_fd = inotify_init1(IN_CLOEXEC);
+	for(char * dir = strtok_r(path, ":", &save); dir != NULL && path_count < MSH_MAXPATHDIRS; dir = strtok_r(NULL, ":", &save))
+	{
+		if(dir[0] != '/') continue; //relative to the current directory, which changes
+		if(watch_fd != -1) inotify_add_watch(watch_fd, dir, IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_ONLYDIR);
+		path_dirs[path_count++] = dir;
+	}
+
+	pt = ptrie_allocate();
+	if(pt == NULL) return NULL;
+	for(int i = 0; i < path_count; i++) path_scan(pt, path_dirs[i]);
+
+	pthread_rwlock_wrlock(&path_lock);
+	path_trie = pt;
+	pthread_rwlock_unlock(&path_lock);
+
+	if(watch_fd == -1) return NULL;
+	while((n = read(watch_fd, events, sizeof(events))) > 0)
+	{
+		for(char * e = events; e < events + n; e += sizeof(struct inotify_event) + ((struct inotify_event *)e)->len)
+		{
+			struct inotify_event * ev = (struct inotify_event *)e;
+
+			if(ev->len == 0 || ev->name[0] == '.' || (ev->mask & IN_ISDIR)) continue;
+			path_update(ev->name);
+		}
+	}
+
+	return NULL;
+}
+
+//where the word being typed starts, and if it is a program
+static size_t
+word_start(const char *buf, int *is_command)
+{
+	size_t start = strlen(buf), before;
+
+	while(start > 0 && !isspace((unsigned char)buf[start - 1]) && buf[start - 1] != '|' && buf[start - 1] != ';') start--;
+
+	before = start;
+	while(before > 0 && isspace((unsigned char)buf[before - 1])) before--;
+	*is_command = before == 0 || buf[before - 1] == '|' || buf[before - 1] == ';';
+
+	return start;
+}
+
+static void
+completion_add(const char *str, int count, void *data)
+{
+	struct completions * c = data;
+	size_t len = c->line_len + strlen(str) + 1;
+	char * line = malloc(len);
+
+	(void) count;
+	if(line == NULL) return;
+	memcpy(line, c->line, c->line_len);
+	strcpy(line + c->line_len, str);
+	linenoiseAddCompletion(c->lc, line);
+	free(line);
+}
+//calls fn with the paths the word completes to (directories end with a
+//'/'), as ptrie_foreach does, and returns how many there are
+static int
+files_foreach(const char *word, int max, ptrie_foreach_fn_t fn, void *data)
+{
+	const char * slash = strrchr(word, '/');
+	const char * base = slash == NULL ? word : slash + 1;
+	size_t dir_len = base - word, end;
+	char dir[PATH_MAX], path[PATH_MAX];
+	char * home = NULL;
+	struct msh_dir * d;
+	int n = 0;
+
+	//on the input thread: the shell's thread may be changing the variables
+	if(word[0] == '~' && word[1] == '/') home = msh_var_copy("HOME");
+
+	if(dir_len == 0) strcpy(dir, ".");
+	else if(home != NULL) snprintf(dir, sizeof(dir), "%s%.*s", home, (int)dir_len - 1, word + 1);
+	else snprintf(dir, sizeof(dir), "%.*s", (int)dir_len, word);
+	free(home);
+
+	d = msh_dircache_get(dir);
+	if(d == NULL) return 0;
+
+	for(size_t i = msh_dir_find(d, base, &end); i < end && n < max; i++)
+	{
+		const char * name = msh_dir_name(d, i);
+
+		if(name[0] == '.' && base[0] != '.') continue; //hidden, unless asked for
+		snprintf(path, sizeof(path), "%.*s%s%s", (int)dir_len, word, name, msh_dir_isdir(d, i) ? "/" : "");
+		fn(path, 1, data);
+		n++;
+	}
+
+	return n;
+}
+
+static void
+file_keep(const char *str, int count, void *data)
+{
+	char ** kept = data;
+
+	(void) count;
+	if(*kept == NULL) *kept = strdup(str);
+}
+//end of helper functions
+
+int
+msh_complete_init(void)
+{
+	char * path = getenv("PATH");
+	pthread_t scan;
+
+	if(path == NULL || (path = strdup(path)) == NULL) return -1;
+	if(pthread_create(&scan, NULL, path_thread, path) != 0)
+	{
+		free(path);
+		return -1;
+	}
+	pthread_detach(scan);
+
+	return 0;
+}
+
+void
+msh_complete(const char *buf, linenoiseCompletions *lc)
+{
+	int is_command;
+	size_t start = word_start(buf, &is_command);
+	struct completions c = { .lc = lc, .line = buf, .line_len = start };
+
+	//?text: <TAB> goes through the lines containing text, the most recent first
+	if(buf[0] == '?')
+	{
+		char * lines[MSH_MAXSEARCHED];
+		int n = msh_history_search(buf + 1, lines, MSH_MAXSEARCHED);
+
+		for(int i = 0; i < n; i++)
+		{
+			linenoiseAddCompletion(lc, lines[i]);
+			free(lines[i]);
+		}
+		return;
+	}
+
+	//arguments, and programs given by their path, are files
+	if(!is_command || strchr(buf + start, '/') != NULL)
+	{
+		files_foreach(buf + start, MSH_MAXCOMPLETIONS, completion_add, &c);
+		return;
+	}
+	if(buf[start] == '\0') return;
+
+	pthread_rwlock_rdlock(&path_lock);
+	if(path_trie != NULL) ptrie_foreach(path_trie, buf + start, MSH_MAXCOMPLETIONS, completion_add, &c);
+	pthread_rwlock_unlock(&path_lock);
+}
+
+char *
+msh_hint(const char *buf, int *color, int *bold)
+{
+	int is_command;
+	size_t start = word_start(buf, &is_command);
+	const char * word = buf + start;
+	char * completed, * hint = NULL;
+
+	*color = 90; //grey
+	*bold = 0;
+
+	//?text: the most recent line containing text
+	if(buf[0] == '?')
+	{
+		char * line;
+
+		if(msh_history_search(buf + 1, &line, 1) == 0) return NULL;
+		if(asprintf(&hint, " => %s", line) == -1) hint = NULL;
+		free(line);
+		return hint;
+	}
+
+	//a line typed before, or else a program
+	completed = msh_history_hint(buf);
+	if(completed != NULL)
+	{
+		hint = strdup(completed + strlen(buf));
+		free(completed);
+		return hint;
+	}
+
+	if(*word == '\0') return NULL;
+
+	//the file, if it is the only one the word completes to
+	if(!is_command || strchr(word, '/') != NULL)
+	{
+		completed = NULL;
+		if(files_foreach(word, 2, file_keep, &completed) == 1) hint = strdup(completed + strlen(word));
+		free(completed);
+		return hint;
+	}
+
+	pthread_rwlock_rdlock(&path_lock);
+	if(path_trie != NULL) completed = ptrie_autocomplete(path_trie, word);
+	pthread_rwlock_unlock(&path_lock);
+
+	if(completed != NULL && strlen(completed) > strlen(word)) hint = strdup(completed + strlen(word));
+	free(completed);
+
+	return hint;
+}
+
+void
+msh_hint_free(void *hint)
+{
+	free(hint);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <linenoise.h>
+
+/***
+ * Autocompletion for `linenoise`. Words are delimited as the parser
+ * does: pipelines are separated by `;`, commands by `|`, and words by
+ * spaces. The first word of each command completes to the programs in
+ * the directories of `PATH`, and the other words (or programs given
+ * with a `/`) complete to files, using `msh_dircache`.
+ *
+ * The programs are kept in a `ptrie` that is built by a thread when
+ * the shell starts, so the first prompt doesn't wait for `PATH` to be
+ * read. The thread then follows programs being added to and removed
+ * from `PATH` directories with `inotify`. Completing only takes a
+ * walk down the trie.
+ *
+ * A line starting with `?` searches the history instead: the hint
+ * shows the most recent line containing the text after the `?`, and
+ * `<TAB>` goes through the lines containing it, replacing the line
+ * being typed with them.
+ */
+
+/**
+ * `msh_complete_init` starts the thread building the `PATH` trie. It
+ * must be called after `msh_init`, so the thread doesn't get the
+ * shell's signals.
+ *
+ * - `@return` - `0` on success, `-1` if the thread couldn't start
+ *     (completion then doesn't know any program).
+ */
+int msh_complete_init(void);
+
+/**
+ * `msh_complete` is the `linenoise` completion callback (`<TAB>`): it
+ * adds every completion of the word being typed.
+ *
+ * - `@buf` - the line typed so far.
+ * - `@lc` - where to add the completed lines.
+ */
+void msh_complete(const char *buf, linenoiseCompletions *lc);
+
+/**
+ * `msh_hint` is the `linenoise` hints callback: it suggests the rest
+ * of the line from the history (see `msh_history_hint`), or else the
+ * rest of the program being typed.
+ *
+ * - `@buf` - the line typed so far.
+ * - `@color` - set to the color of the hint.
+ * - `@bold` - set to `1` if the hint is bold.
+ * - `@return` - the hint, to be freed with `msh_hint_free`, or `NULL`.
+ */
+char *msh_hint(const char *buf, int *color, int *bold);
+
+/**
+ * `msh_hint_free` frees a hint returned by `msh_hint`.
+ */
+void msh_hint_free(void *hint);
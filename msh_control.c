@@ -0,0 +1,372 @@
+#define _GNU_SOURCE
+#include <msh.h>
+#include <msh_control.h>
+#include <msh_job.h>
+#include <msh_sched.h>
+#include <msh_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define MSH_CONTROL_LINE 1024
+
+//a connected client
+struct client {
+	int fd;
+	char line[MSH_CONTROL_LINE]; //what was read of the line being sent
+	size_t len;
+	int events; //1 if it asked for the job events
+	struct client * next;
+};
+
+static int listen_fd = -1;
+static char * socket_path;
+static pid_t shell_pid; //the socket is only removed by the shell, not by children calling exit
+static struct client * clients;
+static struct timespec started;
+static unsigned long jobs_done, jobs_failed;
+
+//Helper functions:
+
+static void
+client_close(struct client *c)
+{
+	struct client ** prev = &clients;
+
+	while(*prev != c) prev = &(*prev)->next;
+	*prev = c->next;
+	msh_event_del(c->fd);
+	close(c->fd);
+	free(c);
+}
+
+//send a whole answer, or disconnect a client that doesn't read them
+static int
+client_send(struct client *c, const char *buf, size_t len)
+{
+	while(len > 0)
+	{
+		ssize_t n = send(c->fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+		if(n == -1 && errno == EINTR) continue;
+		if(n == -1)
+		{
+			client_close(c);
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+//a JSON string
+static void
+json_str(FILE *out, const char *str)
+{
+	fputc('"', out);
+	for(; *str != '\0'; str++)
+	{
+		unsigned char ch = *str;
+
+		if(ch == '"' || ch == '\\') fprintf(out, "\\%c", ch);
+		else if(ch < 0x20) fprintf(out, "\\u%04x", ch);
+		else fputc(ch, out);
+	}
+	fputc('"', out);
+}
+
+static const char *
+state_name(msh_job_state_t state)
+{
+	switch(state)
+	{
+		case MSH_JOB_RUNNING: return "running";
+		case MSH_JOB_STOPPED: return "stopped";
+		default: return "done";
+	}
+}
+
+//the exit status for a waitpid status, like $?
+static int
+exit_status(int status)
+{
+	if(WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+	if(WIFSTOPPED(status)) return 128 + WSTOPSIG(status);
+	return WEXITSTATUS(status);
+}
+
+//the CPU times and resident size of a process, from /proc/pid/stat
+static void
+proc_print(FILE *out, pid_t pid)
+{
+	char path[64], stat[1024], * fields;
+	unsigned long utime = 0, stime = 0;
+	long rss = 0, tick = sysconf(_SC_CLK_TCK), page = sysconf(_SC_PAGESIZE);
+	FILE * f;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	fprintf(out, "{\"pid\":%d", pid);
+	f = fopen(path, "re");
+	if(f != NULL && fgets(stat, sizeof(stat), f) != NULL && (fields = strrchr(stat, ')')) != NULL)
+	{
+		//after the name: state ppid pgrp session tty tpgid flags minflt cminflt majflt cmajflt utime stime ... rss is the 22nd
+		sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu %*d %*d %*d %*d %*d %*d %*u %*u %ld", &utime, &stime, &rss);
+		fprintf(out, ",\"utime_ms\":%lu,\"stime_ms\":%lu,\"rss_kb\":%ld", utime * 1000 / tick, stime * 1000 / tick, rss * (page / 1024));
+	}
+	if(f != NULL) fclose(f);
+	fputc('}', out);
+}
+
+static void
+job_print(FILE *out, struct msh_job *j)
+{
+	int count;
+	const pid_t * pids = msh_job_pids(j, &count);
+
+	fprintf(out, "{\"id\":%d,\"pgid\":%d,\"state\":\"%s\",\"input\":", msh_job_id(j), msh_job_pgid(j), state_name(msh_job_state(j)));
+	json_str(out, msh_job_input(j));
+	fprintf(out, ",\"procs\":[");
+	for(int i = 0; i < count; i++)
+	{
+		if(i > 0) fputc(',', out);
+		proc_print(out, pids[i]);
+	}
+	fprintf(out, "]}\n");
+}
+
+static int
+signal_number(const char *name)
+{
+	const char * names[] = { "HUP", "INT", "QUIT", "KILL", "USR1", "USR2", "TERM", "CONT", "STOP", "TSTP" };
+	const int numbers[] = { SIGHUP, SIGINT, SIGQUIT, SIGKILL, SIGUSR1, SIGUSR2, SIGTERM, SIGCONT, SIGSTOP, SIGTSTP };
+	char * end;
+	long n = strtol(name, &end, 10);
+
+	if(end != name && *end == '\0') return n > 0 && n < NSIG ? n : -1;
+	if(strncmp(name, "SIG", 3) == 0) name += 3;
+	for(size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+	{
+		if(strcmp(name, names[i]) == 0) return numbers[i];
+	}
+	return -1;
+}
+
+//answer a command, returns -1 if the client was disconnected
+static int
+command_run(struct client *c, char *line)
+{
+	char * buf = NULL, * cmd, * save = NULL;
+	size_t len = 0;
+	int ret;
+	FILE * out = open_memstream(&buf, &len);
+
+	if(out == NULL) return 0;
+	cmd = strtok_r(line, " \t\r", &save);
+
+	if(cmd == NULL) fprintf(out, "{\"error\":\"empty command\"}\n");
+	else if(strcmp(cmd, "jobs") == 0)
+	{
+		struct msh_job * j;
+
+		for(int i = 0; (j = msh_job_nth(i)) != NULL; i++) job_print(out, j);
+		fprintf(out, "{\"end\":\"jobs\"}\n");
+	}
+	else if(strcmp(cmd, "stats") == 0)
+	{
+		struct timespec now;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		fprintf(out, "{\"jobs\":%d,\"running\":%d,\"stopped\":%d,\"queued\":%d,\"done\":%lu,\"failed\":%lu,\"uptime_ms\":%lld}\n",
+		        msh_job_count(MSH_JOB_RUNNING) + msh_job_count(MSH_JOB_STOPPED) + msh_job_count(MSH_JOB_DONE),
+		        msh_job_count(MSH_JOB_RUNNING), msh_job_count(MSH_JOB_STOPPED), msh_sched_queued(), jobs_done, jobs_failed,
+		        (long long)(now.tv_sec - started.tv_sec) * 1000 + (now.tv_nsec - started.tv_nsec) / 1000000);
+	}
+	else if(strcmp(cmd, "signal") == 0)
+	{
+		char * id = strtok_r(NULL, " \t\r", &save), * sig = strtok_r(NULL, " \t\r", &save);
+		struct msh_job * j = id != NULL ? msh_job_find(atoi(id)) : NULL;
+		int signo = sig != NULL ? signal_number(sig) : -1;
+
+		if(j == NULL) fprintf(out, "{\"error\":\"no such job\"}\n");
+		else if(signo == -1) fprintf(out, "{\"error\":\"no such signal\"}\n");
+		else if(msh_job_signal(j, signo) == -1) fprintf(out, "{\"error\":\"%s\"}\n", strerror(errno));
+		else fprintf(out, "{\"ok\":true}\n");
+	}
+	else if(strcmp(cmd, "events") == 0)
+	{
+		c->events = 1;
+		fprintf(out, "{\"ok\":true}\n");
+	}
+	else
+	{
+		fprintf(out, "{\"error\":\"unknown command\",\"command\":");
+		json_str(out, cmd);
+		fprintf(out, "}\n");
+	}
+
+	fclose(out);
+	ret = client_send(c, buf, len);
+	free(buf);
+
+	return ret;
+}
+
+//called by the event loop when a client sent something, or hung up
+static void
+client_ready(int fd, uint32_t events, void *data)
+{
+	struct client * c = data;
+	ssize_t n;
+
+	(void)fd;
+	(void)events;
+	n = recv(c->fd, c->line + c->len, sizeof(c->line) - 1 - c->len, MSG_DONTWAIT);
+	if(n == -1 && (errno == EAGAIN || errno == EINTR)) return;
+	if(n <= 0)
+	{
+		client_close(c);
+		return;
+	}
+	c->len += n;
+	c->line[c->len] = '\0';
+
+	//the commands that were sent whole
+	for(char * nl; (nl = strchr(c->line, '\n')) != NULL; )
+	{
+		size_t rest;
+
+		*nl = '\0';
+		if(command_run(c, c->line) == -1) return;
+		rest = c->len - (nl + 1 - c->line);
+		memmove(c->line, nl + 1, rest + 1);
+		c->len = rest;
+	}
+	if(c->len == sizeof(c->line) - 1) client_close(c); //a line that long isn't a command
+}
+
+//called by the event loop when a client connects
+static void
+control_ready(int fd, uint32_t events, void *data)
+{
+	int client_fd;
+
+	(void)events;
+	(void)data;
+	while((client_fd = accept4(fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK)) != -1)
+	{
+		struct client * c = calloc(1, sizeof(struct client));
+
+		if(c == NULL || msh_event_add(client_fd, EPOLLIN, client_ready, c) == -1)
+		{
+			free(c);
+			close(client_fd);
+			continue;
+		}
+		c->fd = client_fd;
+		c->next = clients;
+		clients = c;
+	}
+}
+
+//called by the job table when a job is done: tell the clients that asked
+static void
+job_done(struct msh_job *j, void *data)
+{
+	char * buf = NULL;
+	size_t len = 0;
+	FILE * out;
+	int status = exit_status(msh_job_status(j));
+
+	(void)data;
+	jobs_done++;
+	jobs_failed += status != 0;
+
+	out = open_memstream(&buf, &len);
+	if(out == NULL) return;
+	fprintf(out, "{\"event\":\"done\",\"id\":%d,\"pgid\":%d,\"status\":%d,\"input\":", msh_job_id(j), msh_job_pgid(j), status);
+	json_str(out, msh_job_input(j));
+	fprintf(out, "}\n");
+	fclose(out);
+
+	for(struct client * c = clients, * next; c != NULL; c = next)
+	{
+		next = c->next;
+		if(c->events) client_send(c, buf, len);
+	}
+	free(buf);
+}
+
+//a socket at the path that no shell serves anymore, left by one that didn't exit cleanly
+static int
+socket_stale(struct sockaddr_un *addr)
+{
+	struct stat st;
+	int fd, stale;
+
+	if(stat(addr->sun_path, &st) == -1 || !S_ISSOCK(st.st_mode)) return 0;
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(fd == -1) return 0;
+	stale = connect(fd, (struct sockaddr *)addr, sizeof(*addr)) == -1 && errno == ECONNREFUSED;
+	close(fd);
+
+	return stale;
+}
+
+static void
+control_exit(void)
+{
+	if(getpid() == shell_pid) unlink(socket_path);
+}
+//end of helper functions
+
+int
+msh_control_init(void)
+{
+	const char * path = getenv("MSH_CONTROL");
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	mode_t mask;
+	int bound;
+
+	if(path == NULL) return 0;
+	if(strlen(path) >= sizeof(addr.sun_path))
+	{
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+	socket_path = strdup(path);
+	if(socket_path == NULL) return -1;
+
+	listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if(listen_fd == -1) return -1;
+	//a live shell's socket is left to it: binding then fails with EADDRINUSE
+	if(socket_stale(&addr)) unlink(path);
+
+	//only the user can connect, and signal the shell's jobs
+	mask = umask(077);
+	bound = bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+	umask(mask);
+	if(bound == -1 || listen(listen_fd, 16) == -1 || msh_event_add(listen_fd, EPOLLIN, control_ready, NULL) == -1)
+	{
+		close(listen_fd);
+		listen_fd = -1;
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &started);
+	msh_job_listen(job_done, NULL);
+	shell_pid = getpid();
+	atexit(control_exit);
+
+	return 0;
+}
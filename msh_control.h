@@ -0,0 +1,39 @@
+#pragma once
+
+/***
+ * An optional control socket, to monitor and drive the shell from
+ * another process (e.g. a supervisor watching many shells). If the
+ * `MSH_CONTROL` environment variable is set when the shell starts,
+ * the shell listens on a Unix socket at that path, served by its
+ * event loop: clients are handled while the shell reads a line or
+ * waits for a job, never blocking it. The socket is only accessible
+ * to the user. A socket already at the path is replaced only if no
+ * shell serves it anymore.
+ *
+ * The protocol is line oriented. Clients send one command per line,
+ * and get one JSON object per line back:
+ *
+ * - `jobs`: a `{"id":...,"pgid":...,"state":...,"input":...,
+ *   "procs":[{"pid":...,"utime_ms":...,"stime_ms":...,"rss_kb":...}]}`
+ *   line per job, then `{"end":"jobs"}`. The rusage of the processes
+ *   still there is read from `/proc`.
+ * - `stats`: the counters, e.g. `{"jobs":2,"running":1,"stopped":1,
+ *   "queued":0,"done":10,"failed":1,"uptime_ms":12000}`.
+ * - `signal N SIG`: sends `SIG` (a number, or a name like `TERM`) to
+ *   job `N`, answers `{"ok":true}`.
+ * - `events`: answers `{"ok":true}`, then a `{"event":"done",...}`
+ *   line each time a job is done, with its exit `status`.
+ *
+ * Errors are answered with `{"error":"..."}`. A client that doesn't
+ * read what it is sent is disconnected rather than let it block the
+ * shell.
+ */
+
+/**
+ * `msh_control_init` starts listening on `$MSH_CONTROL`, if it is
+ * set. It is called once the event loop is set up.
+ *
+ * - `@return` - `0` on success (or if there is no socket to serve),
+ *     `-1` on failure.
+ */
+int msh_control_init(void);
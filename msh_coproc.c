@@ -0,0 +1,237 @@
+#define _GNU_SOURCE
+#include <msh.h>
+#include <msh_coproc.h>
+#include <msh_job.h>
+#include <msh_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#define MSH_COPROC_MAX 8
+//how long coprocesses have to finish once their input is closed, when the shell exits
+#define MSH_COPROC_GRACE_MS 500
+
+struct coproc {
+	char * name; //NULL if the slot is unused
+	pid_t pid;
+	struct msh_job * job; //NULL once it left the job table
+	int to; //the coprocess' standard input
+	int from; //its standard output
+};
+
+static struct coproc coprocs[MSH_COPROC_MAX];
+static pid_t shell_pid; //the exit handler only runs in the shell, not in children calling exit
+
+//Helper functions:
+
+static struct coproc *
+coproc_find(const char *name)
+{
+	for(int i = 0; i < MSH_COPROC_MAX; i++)
+	{
+		if(coprocs[i].name != NULL && strcmp(coprocs[i].name, name) == 0) return &coprocs[i];
+	}
+	return NULL;
+}
+
+//from the job table, which tells an exited coprocess from one running (kill(pid, 0) doesn't, until it is reaped)
+static int
+coproc_alive(struct coproc *cp)
+{
+	return cp->job != NULL && msh_job_state(cp->job) != MSH_JOB_DONE;
+}
+
+//the coprocess' job left the table
+static void
+coproc_done(struct msh_job *j, void *data)
+{
+	struct coproc * cp = data;
+
+	if(cp->job == j) cp->job = NULL; //unless the slot is another coprocess' already
+}
+
+static void
+coproc_clear(struct coproc *cp)
+{
+	if(cp->to != -1) close(cp->to);
+	if(cp->from != -1) close(cp->from);
+	free(cp->name);
+	*cp = (struct coproc) { .to = -1, .from = -1 };
+}
+
+//close the coprocesses' input, and terminate the ones that don't exit on their own
+static void
+coprocs_exit(void)
+{
+	struct timespec pause = { 0, 10 * 1000 * 1000 };
+	int waiting = 0;
+
+	if(getpid() != shell_pid) return;
+
+	for(int i = 0; i < MSH_COPROC_MAX; i++)
+	{
+		if(coprocs[i].name == NULL) continue;
+		close(coprocs[i].to);
+		coprocs[i].to = -1;
+		waiting++;
+	}
+	for(int ms = 0; waiting > 0 && ms < MSH_COPROC_GRACE_MS; ms += 10)
+	{
+		waiting = 0;
+		for(int i = 0; i < MSH_COPROC_MAX; i++)
+		{
+			if(coprocs[i].name == NULL) continue;
+			if(waitpid(coprocs[i].pid, NULL, WNOHANG) == coprocs[i].pid || !coproc_alive(&coprocs[i])) coproc_clear(&coprocs[i]);
+			else waiting++;
+		}
+		if(waiting > 0) nanosleep(&pause, NULL);
+	}
+	for(int i = 0; i < MSH_COPROC_MAX; i++)
+	{
+		if(coprocs[i].name == NULL) continue;
+		kill(coprocs[i].pid, SIGTERM);
+		coproc_clear(&coprocs[i]);
+	}
+}
+
+static void
+coprocs_print(void)
+{
+	for(int i = 0; i < MSH_COPROC_MAX; i++)
+	{
+		struct coproc * cp = &coprocs[i];
+		struct pollfd input = { .fd = cp->to, .events = POLLOUT };
+		const char * health = "running";
+
+		if(cp->name == NULL) continue;
+		//a pipe whose reader is gone polls as an error
+		if(!coproc_alive(cp)) health = "exited";
+		else if(poll(&input, 1, 0) == 1 && (input.revents & POLLERR)) health = "not reading its input";
+		printf("%%%s %d %s\n", cp->name, cp->pid, health);
+	}
+}
+
+static void
+coproc_start(char *name, char **args, char *input)
+{
+	struct coproc * cp = coproc_find(name);
+	struct msh_job * job;
+	int to[2], from[2];
+	pid_t pid;
+
+	//a name is reused once its coprocess exited
+	if(cp != NULL && coproc_alive(cp))
+	{
+		printf("msh: coproc: %%%s is running\n", name);
+		return;
+	}
+	if(cp != NULL) coproc_clear(cp);
+	for(int i = 0; cp == NULL && i < MSH_COPROC_MAX; i++)
+	{
+		if(coprocs[i].name == NULL) cp = &coprocs[i];
+	}
+	if(cp == NULL)
+	{
+		printf("msh: coproc: too many coprocesses\n");
+		return;
+	}
+
+	if(pipe2(to, O_CLOEXEC) == -1)
+	{
+		perror("msh: coproc");
+		return;
+	}
+	if(pipe2(from, O_CLOEXEC) == -1)
+	{
+		perror("msh: coproc");
+		close(to[0]);
+		close(to[1]);
+		return;
+	}
+	//the job is created last, so it is only in the table if the coprocess is
+	job = msh_job_create(input, 1);
+	if(job == NULL)
+	{
+		printf("msh: too many jobs\n");
+		close(to[0]);
+		close(to[1]);
+		close(from[0]);
+		close(from[1]);
+		return;
+	}
+
+	fflush(stdout);
+	pid = fork();
+	if(pid == 0)
+	{
+		msh_job_child(job);
+		msh_event_child();
+		dup2(to[0], STDIN_FILENO);
+		dup2(from[1], STDOUT_FILENO);
+		execvp(args[0], args);
+		perror("msh: coproc: execvp");
+		_exit(EXIT_FAILURE);
+	}
+	close(to[0]);
+	close(from[1]);
+	if(pid == -1)
+	{
+		perror("msh: coproc: fork");
+		close(to[1]);
+		close(from[0]);
+		msh_job_remove(job);
+		return;
+	}
+	msh_job_add_pid(job, pid);
+	msh_job_launched(job);
+
+	if(shell_pid == 0)
+	{
+		shell_pid = getpid();
+		atexit(coprocs_exit);
+	}
+	*cp = (struct coproc) { .name = strdup(name), .pid = pid, .job = job, .to = to[1], .from = from[0] };
+	if(cp->name == NULL) perror("msh: coproc");
+	msh_job_on_done(job, coproc_done, cp);
+	printf("[%d] %%%s\n", msh_job_id(job), name);
+}
+//end of helper functions
+
+void
+msh_coproc_builtin(char **args, char *input)
+{
+	if(args[1] == NULL)
+	{
+		coprocs_print();
+		return;
+	}
+	if(args[2] == NULL || args[1][0] == '%')
+	{
+		printf("msh: coproc: usage: coproc NAME cmd args\n");
+		return;
+	}
+	coproc_start(args[1], &args[2], input);
+}
+
+int
+msh_coproc_open(const char *file, int flags)
+{
+	struct coproc * cp;
+
+	if(file[0] != '%') return open(file, flags | O_CLOEXEC, 0666);
+
+	cp = coproc_find(file + 1);
+	if(cp == NULL)
+	{
+		errno = ENOENT;
+		return -1;
+	}
+	return fcntl((flags & O_ACCMODE) == O_WRONLY ? cp->to : cp->from, F_DUPFD_CLOEXEC, 0);
+}
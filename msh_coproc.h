@@ -0,0 +1,36 @@
+#pragma once
+
+/***
+ * Coprocesses: long-lived commands the shell talks to through pipes.
+ * `coproc NAME cmd args` starts `cmd` in the background, as a job,
+ * with its standard input and output connected to pipes kept by the
+ * shell. Later pipelines write to it and read from it by redirecting
+ * to or from `%NAME`, e.g. `echo 1+1 1> %calc ; head -n 1 < %calc`,
+ * so that a tool with an expensive startup is started once and fed
+ * many requests.
+ *
+ * `coproc` on its own lists the coprocesses and their health: whether
+ * they are still running, and whether they still read their input.
+ * When the shell exits, the coprocesses' input is closed so that they
+ * can finish, and those still running after a moment are terminated.
+ */
+
+/**
+ * `msh_coproc_builtin` runs the `coproc` builtin.
+ *
+ * - `@args` - the `NULL`-terminated arguments, `coproc` first.
+ * - `@input` - the pipeline, for the job table.
+ */
+void msh_coproc_builtin(char **args, char *input);
+
+/**
+ * `msh_coproc_open` opens the target of a redirection: the pipe of a
+ * coprocess for `%NAME`, a file otherwise.
+ *
+ * - `@file` - the borrowed file name, or `%NAME`.
+ * - `@flags` - the `open` flags. A coprocess' input is opened for
+ *     `O_WRONLY`, its output otherwise.
+ * - `@return` - a new descriptor (closed on `exec`), or `-1` with
+ *     `errno` set (`ENOENT` if there is no such coprocess).
+ */
+int msh_coproc_open(const char *file, int flags);
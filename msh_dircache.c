@@ -0,0 +1,193 @@
+#define _GNU_SOURCE
+#include <msh_dircache.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define MSH_DIRCACHE_SIZE 8
+#define MSH_DIRCACHE_BUF (64 * 1024)
+
+struct msh_dir_entry {
+	const char * name; //in the listing's names
+	unsigned char type; //the DT_* of getdents64, resolved with fstatat for DT_UNKNOWN and DT_LNK
+};
+
+struct msh_dir {
+	int fd; //-1 if the slot is unused
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime; //when the listing was read
+	unsigned long used; //for LRU eviction
+	char * names;
+	struct msh_dir_entry * entries;
+	size_t count;
+};
+
+static struct msh_dir cache[MSH_DIRCACHE_SIZE] = {
+	[0 ... MSH_DIRCACHE_SIZE - 1] = { .fd = -1 },
+};
+static unsigned long cache_clock;
+
+//Helper functions:
+
+static int
+entry_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct msh_dir_entry *)a)->name, ((const struct msh_dir_entry *)b)->name);
+}
+
+static void
+dir_clear(struct msh_dir *d)
+{
+	if(d->fd != -1) close(d->fd);
+	free(d->names);
+	free(d->entries);
+	*d = (struct msh_dir) { .fd = -1 };
+}
+
+//read the whole listing of d->fd, a buffer of getdents64 records at a time
+static int
+dir_read(struct msh_dir *d)
+{
+	char buf[MSH_DIRCACHE_BUF];
+	size_t names_len = 0, names_cap = 0, cap = 0;
+	ssize_t n;
+	//names are kept as offsets while the buffer grows
+	struct { size_t off; unsigned char type; } * read_entries = NULL, * grown_entries;
+
+	lseek(d->fd, 0, SEEK_SET);
+	while((n = getdents64(d->fd, buf, sizeof(buf))) > 0)
+	{
+		for(ssize_t pos = 0; pos < n; pos += ((struct dirent64 *)(buf + pos))->d_reclen)
+		{
+			struct dirent64 * ent = (struct dirent64 *)(buf + pos);
+			size_t len = strlen(ent->d_name) + 1;
+
+			if(strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+
+			if(names_len + len > names_cap)
+			{
+				char * grown;
+
+				names_cap = names_cap == 0 ? MSH_DIRCACHE_BUF : names_cap * 2;
+				grown = realloc(d->names, names_cap);
+				if(grown == NULL) goto fail;
+				d->names = grown;
+			}
+			if(d->count == cap)
+			{
+				cap = cap == 0 ? 1024 : cap * 2;
+				grown_entries = realloc(read_entries, cap * sizeof(*read_entries));
+				if(grown_entries == NULL) goto fail;
+				read_entries = grown_entries;
+			}
+			memcpy(d->names + names_len, ent->d_name, len);
+			read_entries[d->count].off = names_len;
+			read_entries[d->count].type = ent->d_type;
+			d->count++;
+			names_len += len;
+		}
+	}
+	if(n == -1) goto fail;
+
+	d->entries = malloc((d->count > 0 ? d->count : 1) * sizeof(struct msh_dir_entry));
+	if(d->entries == NULL) goto fail;
+	for(size_t i = 0; i < d->count; i++)
+	{
+		d->entries[i] = (struct msh_dir_entry) { d->names + read_entries[i].off, read_entries[i].type };
+	}
+	free(read_entries);
+	qsort(d->entries, d->count, sizeof(struct msh_dir_entry), entry_cmp);
+
+	return 0;
+fail:
+	free(read_entries);
+	return -1;
+}
+//end of helper functions
+
+struct msh_dir *
+msh_dircache_get(const char *path)
+{
+	struct stat st;
+	struct msh_dir * d = NULL, * victim = &cache[0];
+	int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if(fd == -1) return NULL;
+	if(fstat(fd, &st) == -1)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	for(int i = 0; i < MSH_DIRCACHE_SIZE; i++)
+	{
+		if(cache[i].fd != -1 && cache[i].dev == st.st_dev && cache[i].ino == st.st_ino) d = &cache[i];
+		if(cache[i].used < victim->used) victim = &cache[i];
+	}
+
+	if(d != NULL && d->mtime.tv_sec == st.st_mtim.tv_sec && d->mtime.tv_nsec == st.st_mtim.tv_nsec)
+	{
+		//the directory didn't change since we read it
+		close(fd);
+		d->used = ++cache_clock;
+		return d;
+	}
+
+	if(d == NULL) d = victim;
+	dir_clear(d);
+	*d = (struct msh_dir) { .fd = fd, .dev = st.st_dev, .ino = st.st_ino, .mtime = st.st_mtim, .used = ++cache_clock };
+	if(dir_read(d) == -1)
+	{
+		dir_clear(d);
+		return NULL;
+	}
+
+	return d;
+}
+
+size_t
+msh_dir_find(struct msh_dir *d, const char *prefix, size_t *end)
+{
+	size_t len = strlen(prefix), lo = 0, hi = d->count, first;
+
+	while(lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+
+		if(strcmp(d->entries[mid].name, prefix) < 0) lo = mid + 1;
+		else hi = mid;
+	}
+	first = lo;
+	while(lo < d->count && strncmp(d->entries[lo].name, prefix, len) == 0) lo++;
+	*end = lo;
+
+	return first;
+}
+
+const char *
+msh_dir_name(struct msh_dir *d, size_t nth)
+{
+	return d->entries[nth].name;
+}
+
+int
+msh_dir_isdir(struct msh_dir *d, size_t nth)
+{
+	struct msh_dir_entry * e = &d->entries[nth];
+
+	if(e->type == DT_UNKNOWN || e->type == DT_LNK)
+	{
+		struct stat st;
+
+		//resolved once, and kept with the listing
+		e->type = fstatat(d->fd, e->name, &st, 0) == 0 && S_ISDIR(st.st_mode) ? DT_DIR : DT_REG;
+	}
+
+	return e->type == DT_DIR;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+
+/***
+ * A cache of directory listings, for filename completion. A listing
+ * is read in bulk with `getdents64` into a single buffer of names,
+ * sorted so that the names starting with a prefix can be found with
+ * a binary search. No entry is `stat`ed to build it.
+ *
+ * Directories are identified by their device and inode, so the same
+ * directory reached through different paths is cached once. Each
+ * time a listing is asked for, the directory's modification time is
+ * compared to the one it was read at, and the listing is read again
+ * if the directory changed.
+ *
+ * The cache isn't synchronized: it is only used by the `linenoise`
+ * callbacks.
+ */
+
+struct msh_dir;
+
+/**
+ * `msh_dircache_get` returns the listing of a directory.
+ *
+ * - `@path` - the borrowed path of the directory.
+ * - `@return` - the listing, borrowed until the next call to
+ *     `msh_dircache_get`, or `NULL` if it couldn't be read.
+ */
+struct msh_dir *msh_dircache_get(const char *path);
+
+/**
+ * `msh_dir_find` finds the names in a listing starting with a prefix.
+ *
+ * - `@d` - the listing.
+ * - `@prefix` - the borrowed prefix.
+ * - `@end` - set to the index after the last name found.
+ * - `@return` - the index of the first name found, `== *end` if there
+ *     is none.
+ */
+size_t msh_dir_find(struct msh_dir *d, const char *prefix, size_t *end);
+
+/**
+ * `msh_dir_name` returns the `nth` name of the listing, in `strcmp`
+ * order, borrowed as the listing.
+ */
+const char *msh_dir_name(struct msh_dir *d, size_t nth);
+
+/**
+ * `msh_dir_isdir` tells us if the `nth` name of the listing is a
+ * directory (or a link to one). Only the entries whose type the
+ * listing doesn't tell are `stat`ed.
+ */
+int msh_dir_isdir(struct msh_dir *d, size_t nth);
@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+#include <msh_event.h>
+#include <linenoise.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+
+#define MSH_EVENT_BATCH 16
+
+//a watched descriptor
+struct msh_event {
+	int fd;
+	msh_event_fn fn;
+	void * data;
+	int dead; //removed, but maybe still in the batch being handled
+	struct msh_event * next;
+};
+
+static int epoll_fd = -1;
+static struct msh_event * events; //the watched descriptors
+static struct msh_event * graveyard; //removed, freed once no batch refers to them
+static int handling; //how many msh_event_wait are handling a batch
+
+//the signals we handle, and the mask to restore in children
+static int signal_fd = -1;
+static msh_event_signal_fn signal_fn;
+static sigset_t child_mask;
+
+//the input thread reads a prompt pointer from the request pipe, and
+//writes the line pointer to the reply pipe
+static int input_request[2] = { -1, -1 };
+static int input_reply[2] = { -1, -1 };
+static int input_pending;
+static char * input_line;
+
+//Helper functions:
+
+//pointers are written whole, as a pipe write of less than PIPE_BUF bytes is atomic
+static int
+pointer_read(int fd, void *ptr)
+{
+	ssize_t n;
+
+	do n = read(fd, ptr, sizeof(void *));
+	while(n == -1 && errno == EINTR);
+
+	return n == sizeof(void *) ? 0 : -1;
+}
+
+static int
+pointer_write(int fd, void *ptr)
+{
+	ssize_t n;
+
+	do n = write(fd, ptr, sizeof(void *));
+	while(n == -1 && errno == EINTR);
+
+	return n == sizeof(void *) ? 0 : -1;
+}
+
+static void *
+input_thread(void *arg)
+{
+	const char * prompt;
+
+	(void) arg;
+	while(pointer_read(input_request[0], &prompt) == 0)
+	{
+		char * line = linenoise(prompt);
+
+		if(pointer_write(input_reply[1], &line) == -1)
+		{
+			free(line);
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+input_ready(int fd, uint32_t ready, void *data)
+{
+	(void) ready;
+	(void) data;
+
+	if(pointer_read(fd, &input_line) == -1) input_line = NULL; //the input thread is gone
+	input_pending = 0;
+}
+
+static void
+signal_ready(int fd, uint32_t ready, void *data)
+{
+	struct signalfd_siginfo info;
+
+	(void) ready;
+	(void) data;
+
+	//signals of the same kind are merged, so we get at least one per kind
+	while(read(fd, &info, sizeof(info)) == sizeof(info)) signal_fn(&info);
+}
+//end of helper functions
+
+int
+msh_event_init(msh_event_signal_fn on_signal)
+{
+	sigset_t handled;
+	pthread_t input;
+
+	sigemptyset(&handled);
+	sigaddset(&handled, SIGCHLD);
+	sigaddset(&handled, SIGINT);
+	sigaddset(&handled, SIGTSTP);
+	sigaddset(&handled, SIGTERM);
+	sigaddset(&handled, SIGCONT);
+	if(pthread_sigmask(SIG_BLOCK, &handled, &child_mask) != 0) return -1;
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if(epoll_fd == -1) return -1;
+
+	signal_fn = on_signal;
+	signal_fd = signalfd(-1, &handled, SFD_NONBLOCK | SFD_CLOEXEC);
+	if(signal_fd == -1 || msh_event_add(signal_fd, EPOLLIN, signal_ready, NULL) == -1) return -1;
+
+	if(pipe2(input_request, O_CLOEXEC) == -1 || pipe2(input_reply, O_CLOEXEC) == -1) return -1;
+	if(msh_event_add(input_reply[0], EPOLLIN, input_ready, NULL) == -1) return -1;
+
+	//the thread inherits our signal mask, so signals only reach the signalfd
+	if(pthread_create(&input, NULL, input_thread, NULL) != 0) return -1;
+	pthread_detach(input);
+
+	return 0;
+}
+
+int
+msh_event_add(int fd, uint32_t ready, msh_event_fn fn, void *data)
+{
+	struct msh_event * e = calloc(1, sizeof(struct msh_event));
+	struct epoll_event ev;
+
+	if(e == NULL) return -1;
+	e->fd = fd;
+	e->fn = fn;
+	e->data = data;
+
+	ev = (struct epoll_event) { .events = ready, .data.ptr = e };
+	if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)
+	{
+		free(e);
+		return -1;
+	}
+	e->next = events;
+	events = e;
+
+	return 0;
+}
+
+void
+msh_event_del(int fd)
+{
+	struct msh_event ** prev = &events;
+
+	while(*prev != NULL && (*prev)->fd != fd) prev = &(*prev)->next;
+	if(*prev == NULL) return;
+
+	struct msh_event * e = *prev;
+	*prev = e->next;
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+
+	e->dead = 1;
+	e->next = graveyard;
+	graveyard = e;
+}
+
+int
+msh_event_wait(int timeout)
+{
+	struct epoll_event ready[MSH_EVENT_BATCH];
+	int n;
+
+	n = epoll_wait(epoll_fd, ready, MSH_EVENT_BATCH, timeout);
+	if(n == -1) return errno == EINTR ? 0 : -1;
+
+	handling++;
+	for(int i = 0; i < n; i++)
+	{
+		struct msh_event * e = ready[i].data.ptr;
+
+		if(!e->dead) e->fn(e->fd, ready[i].events, e->data);
+	}
+	handling--;
+
+	while(handling == 0 && graveyard != NULL)
+	{
+		struct msh_event * e = graveyard;
+
+		graveyard = e->next;
+		free(e);
+	}
+
+	return n;
+}
+
+char *
+msh_event_readline(const char *prompt)
+{
+	fflush(stdout);
+	if(pointer_write(input_request[1], &prompt) == -1) return NULL;
+
+	input_pending = 1;
+	while(input_pending)
+	{
+		if(msh_event_wait(-1) == -1)
+		{
+			perror("msh: epoll_wait");
+			return NULL;
+		}
+	}
+
+	return input_line;
+}
+
+void
+msh_event_child(void)
+{
+	pthread_sigmask(SIG_SETMASK, &child_mask, NULL);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/signalfd.h>
+
+/***
+ * The shell's event loop. Signals are never delivered to handlers:
+ * they are blocked, and read from a `signalfd` by the loop, which
+ * `epoll`s it along with the input the user types, child processes
+ * and timers. The functions called for each event run in the shell's
+ * main thread like any other code, so they can print, allocate and
+ * update the job table.
+ *
+ * `linenoise` blocks until a whole line is typed, so it runs on an
+ * input thread that reads a line whenever the shell asks for one.
+ * The shell keeps handling events (e.g. background jobs exiting)
+ * while waiting for it.
+ */
+
+/**
+ * `msh_event_fn` is called by the event loop when a descriptor it
+ * watches is ready.
+ *
+ * - `@fd` - the ready descriptor.
+ * - `@events` - the `epoll` events (`EPOLLIN`, ...) it is ready for.
+ * - `@data` - the data passed to `msh_event_add`.
+ */
+typedef void (*msh_event_fn)(int fd, uint32_t events, void *data);
+
+/**
+ * `msh_event_signal_fn` is called by the event loop for each signal
+ * the shell receives.
+ *
+ * - `@info` - the signal, and who sent it.
+ */
+typedef void (*msh_event_signal_fn)(struct signalfd_siginfo *info);
+
+/**
+ * `msh_event_init` blocks the signals the shell handles, and starts
+ * the event loop and the input thread. It must be called before any
+ * other thread is created, so that they all have the signals blocked.
+ *
+ * - `@on_signal` - called for each `SIGCHLD`, `SIGINT`, `SIGTSTP`,
+ *     `SIGTERM` and `SIGCONT` the shell receives.
+ * - `@return` - `0` on success, `-1` on failure.
+ */
+int msh_event_init(msh_event_signal_fn on_signal);
+
+/**
+ * `msh_event_add` watches a descriptor (e.g. a `timerfd`).
+ *
+ * - `@fd` - the descriptor, still owned by the caller.
+ * - `@events` - the `epoll` events to wait for.
+ * - `@fn` - called when the descriptor is ready.
+ * - `@data` - passed to `fn`.
+ * - `@return` - `0` on success, `-1` on failure.
+ */
+int msh_event_add(int fd, uint32_t events, msh_event_fn fn, void *data);
+
+/**
+ * `msh_event_del` stops watching a descriptor. It can be called from
+ * the descriptor's own `msh_event_fn`, and must be called before the
+ * descriptor is closed.
+ */
+void msh_event_del(int fd);
+
+/**
+ * `msh_event_wait` waits for events and handles them.
+ *
+ * - `@timeout` - in milliseconds, `-1` to wait until there is an
+ *     event.
+ * - `@return` - the number of events handled, `-1` on failure.
+ */
+int msh_event_wait(int timeout);
+
+/**
+ * `msh_event_readline` gets a line the user typed from the input
+ * thread, handling events while the user types it.
+ *
+ * - `@prompt` - displayed by `linenoise`.
+ * - `@return` - the line to `free`, or `NULL` at the end of the input.
+ */
+char *msh_event_readline(const char *prompt);
+
+/**
+ * `msh_event_child` is called in a child process after `fork` and
+ * before `exec`: it unblocks the signals the shell blocked, as the
+ * signal mask is inherited by the program.
+ */
+void msh_event_child(void);
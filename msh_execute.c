@@ -1,8 +1,25 @@
+#define _GNU_SOURCE
 #include <msh.h>
 #include <msh_parse.h>
-#include <msh_parse.c>
+#include <msh_parse_internal.h>
+#include <msh_optimize.h>
+#include <msh_glob.h>
+#include <msh_var.h>
+#include <msh_loop.h>
+#include <msh_zygote.h>
+#include <msh_coproc.h>
+#include <msh_memo.h>
+#include <msh_sched.h>
+#include <msh_place.h>
+#include <msh_limit.h>
+#include <msh_timer.h>
+#include <msh_control.h>
+#include <msh_stage.h>
+#include <msh_job.h>
+#include <msh_event.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -11,188 +28,549 @@
 #include <signal.h>
 #include <fcntl.h>
 
-//foreground process struct
-struct fg_comms{
-	pid_t fg_pid;
-	char * fg_program; 
-};
+static int status; //of the last foreground pipeline
 
-//background process struct
-struct bg_comms {
-	pid_t bg_pid; //the background program's pid, needed for fg or cntl-c
-	char * bg_program; //the name of the background program, needed when using jobs
-	char * bg_args; //the arguments that go with the program
-};
+//Helper functions:
 
-//initialize fg and bg structs as global variables
-struct fg_comms fg_commands[MSH_MAXBACKGROUND];
-struct bg_comms bg_commands[MSH_MAXBACKGROUND];
-int bg_count; //current count of background commands
-int fg_count;
+//how many commands there are in the pipeline
+int
+msh_pipeline_parse(struct msh_pipeline *p)
+{ 
+	int counter = 0;
 
+	while(counter < MSH_MAXCMNDS && p->pipeline_commands[counter] != NULL) counter++;
 
-//Helper functions:
+	return counter;
+}
 
-//add fg command to array
-void
-fg_add(pid_t pid, char *program)
+//redirections of a command, pulled out of its arguments by redirection_parse
+struct redirection {
+	char * in_file; //<
+	char * out_file; //1> and 1>>
+	int out_append;
+	char * err_file; //2> and 2>>
+	int err_append;
+	char * heredoc; //<< and <<<, the delimiter or the here-string
+	int heredoc_string; //1 for <<<
+};
+
+//returns which descriptor a redirection operator redirects, or -1 if the
+//argument isn't an operator
+static int
+redirect_op(char *arg)
 {
-	//reset the array everytime count is 0, needed once whole program finishes or after cntl-c
-	if(fg_count == 0) memset(fg_commands, 0, sizeof(struct fg_comms) * MSH_MAXBACKGROUND);
+	if(strcmp(arg, "<") == 0 || strcmp(arg, "<<") == 0 || strcmp(arg, "<<<") == 0) return STDIN_FILENO;
+	if(strcmp(arg, "1>") == 0 || strcmp(arg, "1>>") == 0) return STDOUT_FILENO;
+	if(strcmp(arg, "2>") == 0 || strcmp(arg, "2>>") == 0) return STDERR_FILENO;
 
-	for(int i = 0; i < fg_count; i++)
+	return -1;
+}
+
+//redirection error checking, and removal of the operators and files from the
+//command's arguments. The files are moved into r, thus must be freed with
+//redirection_free, once the command is found valid: on an error, the command
+//still owns them. first and last tell where the command is in the pipeline.
+msh_err_t
+redirection_parse(struct msh_command *c, int first, int last, struct redirection *r)
+{
+	int seen[3] = {0, 0, 0};
+	int nargs = 0;
+	int i;
+
+	memset(r, 0, sizeof(struct redirection));
+	for(i = 0; c->comm_arguments[i] != NULL; i++) nargs++;
+
+	for(i = 1; i < nargs; i++)
 	{
-		if(fg_commands[i].fg_pid == 0)
+		int fd = redirect_op(c->comm_arguments[i]);
+
+		if(fd == -1)
 		{
-			fg_commands[i].fg_pid = pid;
-			fg_commands[i].fg_program = program;
-			fg_count++;
-			break;
+			//redirections are last in a command: cmd 1> a.txt b.txt
+			if(seen[0] || seen[1] || seen[2]) return MSH_ERR_REDIRECTED_TO_TOO_MANY_FILES;
+			continue;
+		}
+		//cmd 1> a.txt 1> b.txt
+		if(seen[fd]) return MSH_ERR_MULT_REDIRECTIONS;
+		//cmd 1>
+		if(i + 1 >= nargs || redirect_op(c->comm_arguments[i + 1]) != -1) return MSH_ERR_NO_REDIR_FILE;
+		//only the first command reads from somewhere other than the pipe, and only
+		//the last one writes its standard output somewhere else
+		if(fd == STDIN_FILENO && !first) return MSH_ERR_REDUNDANT_PIPE_INPUT;
+		if(fd == STDOUT_FILENO && !last) return MSH_ERR_REDUNDANT_PIPE_REDIRECTION;
+		seen[fd] = 1;
+		i++;
+	}
+
+	//the redirections are validated: move the files into r, and take them out of the argument list
+	for(i = 1; i < nargs; i++)
+	{
+		char * op = c->comm_arguments[i];
+		char * file;
+
+		if(redirect_op(op) == -1) continue;
+
+		file = c->comm_arguments[i + 1];
+		if(strcmp(op, "<") == 0) r->in_file = file;
+		else if(strcmp(op, "<<") == 0) r->heredoc = file;
+		else if(strcmp(op, "<<<") == 0)
+		{
+			r->heredoc = file;
+			r->heredoc_string = 1;
+		}
+		else if(redirect_op(op) == STDOUT_FILENO)
+		{
+			r->out_file = file;
+			r->out_append = (strcmp(op, "1>>") == 0);
+		}
+		else
+		{
+			r->err_file = file;
+			r->err_append = (strcmp(op, "2>>") == 0);
 		}
+		free(op);
+		c->comm_arguments[i] = c->comm_arguments[i + 1] = NULL;
+		c->comm_args_count -= 2;
+		i++;
 	}
+
+	return 0; //SUCCESS
 }
 
-//send kill signal to every foreground pid
 void
-fg_kill()
+redirection_free(struct redirection *r)
 {
-	for(int i = 0; i < fg_count; i++) kill(fg_commands[i].fg_pid, SIGINT);
-	fg_count = 0; //reset foreground command count after kiling each process
+	free(r->in_file);
+	free(r->out_file);
+	free(r->err_file);
+	free(r->heredoc);
 }
 
-int
-msh_pipeline_parse(struct msh_pipeline *p)
-{ 
-	char *token, *ptr;
-	char * input_copy = malloc(strlen(p->pipe) + 1);
-	int counter = 0; //count how many "|" separators there are
+//where a builtin prints: the shell's standard output, or a stream over the pipeline's own
+static FILE *
+builtin_out(int out)
+{
+	int fd;
+	FILE * f;
 
-	//malloc() failure
-	if(input_copy == NULL)
-	{
-		perror("msh_execute: malloc failure");
-		free(input_copy);
-		exit(EXIT_FAILURE);
-	}
+	if(out == STDOUT_FILENO) return stdout;
+	fd = fcntl(out, F_DUPFD_CLOEXEC, 0);
+	f = fd != -1 ? fdopen(fd, "w") : NULL;
+	if(f != NULL) return f;
 
-	strcpy(input_copy, p->pipe);
-	for(token = strtok_r(input_copy, "|", &ptr); token != NULL; token = strtok_r(NULL, "|", &ptr))
-	{
-		counter++;
-	}
+	if(fd != -1) close(fd);
+	return stdout;
+}
 
-	free(input_copy);
-	return counter;
+static void
+builtin_out_close(FILE *f)
+{
+	if(f != stdout) fclose(f);
 }
 
-//redirection error checking
-msh_err_t
-redirection_parse(struct msh_command *c, struct msh_pipeline *p)
+//a builtin doesn't read its input: close the here-document, and free the redirections
+static void
+builtin_done(struct redirection *r, int *heredoc_fd)
 {
-	int pipe_counter = msh_pipeline_parse(p) - 1; // "|", 1>, 1>>, 2>, 2>> counters
-	int one_arrow = 0;
-	int one_arrows = 0;
-	int two_arrow = 0; 
-	int two_arrows = 0;
-	
-	for(int i = 0; i < c->comm_args_count - 1; i++)
+	if(*heredoc_fd != -1) close(*heredoc_fd);
+	*heredoc_fd = -1;
+	redirection_free(r);
+}
+
+//open the file (or coprocess, for %NAME) for a redirection in the child, and dup it over fd
+static void
+redirect_open(char *file, int flags, int fd)
+{
+	int file_fd = msh_coproc_open(file, flags);
+
+	if(file_fd == -1)
 	{
-		if(strcmp(c->comm_arguments[i], "1>") == 0) one_arrow++;
-		if(strcmp(c->comm_arguments[i], "1>>") == 0) one_arrows++;
-		if(strcmp(c->comm_arguments[i], "2>") == 0) two_arrow++;
-		if(strcmp(c->comm_arguments[i], "2>>") == 0) two_arrows++;
+		fprintf(stderr, "msh: %s: %s\n", file, strerror(errno));
+		_exit(EXIT_FAILURE);
 	}
-	
-	//cannot have redirected to more than one file
-	//this is not allowed: cmd 1> a.txt 1> b.txt 
-	if((one_arrow > 1) || (one_arrows > 1) || (two_arrow > 1) || (two_arrows > 1))
+	dup2(file_fd, fd);
+	close(file_fd);
+}
+
+//have the zygote fork the command, with the descriptors the child would set up itself,
+//returns -1 if the shell must fork it
+static pid_t
+zygote_spawn(struct msh_command *c, struct msh_job *job, int background, struct redirection *r, int in, int out, int err)
+{
+	int fds[3] = { in, out, err };
+	pid_t pid = -1;
+
+	if(r->in_file != NULL) fds[0] = msh_coproc_open(r->in_file, O_RDONLY);
+	if(r->out_file != NULL) fds[1] = msh_coproc_open(r->out_file, O_WRONLY | O_CREAT | (r->out_append ? O_APPEND : O_TRUNC));
+	if(r->err_file != NULL) fds[2] = msh_coproc_open(r->err_file, O_WRONLY | O_CREAT | (r->err_append ? O_APPEND : O_TRUNC));
+
+	//a file that can't be opened is reported by the child forked instead
+	if(fds[0] != -1 && fds[1] != -1 && fds[2] != -1)
 	{
-		printf("%s\n", msh_pipeline_err2str(-2));
-		return -2;
+		pid = msh_zygote_spawn(c->comm_arguments, c->comm_env, job != NULL ? msh_job_pgid(job) : 0, job != NULL && !background, fds);
 	}
 
-	//cannot have a redirection and output sent to a pipe
-	if((one_arrow == 1) && (pipe_counter > 0))
+	if(r->in_file != NULL && fds[0] != -1) close(fds[0]);
+	if(r->out_file != NULL && fds[1] != -1) close(fds[1]);
+	if(r->err_file != NULL && fds[2] != -1) close(fds[2]);
+
+	return pid;
+}
+
+//read the body of a here-document up to its delimiter line, and return a
+//descriptor from which it can be read
+static int
+heredoc_read(char *delimiter)
+{
+	char * body = NULL;
+	size_t len = 0, cap = 0;
+	int fd;
+
+	while(1)
 	{
-		printf("%s\n", msh_pipeline_err2str(-10));
-		return -10;
+		char * line = msh_event_readline("> ");
+		size_t line_len;
+
+		if(line == NULL || strcmp(line, delimiter) == 0)
+		{
+			free(line);
+			break;
+		}
+		line_len = strlen(line);
+		if(msh_stage_buffer_grow(&body, &cap, len + line_len + 1) == -1)
+		{
+			perror("msh: here-document");
+			free(line);
+			break;
+		}
+		memcpy(body + len, line, line_len);
+		len += line_len;
+		body[len++] = '\n';
+		free(line);
 	}
 
-	if((one_arrows == 1) && (pipe_counter > 0))
+	fd = msh_stage_heredoc(body, len, cap);
+
+	return fd;
+}
+
+//move the NAME=value words before the program into the command's environment,
+//returns 1 if the command is only assignments
+static int
+assignments_strip(struct msh_command *c)
+{
+	int count = 0, args = 0;
+
+	while(c->comm_arguments[count] != NULL && msh_var_assignment(c->comm_arguments[count]) > 0) count++;
+	while(c->comm_arguments[args] != NULL) args++;
+	if(count == 0) return 0;
+	if(count == args) return 1;
+
+	c->comm_env = calloc(count + 1, sizeof(char *));
+	if(c->comm_env == NULL) return 0; //they're run as a program, which fails
+	memcpy(c->comm_env, c->comm_arguments, count * sizeof(char *));
+	memmove(c->comm_arguments, c->comm_arguments + count, (args - count + 1) * sizeof(char *));
+	memset(c->comm_arguments + args - count + 1, 0, count * sizeof(char *));
+	c->comm_args_count -= count;
+
+	free(c->command);
+	c->command = strdup(c->comm_arguments[0]);
+
+	return 0;
+}
+
+//a stage of a pipeline that is only assignments runs apart from the shell, like in other
+//shells: the variables are lost with it, so it becomes true. Returns -1 on allocation failure.
+static int
+assignments_drop(struct msh_command *c)
+{
+	char * program = strdup("true");
+	int args = 0;
+
+	if(program == NULL) return -1;
+	for(; c->comm_arguments[args] != NULL; args++) free(c->comm_arguments[args]);
+	memset(c->comm_arguments, 0, args * sizeof(char *));
+	c->comm_arguments[0] = program;
+	c->comm_args_count -= args - 1;
+
+	free(c->command);
+	c->command = strdup(program);
+
+	return c->command != NULL ? 0 : -1;
+}
+
+//set NAME=value words as shell variables, and export them if asked to
+static void
+assignments_set(char **words, int export)
+{
+	for(int i = 0; words[i] != NULL; i++)
 	{
-		printf("%s\n", msh_pipeline_err2str(-10));
-		return -10;
+		int len = msh_var_assignment(words[i]);
+		int failed;
+
+		if(len == 0 && export)
+		{
+			failed = msh_var_export(words[i]) == -1;
+		}
+		else if(len == 0)
+		{
+			printf("msh: %s: not an assignment\n", words[i]);
+			continue;
+		}
+		else
+		{
+			words[i][len] = '\0';
+			failed = msh_var_set(words[i], words[i] + len + 1) == -1 || (export && msh_var_export(words[i]) == -1);
+			words[i][len] = '=';
+		}
+		if(failed) perror("msh: variables");
 	}
+}
+
+//the exit status for a waitpid status, 128 + the signal if it was killed or stopped
+static int
+exit_status(int wstatus)
+{
+	if(WIFSIGNALED(wstatus)) return 128 + WTERMSIG(wstatus);
+	if(WIFSTOPPED(wstatus)) return 128 + WSTOPSIG(wstatus);
+	return WEXITSTATUS(wstatus);
+}
+
+//wait [-n] [N...], N being a job as shown by jobs (or %N)
+static void
+wait_builtin(char **args)
+{
+	struct msh_job * list[MSH_MAXBACKGROUND + 1];
+	int count = 0, any = 0, i = 1;
 
-	if((two_arrow == 1) && (pipe_counter > 0))
+	if(args[i] != NULL && strcmp(args[i], "-n") == 0)
 	{
-		printf("%s\n", msh_pipeline_err2str(-10));
-		return -10;
+		any = 1;
+		i++;
 	}
+	for(; args[i] != NULL && count < MSH_MAXBACKGROUND + 1; i++)
+	{
+		char * index = args[i][0] == '%' ? args[i] + 1 : args[i], * end;
+		struct msh_job * j = msh_job_find(strtol(index, &end, 10));
 
-	if((two_arrows == 1) && (pipe_counter > 0))
+		if(end == index || *end != '\0' || j == NULL)
+		{
+			printf("msh: wait: %s: no such job\n", args[i]);
+			status = 127;
+			return;
+		}
+		list[count++] = j;
+	}
+	//all the jobs, by default, once the queued ones started
+	if(i == 1 + any)
 	{
-		printf("%s\n", msh_pipeline_err2str(-10));
-		return -10;
+		if(!any) msh_sched_finish();
+		for(struct msh_job * j; (j = msh_job_nth(count)) != NULL; ) list[count++] = j;
 	}
 
-	return 0; //SUCCESS
+	status = count > 0 ? exit_status(msh_job_await(list, count, any)) : 0;
 }
 
-//parse command for redirection symbols
-int
-redirect_stat(struct msh_command *c)
+//timeout [-k GRACE] DURATION: returns how many words it is, -1 if they are wrong
+static int
+timeout_parse(char **args, long *ms, long *grace_ms)
 {
-	for(int i = 0; i < c->comm_args_count - 1; i++)
-	{
-		if(strcmp(c->comm_arguments[i], "1>") == 0) return 1;
-
-		if(strcmp(c->comm_arguments[i], "1>>") == 0) return 2;
+	int i = 1;
 
-		if(strcmp(c->comm_arguments[i], "2>") == 0) return 3;
-
-		if(strcmp(c->comm_arguments[i], "2>>") == 0) return 4;
+	*grace_ms = 5000;
+	if(args[i] != NULL && strcmp(args[i], "-k") == 0)
+	{
+		if(args[i + 1] == NULL || (*grace_ms = msh_timer_duration(args[i + 1])) == -1) return -1;
+		i += 2;
 	}
+	if(args[i] == NULL || (*ms = msh_timer_duration(args[i])) == -1 || args[i + 1] == NULL) return -1;
 
-	return 0;
+	return i + 1;
 }
 
-//file to redirect to
-char *
-redirect_file(struct msh_command * c)
+//remove a builtin prefix (explain, place and its options) of n words from the front of the pipeline
+static void
+prefix_strip(struct msh_pipeline *p, int n)
 {
-	char * file_name = NULL;
-	for(int i = 0; i < c->comm_args_count - 1; i++)
+	struct msh_command * c = msh_pipeline_command(p, 0);
+	int i;
+
+	for(i = 0; i < n; i++) free(c->comm_arguments[i]);
+	for(i = 0; c->comm_arguments[i + n] != NULL; i++) c->comm_arguments[i] = c->comm_arguments[i + n];
+	for(int k = i; k < i + n; k++) c->comm_arguments[k] = NULL;
+	c->comm_args_count -= n;
+
+	free(c->command);
+	c->command = NULL;
+	if(c->comm_arguments[0] != NULL)
 	{
-		if( (strcmp(c->comm_arguments[i], "1>>") == 0) ||
-		    (strcmp(c->comm_arguments[i], "1>") == 0)  ||
-			(strcmp(c->comm_arguments[i], "2>") == 0)  ||
-			(strcmp(c->comm_arguments[i], "2>>") == 0))
-		{
-			file_name = c->comm_arguments[i + 1];
-			c->comm_arguments[i] = NULL;
-			c->comm_arguments[i + 1] = NULL;
-			c->comm_args_count -= 2;
-			return file_name;
-		}
+		c->command = strdup(c->comm_arguments[0]);
+		return;
 	}
-	return file_name;
+
+	//explain on its own: there is nothing to explain
+	msh_command_free(c);
+	for(i = 0; i < MSH_MAXCMNDS - 1; i++) p->pipeline_commands[i] = p->pipeline_commands[i + 1];
+	p->pipeline_commands[MSH_MAXCMNDS - 1] = NULL;
 }
 //end of helper functions
 
 
-void
-msh_execute(struct msh_pipeline *p)
+int
+msh_execute_fds(struct msh_pipeline *p, int out, int err)
 {
 	char * program; //read pipeline's program
 	struct msh_command * c; //retrieve the commands
 	char ** args_list; //arguments list
 	int command_count = msh_pipeline_parse(p);//determine how many commands there are
 	pid_t pid;
-	int fds[2]; //set up the pipe
+	int fds[2] = {0, 0}; //set up the pipe
 	int carryover = 0;
-	int output_fd = 0;
-	fg_count = 0;
+	int heredoc_fd = -1;
+	struct redirection redirect;
+	struct msh_job * job = NULL;
+	struct msh_place place;
+	struct msh_limit limits;
+	long timeout_ms = -1, grace_ms = 0;
+	int exited = 0;
+	msh_err_t perr;
+
+	msh_job_reap(); //forget about the background jobs that are done
+	status = 0;
+
+	//background pipelines past $MSH_JOBS wait for running ones to finish, unless they
+	//have their own output: it may be gone by the time their turn comes
+	if(out == STDOUT_FILENO && err == STDERR_FILENO && msh_sched_queue(p)) return 0;
+
+	//the & is the last argument of the last command, remove it for execvp
+	if(msh_pipeline_background(p) == 1)
+	{
+		c = msh_pipeline_command(p, command_count - 1);
+		int last = c->comm_args_count - 2;
+
+		if(last > 0 && strcmp(c->comm_arguments[last], "&") == 0)
+		{
+			free(c->comm_arguments[last]);
+			c->comm_arguments[last] = NULL;
+			c->comm_args_count--;
+		}
+		else if(last >= 0 && c->comm_arguments[last][strlen(c->comm_arguments[last]) - 1] == '&')
+		{
+			c->comm_arguments[last][strlen(c->comm_arguments[last]) - 1] = '\0'; //cmd args&
+		}
+	}
+
+	//NAME=value on its own sets a shell variable, before a program it is in the program's environment
+	for(int i = 0; i < command_count; i++)
+	{
+		c = msh_pipeline_command(p, i);
+		if(assignments_strip(c) == 0) continue;
+		if(command_count == 1)
+		{
+			assignments_set(c->comm_arguments, 0);
+			msh_pipeline_free(p);
+			return 0;
+		}
+		if(assignments_drop(c) == -1)
+		{
+			perror("msh: variables");
+			msh_pipeline_free(p);
+			return 0;
+		}
+	}
+
+	//replace the wildcards by the paths they match
+	if(msh_glob_expand(p) == -1)
+	{
+		perror("msh: glob");
+		msh_pipeline_free(p);
+		return 0;
+	}
+
+	//memo runs the pipeline following it once, and replays its output after that
+	c = msh_pipeline_command(p, 0);
+	if(strcmp(c->command, "memo") == 0)
+	{
+		status = msh_memo_execute(p, out, err);
+		return 0;
+	}
+
+	//explain prints the pipeline following it as it would be run, instead of running it
+	c = msh_pipeline_command(p, 0);
+	if(strcmp(c->command, "explain") == 0)
+	{
+		prefix_strip(p, 1);
+		if(msh_pipeline_command(p, 0) != NULL)
+		{
+			FILE * o = builtin_out(out);
+
+			msh_optimize(p, out);
+			msh_optimize_explain(p, o);
+			builtin_out_close(o);
+		}
+		msh_pipeline_free(p);
+		return 0;
+	}
+
+	//place pins the pipeline's processes to CPUs, and sets their priorities
+	place.set = 0;
+	if(strcmp(c->command, "place") == 0)
+	{
+		int words = msh_place_parse(c->comm_arguments, &place);
+
+		if(words == -1)
+		{
+			msh_pipeline_free(p);
+			return 0;
+		}
+		prefix_strip(p, words);
+	}
+
+	//limit sets the rlimits of the pipeline's processes, and puts its job in a cgroup
+	limits.set = 0;
+	if(strcmp(c->command, "limit") == 0)
+	{
+		int words = msh_limit_parse(c->comm_arguments, &limits);
+
+		if(words == -1)
+		{
+			msh_pipeline_free(p);
+			return 0;
+		}
+		prefix_strip(p, words);
+	}
+
+	//timeout DURATION terminates the job when the duration is over, timeout DURATION %N gives job N a deadline
+	if(strcmp(c->command, "timeout") == 0)
+	{
+		int words = timeout_parse(c->comm_arguments, &timeout_ms, &grace_ms);
+		struct msh_job * target;
+
+		if(words == -1)
+		{
+			printf("msh: timeout: usage: timeout [-k GRACE] DURATION pipeline|%%N\n");
+			msh_pipeline_free(p);
+			return 0;
+		}
+		if(c->comm_arguments[words][0] == '%' && c->comm_arguments[words + 1] == NULL)
+		{
+			target = msh_job_find(atoi(c->comm_arguments[words] + 1));
+			if(target == NULL) printf("msh: timeout: %s: no such job\n", c->comm_arguments[words]);
+			else if(msh_job_deadline(target, timeout_ms, grace_ms) == -1) perror("msh: timeout");
+			msh_pipeline_free(p);
+			return 0;
+		}
+		prefix_strip(p, words);
+	}
+
+	//rewrite redundant stages, and run what doesn't need a process in the shell
+	msh_optimize(p, out);
+	command_count = msh_pipeline_parse(p);
+	if(msh_optimize_inline(p, out, &status))
+	{
+		msh_pipeline_free(p);
+		return 0;
+	}
 
 	for(int i = 0; i < command_count; i++) //iterate through every command
 	{
@@ -201,26 +579,32 @@ msh_execute(struct msh_pipeline *p)
 		args_list = msh_command_args(c);
 
 		//check for redirection errors first
-		if(redirection_parse(c, p) != 0)
+		perr = redirection_parse(c, i == 0, i == (command_count - 1), &redirect);
+		if(perr != 0)
 		{
+			printf("%s\n", msh_pipeline_err2str(perr));
 			msh_pipeline_free(p);
 			exit(EXIT_FAILURE);
 		}
 
-		if(msh_pipeline_background(p) == 1) //change arg list for background command
+		//here-documents are read by the shell before the command starts
+		if(redirect.heredoc != NULL)
 		{
-			for(int i = 0; i < c->comm_args_count; i++)
-			{
-				if(c->comm_arguments[i + 1] == NULL) //current command is &
-				{
-					c->comm_arguments[i] = c->comm_arguments[i + 1]; //remove & symbol for execvp
-					c->comm_args_count--; //decrement argument count
-				}
-			}
+			if(redirect.heredoc_string) heredoc_fd = msh_stage_herestring(redirect.heredoc);
+			else heredoc_fd = heredoc_read(redirect.heredoc);
+			if(heredoc_fd == -1) perror("msh: here-document");
 		}
 
 		//supporting built-in commands:
-		if(strcmp(c->command, "exit") == 0) exit(EXIT_SUCCESS); //typing "exit" leaves the shells
+		if(strcmp(c->command, "exit") == 0)
+		{
+			if(out == STDOUT_FILENO && err == STDERR_FILENO) exit(EXIT_SUCCESS); //typing "exit" leaves the shells
+
+			//a pipeline with its own output is run like in a subshell, which exit only ends
+			builtin_done(&redirect, &heredoc_fd);
+			exited = 1;
+			break;
+		}
 
 		//typing cd changes the directory
 		if(strcmp(c->command, "cd") == 0)
@@ -233,7 +617,7 @@ msh_execute(struct msh_pipeline *p)
 			//cd to return home
 			if(directory == NULL || strcmp(directory, "~") == 0)
 			{
-				if(chdir(getenv("HOME")) == -1) perror("chdir");
+				if(msh_var_get("HOME") == NULL || chdir(msh_var_get("HOME")) == -1) perror("chdir");
 			}
 
 			else
@@ -241,7 +625,7 @@ msh_execute(struct msh_pipeline *p)
 				//cd w/ a specified path using ~
 				if(directory[0] == '~')
 				{
-					char * home_directory = getenv("HOME");
+					const char * home_directory = msh_var_get("HOME") != NULL ? msh_var_get("HOME") : "";
 					char * new_directory = malloc(strlen(home_directory) + strlen(directory) + 1);
 					if(new_directory == NULL) perror("cd malloc() failure");
 					strcpy(new_directory, home_directory); //add home directory as part of the new directory
@@ -258,37 +642,69 @@ msh_execute(struct msh_pipeline *p)
 				if(directory != c->comm_arguments[1]) free(directory); //free the potential malloc() on line 118
 			}
 
+			builtin_done(&redirect, &heredoc_fd);
 			continue; //other commands that still need to be executed
 		}
 
-		//changing current commands to background/foreground
-		if(strcmp(c->command, "fg") == 0)
+		//changing current commands to background/foreground: fg N and bg N, N defaults to the last job
+		if(strcmp(c->command, "fg") == 0 || strcmp(c->command, "bg") == 0)
 		{
-			char * ptr;
-			int index = (int) strtol(c->comm_arguments[1], &ptr, 10);
-			if(bg_commands[index].bg_pid != 0) //check if a command w/ index given is in background array
-			{
-				kill(bg_commands[index].bg_pid, SIGCONT);
-				fg_add(bg_commands[index].bg_pid, bg_commands[index].bg_program);//add to foreground command array using fg_add function
-				bg_commands[index].bg_pid = 0; //remove background command from array
-				bg_count--;//decrement bg_count
-				break;
-			}
-			else
+			char * ptr = "";
+			int index = -1;
+			struct msh_job * target = NULL;
+
+			if(c->comm_arguments[1] != NULL) index = (int) strtol(c->comm_arguments[1], &ptr, 10);
+			else for(int j = 0; msh_job_nth(j) != NULL; j++) target = msh_job_nth(j);
+
+			builtin_done(&redirect, &heredoc_fd);
+			if(c->comm_arguments[1] != NULL) target = msh_job_find(index);
+			if(target == NULL) //background command does not exist w/ given index
 			{
-				printf("msh: fg: %d%s: no such job\n", index, ptr); ///background command does not exit w/ given index
-				exit(EXIT_SUCCESS);
+				printf("msh: %s: %d%s: no such job\n", c->command, index, ptr);
+				continue;
 			}
+			status = exit_status(msh_job_continue(target, strcmp(c->command, "fg") == 0));
+			continue;
+		}
+
+		//wait [-n] [N...] waits for background jobs, all of them by default, or for the first one done with -n
+		if(strcmp(c->command, "wait") == 0)
+		{
+			builtin_done(&redirect, &heredoc_fd);
+			wait_builtin(c->comm_arguments);
+			continue;
+		}
+
+		//export NAME=value or export NAME puts variables in the environment
+		if(strcmp(c->command, "export") == 0)
+		{
+			builtin_done(&redirect, &heredoc_fd);
+			assignments_set(&c->comm_arguments[1], 1);
+			continue;
+		}
+
+		//coproc NAME cmd starts cmd with pipes to and from the shell, used by redirecting to %NAME
+		if(strcmp(c->command, "coproc") == 0)
+		{
+			builtin_done(&redirect, &heredoc_fd);
+			msh_coproc_builtin(c->comm_arguments, msh_pipeline_input(p));
+			continue;
 		}
 
 		//jobs prints out list of bg commands like this: [0] sleep 10
 		if(strcmp(c->command, "jobs") == 0)
 		{
-			for(int j = 0; j < bg_count; j++) printf("[%d] %s\n", j, bg_commands[j].bg_program);
-			exit(EXIT_SUCCESS);
+			FILE * o = builtin_out(out);
+
+			builtin_done(&redirect, &heredoc_fd);
+			msh_job_print(o);
+			msh_sched_print(o);
+			builtin_out_close(o);
+			continue;
 		}
 		
 		//executing commands using pipes & execvp
+		fds[0] = fds[1] = 0;
 		if(i < (command_count - 1))
 		{
 			if(pipe(fds) == -1) //set up the pipe
@@ -298,9 +714,38 @@ msh_execute(struct msh_pipeline *p)
 			}
 		}
 		
-		pid = fork(); //fork process returns 0 or the id of child
-		int redirect_status = redirect_stat(c); //check redirection status of command
-	    char * file_redirect = redirect_file(c); //file redirection
+		//the job is created with its first process
+		if(job == NULL)
+		{
+			job = msh_job_create(msh_pipeline_input(p), msh_pipeline_background(p));
+			if(job == NULL)
+			{
+				printf("msh: too many jobs\n");
+				builtin_done(&redirect, &heredoc_fd);
+				break;
+			}
+			if(limits.set && msh_limit_job(&limits, job) == -1)
+			{
+				msh_job_remove(job);
+				job = NULL;
+				if(fds[1] != 0)
+				{
+					close(fds[0]);
+					close(fds[1]);
+				}
+				builtin_done(&redirect, &heredoc_fd);
+				status = 1;
+				break;
+			}
+			if(timeout_ms != -1 && msh_job_deadline(job, timeout_ms, grace_ms) == -1) perror("msh: timeout");
+		}
+
+		fflush(stdout); //don't let the child inherit buffered output
+		//the zygote doesn't know about placements nor limits
+		pid = place.set || limits.set ? -1 : zygote_spawn(c, job, msh_pipeline_background(p), &redirect,
+		                                                       heredoc_fd != -1 ? heredoc_fd : carryover != 0 ? carryover : STDIN_FILENO,
+		                                                       fds[1] != 0 ? fds[1] : out, err);
+		if(pid == -1) pid = fork(); //fork process returns 0 or the id of child
 
 		if(pid == -1)
 		{
@@ -311,6 +756,11 @@ msh_execute(struct msh_pipeline *p)
 
 		else if(pid == 0) //child process
 		{
+			msh_job_child(job); //into the job's process group
+			msh_event_child(); //the signals the shell blocked
+			if(place.set) msh_place_child(&place, i);
+			if(limits.set) msh_limit_child(&limits);
+
 			if(carryover != 0) //not the first command
 			{
 				dup2(carryover, STDIN_FILENO); //read from carryover 
@@ -322,53 +772,53 @@ msh_execute(struct msh_pipeline *p)
 				dup2(fds[1], STDOUT_FILENO); //DUP write end of pipe into STDOUT
 				close(fds[1]); //redirect STDOUT to write side of the pipe we just created.
 			}
+			else if(out != STDOUT_FILENO) dup2(out, STDOUT_FILENO); //the pipeline's own output
+
+			if(err != STDERR_FILENO) dup2(err, STDERR_FILENO);
 
 			/*
-			REDIRECTION: 1>, 1>>, 2>, 2>>
-			1, for standout 2, for stderr
+			REDIRECTION: <, <<, <<<, 1>, 1>>, 2>, 2>>
+			0, for stdin 1, for standout 2, for stderr
 			> delete the file, then output to that file
 			>> append to exiting file
+			< read the file, << and <<< read a body the shell passes down
 			support these:
 			1. redirection of stdout via a pipe (M1)
 			2. redirection of stdout to a file
 			3. no redirection of stdout - goes to command line
 			4. redirection of stderr to a file
+			5. redirection of stdin from a file or here-document (first command only)
 
 			STDIN = 0   fds[0] = read
 			STDOUT = 1  fds[1] = write
 			*/
 
-			//redirect output
-			if(redirect_status == 1) // case: 1>
-			{
-				output_fd = open(file_redirect, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-				dup2(output_fd, STDOUT_FILENO);
-				close(output_fd);
-			}
+			//redirect input
+			if(redirect.in_file != NULL) redirect_open(redirect.in_file, O_RDONLY, STDIN_FILENO);
 
-			if(redirect_status == 2) //case: 1>>
+			if(heredoc_fd != -1)
 			{
-				output_fd = open(file_redirect, O_WRONLY | O_CREAT | O_APPEND, 0666);
-				dup2(output_fd, STDOUT_FILENO);
-				close(output_fd);
+				dup2(heredoc_fd, STDIN_FILENO);
+				close(heredoc_fd);
 			}
 
-			if(redirect_status == 3) //case: 2>
+			//redirect output
+			if(redirect.out_file != NULL)
 			{
-				output_fd = open(file_redirect, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-				dup2(output_fd, STDERR_FILENO);
-				close(output_fd);
+				redirect_open(redirect.out_file, O_WRONLY | O_CREAT | (redirect.out_append ? O_APPEND : O_TRUNC), STDOUT_FILENO);
 			}
 
-			if(redirect_status == 4) //case: 2>>
+			if(redirect.err_file != NULL)
 			{
-				output_fd = open(file_redirect, O_WRONLY | O_CREAT | O_APPEND, 0666);
-				dup2(output_fd, STDERR_FILENO);
-				close(output_fd);
+				redirect_open(redirect.err_file, O_WRONLY | O_CREAT | (redirect.err_append ? O_APPEND : O_TRUNC), STDERR_FILENO);
 			}
 
 			if(i < (command_count - 1)) close(fds[0]);
 
+			//cat/tee only move bytes, so run them here instead of exec'ing them
+			if(msh_stage_native(args_list)) _exit(msh_stage_run(args_list));
+
+			if(c->comm_env != NULL) msh_var_child(c->comm_env); //VAR=x cmd
 			execvp(program, args_list); //execute program
 			perror("msh_execute: execvp"); //execvp doesn't work
 			exit(EXIT_FAILURE);
@@ -379,55 +829,44 @@ msh_execute(struct msh_pipeline *p)
 			
 			if(fds[1] != 0) close(fds[1]);
 
-			if(i < (command_count - 1)) close(fds[1]);
+			if(heredoc_fd != -1) close(heredoc_fd);
+			heredoc_fd = -1;
+			redirection_free(&redirect);
 
 			carryover = fds[0]; //reassign carryover
 
-			if(msh_pipeline_background(p) == 0) fg_add(pid, program); //foreground process
-
-			//add background process to array that can be later found by typing jobs
-			if(msh_pipeline_background(p) == 1)
-			{
-				if(bg_count == MSH_MAXBACKGROUND) perror("max background limit reached"); //check MSH_MAXBACKGROUND limit is not reached
-
-				//memset first background
-				if(bg_count == 0) memset(bg_commands, 0, sizeof(struct bg_comms) * MSH_MAXBACKGROUND);
-				for(int i = 0; i < MSH_MAXBACKGROUND; i++)
-				{
-					if(bg_commands[i].bg_pid == 0)
-					{
-						bg_commands[i].bg_pid = pid; // add the command to array of background commands
-						bg_commands[i].bg_program = program;
-						bg_commands[i].bg_args = c->comm_arguments[1];
-						bg_count++; //incrememnt background command count
-						printf("[%d] %s %s\n", i, program, c->comm_arguments[1]); //print job order, command, & args
-						break;
-					}
-				}
-			}
+			if(job != NULL) msh_job_add_pid(job, pid);
 		}		
 	} //outside for-loop
 	
-	for(int i = 0; i < command_count; i++) //wait for commands
-	{
-		if(msh_pipeline_background(p) == 0) wait(NULL); //except for the background commands
-		fg_count = 0;
-	}
+	if(carryover != 0) close(carryover); //a builtin ended the pipeline
+	if(job != NULL) msh_job_launched(job);
+
+	if(job != NULL && msh_pipeline_background(p) == 0) status = exit_status(msh_job_wait(job)); //wait for the foreground job
+	else if(job != NULL) printf("[%d] %s\n", msh_job_id(job), msh_job_input(job)); //print job order & pipeline
 
 	msh_pipeline_free(p);
-	return;
+	return exited;
 }
 
 void
-sig_handler(int signal_number, siginfo_t *info, void *context)
+msh_execute(struct msh_pipeline *p)
+{
+	msh_execute_fds(p, STDOUT_FILENO, STDERR_FILENO);
+}
+
+//called by the event loop, not in signal context: printing and updating jobs is safe
+static void
+sig_handler(struct signalfd_siginfo *info)
 {
-	(void) info;
-	(void) context;
-	switch(signal_number){
-		//the child process has terminated
+	switch(info->ssi_signo){
+		//children have exited, stopped or continued
 		case SIGCHLD: {
-			//printf("%d: Child process %d has exited.\n", getpid(), info->si_pid);
-			//fflush(stdout);
+			int saved = status; //of the pipeline being waited for, not of the ones started
+
+			msh_job_collect();
+			msh_sched_run(); //the jobs that exited or stopped leave room for queued ones
+			status = saved;
 			break;
 		}
 		//terminate a process, sent to pipeline processes
@@ -442,52 +881,49 @@ sig_handler(int signal_number, siginfo_t *info, void *context)
 		case SIGTSTP: {
 			printf("\n%d: Cntl-Z pressed. We've been asked to suspend. Go to background\n", getpid());
 			fflush(stdout);
-			bg_count++;//increment bg count
+			msh_job_foreground(SIGTSTP); //the whole foreground job, with one killpg
 			break;
 		}
 		//terminate foreground processes with cntl-c
 		case SIGINT: {
 			printf("\n%d: Cntl-C pressed. Terminate foreground process\n", getpid());
 			fflush(stdout);
-			fg_kill();
+			msh_job_foreground(SIGINT);
+			msh_loop_interrupt(); //and the loop it was run by
 			break;
 		}
 		//run background command to foreground - user typed 'fg'
-    	case SIGCONT: {
+		case SIGCONT: {
 			fflush(stdout);
 			break;
 		}
 	}
 }
 
-void
-setup_signal(int signo, void (*fn)(int, siginfo_t *, void *))
+int
+msh_execute_status(void)
 {
-	sigset_t masked;
-	struct sigaction siginfo;
-
-	sigemptyset(&masked);
-	sigaddset(&masked, signo);
-	siginfo = (struct sigaction) {
-		.sa_sigaction = fn,
-		.sa_mask = masked,
-		.sa_flags = SA_SIGINFO
-	};
-
-	if (sigaction(signo, &siginfo, NULL) == -1)
-	{
-		perror("sigaction error");
-		exit(EXIT_FAILURE);
-	}
+	return status;
 }
 
 void
 msh_init(void)
 {
-	setup_signal(SIGCHLD, sig_handler);
-	setup_signal(SIGTERM, sig_handler);
-	setup_signal(SIGTSTP, sig_handler);
-	setup_signal(SIGINT, sig_handler);
-	setup_signal(SIGCONT, sig_handler);
+	msh_job_init();
+	if(msh_var_init() == -1)
+	{
+		perror("msh: variables");
+		exit(EXIT_FAILURE);
+	}
+	//the zygote is forked while we're small, and without the event loop's threads
+	if(msh_zygote_init() == -1) perror("msh: zygote");
+	//signals are read by the event loop instead of interrupting the shell
+	if(msh_event_init(sig_handler) == -1)
+	{
+		perror("msh: event loop");
+		exit(EXIT_FAILURE);
+	}
+	if(msh_zygote_listen() == -1) perror("msh: zygote");
+	if(msh_control_init() == -1) perror("msh: control socket");
 	return;
-}
\ No newline at end of file
+}
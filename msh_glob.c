@@ -0,0 +1,549 @@
+#define _GNU_SOURCE
+#include <msh.h>
+#include <msh_parse.h>
+#include <msh_parse_internal.h>
+#include <msh_glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+#define MSH_GLOB_BUF (32 * 1024)
+#define MSH_GLOB_MAXTHREADS 8
+
+typedef enum {
+	GLOB_CHAR,
+	GLOB_ANY, //?
+	GLOB_STAR, //*
+	GLOB_CLASS, //[...]
+} glob_token_t;
+
+struct glob_token {
+	glob_token_t type;
+	unsigned char c;
+	uint8_t set[32]; //the bytes a class matches
+};
+
+//a component of a pattern, between '/'s
+struct glob_part {
+	char * text;
+	int literal; //without wildcards: opened, never matched
+	int globstar; //**
+	int dot; //starts with a '.', so it can match hidden names
+	struct glob_token * tokens;
+	int ntokens;
+};
+
+struct glob_pattern {
+	struct glob_part * parts;
+	int nparts;
+	int dirs_only; //the pattern ended with a '/'
+};
+
+struct glob_results {
+	char ** paths;
+	size_t count;
+	size_t cap;
+};
+
+//where a walk is in the tree
+struct glob_walk {
+	struct glob_pattern * g;
+	struct glob_results * r;
+	int threads; //how many threads a ** can spread over, 1 once in a thread
+	char path[PATH_MAX]; //the directory being read, with a trailing '/' unless empty
+};
+
+//the subdirectories a ** spreads across threads
+struct glob_spread {
+	int part;
+	int dirfd;
+	char ** names;
+	size_t count;
+	atomic_size_t next; //the next name a thread takes
+};
+
+struct glob_worker {
+	pthread_t thread;
+	struct glob_spread * s;
+	struct glob_walk w;
+	struct glob_results r;
+};
+
+//Helper functions:
+
+static int
+is_redirect(char *arg)
+{
+	return strcmp(arg, "<") == 0 || strcmp(arg, "<<") == 0 || strcmp(arg, "<<<") == 0 ||
+	       strcmp(arg, "1>") == 0 || strcmp(arg, "1>>") == 0 ||
+	       strcmp(arg, "2>") == 0 || strcmp(arg, "2>>") == 0;
+}
+
+static int
+has_wildcards(char *word)
+{
+	return strpbrk(word, "*?[") != NULL;
+}
+
+//[...] starting at text, returns the length of the class, 0 if it isn't one
+static size_t
+class_compile(const char *text, struct glob_token *t)
+{
+	size_t i = 1;
+	int negate = 0;
+
+	if(text[i] == '!' || text[i] == '^')
+	{
+		negate = 1;
+		i++;
+	}
+	if(text[i] == ']') i++; //a ']' first is part of the class
+	while(text[i] != '\0' && text[i] != ']') i++;
+	if(text[i] == '\0') return 0;
+
+	memset(t->set, 0, sizeof(t->set));
+	for(size_t j = 1 + negate; j < i; j++)
+	{
+		unsigned char lo = text[j], hi = text[j];
+
+		if(text[j + 1] == '-' && j + 2 < i)
+		{
+			hi = text[j + 2];
+			j += 2;
+		}
+		for(unsigned c = lo; c <= hi; c++) t->set[c >> 3] |= 1 << (c & 7);
+	}
+	if(negate)
+	{
+		for(size_t j = 0; j < sizeof(t->set); j++) t->set[j] = ~t->set[j];
+	}
+	t->type = GLOB_CLASS;
+
+	return i + 1;
+}
+
+static int
+part_compile(struct glob_part *p, char *text)
+{
+	size_t len = strlen(text);
+
+	*p = (struct glob_part) { .text = text, .dot = text[0] == '.', .globstar = strcmp(text, "**") == 0, .literal = 1 };
+	p->tokens = calloc(len + 1, sizeof(struct glob_token));
+	if(p->tokens == NULL) return -1;
+
+	for(size_t i = 0; i < len; )
+	{
+		struct glob_token * t = &p->tokens[p->ntokens];
+		size_t n = 1;
+
+		if(text[i] == '*')
+		{
+			//** in a component is *
+			if(p->ntokens > 0 && t[-1].type == GLOB_STAR)
+			{
+				i++;
+				continue;
+			}
+			t->type = GLOB_STAR;
+		}
+		else if(text[i] == '?') t->type = GLOB_ANY;
+		else if(text[i] != '[' || (n = class_compile(text + i, t)) == 0)
+		{
+			//a '[' without its ']' is a character
+			n = 1;
+			t->type = GLOB_CHAR;
+			t->c = text[i];
+		}
+		if(t->type != GLOB_CHAR) p->literal = 0;
+		p->ntokens++;
+		i += n;
+	}
+
+	return 0;
+}
+
+static int
+token_match(struct glob_token *t, unsigned char c)
+{
+	switch(t->type)
+	{
+		case GLOB_CHAR: return t->c == c;
+		case GLOB_ANY: return 1;
+		case GLOB_CLASS: return t->set[c >> 3] & (1 << (c & 7));
+		default: return 0;
+	}
+}
+
+//matches a name against a compiled component, going back to the last * on a mismatch
+static int
+part_match(struct glob_part *p, const char *name)
+{
+	int t = 0, star = -1;
+	const char * star_name = NULL;
+
+	if(name[0] == '.' && !p->dot) return 0;
+
+	while(*name != '\0')
+	{
+		if(t < p->ntokens && p->tokens[t].type == GLOB_STAR)
+		{
+			star = ++t;
+			star_name = name;
+		}
+		else if(t < p->ntokens && token_match(&p->tokens[t], *name))
+		{
+			t++;
+			name++;
+		}
+		else if(star != -1)
+		{
+			t = star;
+			name = ++star_name;
+		}
+		else return 0;
+	}
+	while(t < p->ntokens && p->tokens[t].type == GLOB_STAR) t++;
+
+	return t == p->ntokens;
+}
+
+static int
+results_add(struct glob_results *r, const char *path, const char *name, int slash)
+{
+	if(r->count == r->cap)
+	{
+		size_t cap = r->cap == 0 ? 64 : r->cap * 2;
+		char ** grown = realloc(r->paths, cap * sizeof(char *));
+
+		if(grown == NULL) return -1;
+		r->paths = grown;
+		r->cap = cap;
+	}
+	if(asprintf(&r->paths[r->count], "%s%s%s", path, name, slash ? "/" : "") == -1) return -1;
+	r->count++;
+
+	return 0;
+}
+
+static void
+results_free(struct glob_results *r)
+{
+	for(size_t i = 0; i < r->count; i++) free(r->paths[i]);
+	free(r->paths);
+	*r = (struct glob_results) { 0 };
+}
+
+//move the paths of src to the end of dst
+static void
+results_merge(struct glob_results *dst, struct glob_results *src)
+{
+	if(dst->count + src->count > dst->cap)
+	{
+		char ** grown = realloc(dst->paths, (dst->count + src->count) * sizeof(char *));
+
+		if(grown == NULL)
+		{
+			results_free(src);
+			return;
+		}
+		dst->paths = grown;
+		dst->cap = dst->count + src->count;
+	}
+	memcpy(dst->paths + dst->count, src->paths, src->count * sizeof(char *));
+	dst->count += src->count;
+	free(src->paths);
+	*src = (struct glob_results) { 0 };
+}
+
+static int
+path_cmp(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static int
+is_dir(int dirfd, const char *name, unsigned char type, int follow)
+{
+	struct stat st;
+
+	if(type == DT_DIR) return 1;
+	if(type != DT_UNKNOWN && (type != DT_LNK || !follow)) return 0;
+	if(fstatat(dirfd, name, &st, follow ? 0 : AT_SYMLINK_NOFOLLOW) == -1) return 0;
+
+	return S_ISDIR(st.st_mode);
+}
+
+static void glob_walk(struct glob_walk *w, int part, int dirfd);
+
+//walk into the subdirectory name of the directory of w
+static void
+glob_descend(struct glob_walk *w, int part, int dirfd, const char *name)
+{
+	size_t len = strlen(w->path);
+	int fd;
+
+	if(len + strlen(name) + 2 > sizeof(w->path)) return;
+	fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if(fd == -1) return;
+
+	sprintf(w->path + len, "%s/", name);
+	glob_walk(w, part, fd);
+	w->path[len] = '\0';
+	close(fd);
+}
+
+static void *
+worker_thread(void *arg)
+{
+	struct glob_worker * worker = arg;
+	struct glob_spread * s = worker->s;
+	size_t i;
+
+	//the directories are taken one at a time, so that a large one doesn't hold back a thread's share
+	while((i = atomic_fetch_add(&s->next, 1)) < s->count) glob_descend(&worker->w, s->part, s->dirfd, s->names[i]);
+
+	return NULL;
+}
+
+//walk the subdirectories a ** goes through on threads, and merge their results
+static void
+glob_spread(struct glob_walk *w, int part, int dirfd, char **names, size_t count)
+{
+	struct glob_spread s = { .part = part, .dirfd = dirfd, .names = names, .count = count };
+	struct glob_worker * workers;
+	int nthreads = w->threads < (int)count ? w->threads : (int)count;
+	int started = 0, threads;
+
+	workers = calloc(nthreads, sizeof(struct glob_worker));
+	if(workers != NULL)
+	{
+		for(; started < nthreads; started++)
+		{
+			struct glob_worker * worker = &workers[started];
+
+			worker->s = &s;
+			worker->w.g = w->g;
+			worker->w.r = &worker->r;
+			worker->w.threads = 1;
+			strcpy(worker->w.path, w->path);
+			if(pthread_create(&worker->thread, NULL, worker_thread, worker) != 0) break;
+		}
+	}
+	//whatever no thread could be started for is walked here
+	threads = w->threads;
+	w->threads = 1;
+	for(size_t i; (i = atomic_fetch_add(&s.next, 1)) < count; ) glob_descend(w, part, dirfd, names[i]);
+	w->threads = threads;
+
+	for(int i = 0; i < started; i++)
+	{
+		pthread_join(workers[i].thread, NULL);
+		results_merge(w->r, &workers[i].r);
+	}
+	free(workers);
+}
+
+static void
+glob_walk(struct glob_walk *w, int part, int dirfd)
+{
+	struct glob_pattern * g = w->g;
+	struct glob_part * p = &g->parts[part];
+	int last = part == g->nparts - 1;
+	char * buf;
+	ssize_t n;
+	char ** subdirs = NULL; //for a ** spread across threads
+	size_t nsubdirs = 0, subdirs_cap = 0;
+
+	if(p->literal)
+	{
+		struct stat st;
+
+		if(!last) glob_descend(w, part + 1, dirfd, p->text);
+		else if(fstatat(dirfd, p->text, &st, AT_SYMLINK_NOFOLLOW) == 0 && (!g->dirs_only || is_dir(dirfd, p->text, DT_UNKNOWN, 1)))
+		{
+			results_add(w->r, w->path, p->text, g->dirs_only);
+		}
+		return;
+	}
+
+	//a ** can also be no directory at all
+	if(p->globstar && !last) glob_walk(w, part + 1, dirfd);
+
+	buf = malloc(MSH_GLOB_BUF);
+	if(buf == NULL) return;
+	lseek(dirfd, 0, SEEK_SET);
+	while((n = getdents64(dirfd, buf, MSH_GLOB_BUF)) > 0)
+	{
+		for(ssize_t pos = 0; pos < n; pos += ((struct dirent64 *)(buf + pos))->d_reclen)
+		{
+			struct dirent64 * ent = (struct dirent64 *)(buf + pos);
+			char * name = ent->d_name;
+
+			if(strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+
+			if(p->globstar)
+			{
+				//every name under a trailing **, and every directory (not a link to one) it goes through
+				if(name[0] == '.') continue;
+				if(last && (!g->dirs_only || is_dir(dirfd, name, ent->d_type, 1))) results_add(w->r, w->path, name, g->dirs_only);
+				if(!is_dir(dirfd, name, ent->d_type, 0)) continue;
+
+				if(w->threads > 1)
+				{
+					if(nsubdirs == subdirs_cap)
+					{
+						char ** grown;
+
+						subdirs_cap = subdirs_cap == 0 ? 64 : subdirs_cap * 2;
+						grown = realloc(subdirs, subdirs_cap * sizeof(char *));
+						if(grown == NULL) continue;
+						subdirs = grown;
+					}
+					if((subdirs[nsubdirs] = strdup(name)) != NULL) nsubdirs++;
+				}
+				else glob_descend(w, part, dirfd, name);
+				continue;
+			}
+
+			if(!part_match(p, name)) continue;
+			if(last)
+			{
+				if(!g->dirs_only || is_dir(dirfd, name, ent->d_type, 1)) results_add(w->r, w->path, name, g->dirs_only);
+			}
+			else if(is_dir(dirfd, name, ent->d_type, 1)) glob_descend(w, part + 1, dirfd, name);
+		}
+	}
+	free(buf);
+
+	if(subdirs != NULL)
+	{
+		glob_spread(w, part, dirfd, subdirs, nsubdirs);
+		for(size_t i = 0; i < nsubdirs; i++) free(subdirs[i]);
+		free(subdirs);
+	}
+}
+//the paths matching word, sorted, into r
+static int
+glob_word(const char *word, struct glob_results *r)
+{
+	struct glob_pattern g = { 0 };
+	struct glob_walk * w = NULL;
+	char * text = strdup(word), * save = NULL;
+	size_t len;
+	int dirfd = -1, ret = -1;
+	long nprocs;
+
+	if(text == NULL) return -1;
+	len = strlen(text);
+	while(len > 1 && text[len - 1] == '/')
+	{
+		text[--len] = '\0';
+		g.dirs_only = 1;
+	}
+	g.parts = calloc(len / 2 + 2, sizeof(struct glob_part));
+	if(g.parts == NULL) goto done;
+	for(char * part = strtok_r(text, "/", &save); part != NULL; part = strtok_r(NULL, "/", &save))
+	{
+		if(part_compile(&g.parts[g.nparts], part) == -1) goto done;
+		g.nparts++;
+	}
+	if(g.nparts == 0)
+	{
+		ret = 0;
+		goto done;
+	}
+
+	w = malloc(sizeof(struct glob_walk));
+	if(w == NULL) goto done;
+	nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+	*w = (struct glob_walk) { .g = &g, .r = r, .threads = nprocs < 1 ? 1 : nprocs > MSH_GLOB_MAXTHREADS ? MSH_GLOB_MAXTHREADS : nprocs };
+	strcpy(w->path, word[0] == '/' ? "/" : "");
+	dirfd = open(word[0] == '/' ? "/" : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if(dirfd == -1) goto done;
+
+	glob_walk(w, 0, dirfd);
+	qsort(r->paths, r->count, sizeof(char *), path_cmp);
+	ret = 0;
+done:
+	if(dirfd != -1) close(dirfd);
+	for(int i = 0; i < g.nparts; i++) free(g.parts[i].tokens);
+	free(g.parts);
+	free(w);
+	free(text);
+	return ret;
+}
+
+//replace the nth argument of c by the paths of r
+static int
+args_splice(struct msh_command *c, int nth, struct glob_results *r)
+{
+	int count = 0;
+
+	while(c->comm_arguments[count] != NULL) count++;
+	if(msh_command_args_reserve(c, count + (int)r->count) == -1) return -1;
+
+	free(c->comm_arguments[nth]);
+	memmove(&c->comm_arguments[nth + r->count], &c->comm_arguments[nth + 1], (count - nth) * sizeof(char *));
+	memcpy(&c->comm_arguments[nth], r->paths, r->count * sizeof(char *));
+	c->comm_args_count += r->count - 1;
+	free(r->paths);
+	*r = (struct glob_results) { 0 };
+
+	return 0;
+}
+//end of helper functions
+
+int
+msh_glob_expand(struct msh_pipeline *p)
+{
+	int expanded = 0;
+
+	for(int i = 0; i < MSH_MAXCMNDS && p->pipeline_commands[i] != NULL; i++)
+	{
+		struct msh_command * c = p->pipeline_commands[i];
+
+		for(int j = 0; c->comm_arguments[j] != NULL; j++)
+		{
+			struct glob_results r = { 0 };
+			size_t count;
+
+			if(!has_wildcards(c->comm_arguments[j]) || is_redirect(c->comm_arguments[j])) continue;
+			if(j > 0 && is_redirect(c->comm_arguments[j - 1])) continue;
+
+			if(glob_word(c->comm_arguments[j], &r) == -1)
+			{
+				results_free(&r);
+				return -1;
+			}
+			//a pattern matching nothing is kept as it is
+			if(r.count == 0) continue;
+
+			count = r.count;
+			if(args_splice(c, j, &r) == -1)
+			{
+				results_free(&r);
+				return -1;
+			}
+			if(j == 0)
+			{
+				char * command = strdup(c->comm_arguments[0]);
+
+				if(command == NULL) return -1;
+				free(c->command);
+				c->command = command;
+			}
+			j += count - 1;
+			expanded++;
+		}
+	}
+
+	return expanded;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+/***
+ * Glob expansion, run on parsed pipelines before they are executed.
+ * Words with `*`, `?` or `[...]` are replaced by the sorted paths
+ * they match, or kept as they are if they match nothing. A `**`
+ * component matches any number of directories: it finds the `.gz`
+ * files anywhere under `logs` with a `*.gz` component after it.
+ * Names starting with a `.` are only matched by a pattern starting
+ * with a `.`.
+ *
+ * Each component of a pattern is compiled once, and matched against
+ * directory entries read in bulk with `getdents64`. Components without
+ * wildcards aren't matched at all: they are opened directly, so a
+ * pattern only reads the directories it could match in. The
+ * subdirectories a `**` recurses into are spread across threads.
+ */
+
+struct msh_pipeline;
+
+/**
+ * `msh_glob_expand` expands the wildcards in the arguments of every
+ * command of a pipeline. Redirection targets aren't expanded. The
+ * expanded arguments can go past `MSH_MAXARGS`.
+ *
+ * - `@p` - the pipeline to expand, before its redirections are taken
+ *     out of the arguments.
+ * - `@return` - the number of words expanded, or `-1` on allocation
+ *     failure.
+ */
+int msh_glob_expand(struct msh_pipeline *p);
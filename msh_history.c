@@ -0,0 +1,485 @@
+#include <msh_history.h>
+#include <ptrie.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//a command's frecency halves every MSH_HISTORY_HALFLIFE lines typed
+#define MSH_HISTORY_HALFLIFE 500.0
+//how many matching suffixes a substring search looks at, at most
+#define MSH_HISTORY_SCAN (1 << 16)
+#define MSH_HISTORY_MAXFOUND 64
+
+//an interned line
+struct history_entry {
+	const char * line; //in the log's mapping, or allocated if typed in this shell
+	size_t len;
+	uint32_t hash;
+	double score; //how many times it was typed, decayed as of last
+	uint64_t last; //the number of the line it was last typed as
+};
+
+//the log, and the part of it that was mapped at startup
+static int log_fd = -1;
+static char * log_map;
+static size_t log_len;
+
+//the interned lines, and an open-addressing table of their index + 1
+static struct history_entry * entries;
+static size_t entries_count, entries_cap;
+static uint32_t * table;
+static size_t table_cap;
+
+static uint64_t history_clock; //how many lines were typed, the log's included
+static struct ptrie * prefix_index; //NULL until the history is first searched
+
+//a suffix of an interned line, for substring searches
+struct history_suffix {
+	uint32_t entry;
+	uint32_t offset;
+};
+
+//the suffixes of the interned lines, sorted, built the first time a
+//substring is searched for. The suffixes of the lines interned since
+//are sorted apart, and merged in once there are enough of them.
+static struct history_suffix * suffixes;
+static size_t suffixes_count;
+static struct history_suffix * recent;
+static size_t recent_count;
+static int suffixes_built;
+
+//lines typed before the history was first searched, interned after the log's
+static char ** pending;
+static size_t pending_count;
+
+//1 if lines are kept in memory: only a shell reading a terminal searches them
+static int in_memory;
+
+//held by the public functions: lines are added by the shell's thread while the
+//linenoise callbacks search the history on the input thread
+static pthread_mutex_t history_lock = PTHREAD_MUTEX_INITIALIZER;
+
+//Helper functions:
+
+//FNV-1a
+static uint32_t
+hash_line(const char *line, size_t len)
+{
+	uint32_t h = 2166136261u;
+
+	for(size_t i = 0; i < len; i++)
+	{
+		h ^= (unsigned char)line[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static int
+table_grow(void)
+{
+	size_t cap = table_cap == 0 ? 1024 : table_cap * 2;
+	uint32_t * grown = calloc(cap, sizeof(uint32_t));
+
+	if(grown == NULL) return -1;
+	for(size_t i = 0; i < entries_count; i++)
+	{
+		size_t slot = entries[i].hash & (cap - 1);
+
+		while(grown[slot] != 0) slot = (slot + 1) & (cap - 1);
+		grown[slot] = i + 1;
+	}
+	free(table);
+	table = grown;
+	table_cap = cap;
+
+	return 0;
+}
+
+static int
+suffix_cmp(const void *a, const void *b)
+{
+	const struct history_suffix * x = a, * y = b;
+	const struct history_entry * ex = &entries[x->entry], * ey = &entries[y->entry];
+	size_t lx = ex->len - x->offset, ly = ey->len - y->offset;
+	int c = memcmp(ex->line + x->offset, ey->line + y->offset, lx < ly ? lx : ly);
+
+	if(c != 0) return c;
+	return (lx > ly) - (lx < ly);
+}
+
+//compares a suffix with a pattern, as equal if the suffix starts with it
+static int
+suffix_match(struct history_suffix *x, const char *pattern, size_t len)
+{
+	const struct history_entry * e = &entries[x->entry];
+	size_t lx = e->len - x->offset;
+	int c = memcmp(e->line + x->offset, pattern, lx < len ? lx : len);
+
+	if(c != 0) return c;
+	return lx < len ? -1 : 0;
+}
+
+//the first suffix not before the pattern
+static size_t
+suffix_search(struct history_suffix *sorted, size_t n, const char *pattern, size_t len)
+{
+	size_t lo = 0, hi = n;
+
+	while(lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+
+		if(suffix_match(&sorted[mid], pattern, len) < 0) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+//merge two sorted runs of suffixes
+static void
+suffixes_merge(struct history_suffix *a, size_t na, struct history_suffix *b, size_t nb, struct history_suffix *out)
+{
+	size_t i = 0, j = 0, k = 0;
+
+	while(i < na && j < nb)
+	{
+		if(suffix_cmp(&a[i], &b[j]) <= 0) out[k++] = a[i++];
+		else out[k++] = b[j++];
+	}
+	while(i < na) out[k++] = a[i++];
+	while(j < nb) out[k++] = b[j++];
+}
+
+//index the suffixes of a newly interned line
+static int
+suffixes_add(size_t entry)
+{
+	size_t len = entries[entry].len;
+	struct history_suffix * added, * merged;
+
+	added = malloc(len * sizeof(struct history_suffix));
+	merged = malloc((recent_count + len) * sizeof(struct history_suffix));
+	if(added == NULL || merged == NULL)
+	{
+		free(added);
+		free(merged);
+		return -1;
+	}
+	for(size_t off = 0; off < len; off++) added[off] = (struct history_suffix) { entry, off };
+	qsort(added, len, sizeof(struct history_suffix), suffix_cmp);
+
+	//into the recent suffixes, which are few, so that this is cheap
+	suffixes_merge(recent, recent_count, added, len, merged);
+	free(added);
+	free(recent);
+	recent = merged;
+	recent_count += len;
+
+	//then into the bulk, once in a while so that it is amortized
+	if(recent_count > suffixes_count / 8 + 1024)
+	{
+		merged = malloc((suffixes_count + recent_count) * sizeof(struct history_suffix));
+		if(merged == NULL) return -1;
+		suffixes_merge(suffixes, suffixes_count, recent, recent_count, merged);
+		free(suffixes);
+		suffixes = merged;
+		suffixes_count += recent_count;
+		recent_count = 0;
+	}
+
+	return 0;
+}
+
+static int
+suffixes_build(void)
+{
+	size_t n = 0;
+
+	if(suffixes_built) return 0;
+	for(size_t i = 0; i < entries_count; i++) n += entries[i].len;
+
+	suffixes = malloc((n > 0 ? n : 1) * sizeof(struct history_suffix));
+	if(suffixes == NULL) return -1;
+	for(size_t i = 0; i < entries_count; i++)
+	{
+		for(size_t off = 0; off < entries[i].len; off++) suffixes[suffixes_count++] = (struct history_suffix) { i, off };
+	}
+	qsort(suffixes, suffixes_count, sizeof(struct history_suffix), suffix_cmp);
+	suffixes_built = 1;
+
+	return 0;
+}
+
+//keep the max most recently typed entries matching, most recent first
+static void
+search_collect(struct history_suffix *sorted, size_t n, const char *pattern, size_t len, uint32_t *found, int *nfound, int max, size_t *budget)
+{
+	for(size_t i = suffix_search(sorted, n, pattern, len); i < n && *budget > 0; i++, (*budget)--)
+	{
+		uint32_t entry = sorted[i].entry;
+		int k;
+
+		if(suffix_match(&sorted[i], pattern, len) != 0) break;
+		if(*nfound == max && entries[entry].last <= entries[found[max - 1]].last) continue; //older than those found
+
+		for(k = 0; k < *nfound && found[k] != entry; k++);
+		if(k < *nfound) continue; //another suffix of the same line
+
+		for(k = *nfound; k > 0 && entries[found[k - 1]].last < entries[entry].last; k--)
+		{
+			if(k < max) found[k] = found[k - 1];
+		}
+		if(k < max)
+		{
+			found[k] = entry;
+			if(*nfound < max) (*nfound)++;
+		}
+	}
+}
+
+//the entry of the line, created if it's new. Lines from the log stay in its mapping
+static struct history_entry *
+intern(const char *line, size_t len, int from_log)
+{
+	uint32_t h = hash_line(line, len);
+	size_t slot;
+	struct history_entry * e;
+
+	if((entries_count + 1) * 2 > table_cap && table_grow() == -1) return NULL;
+
+	for(slot = h & (table_cap - 1); table[slot] != 0; slot = (slot + 1) & (table_cap - 1))
+	{
+		e = &entries[table[slot] - 1];
+		if(e->hash == h && e->len == len && memcmp(e->line, line, len) == 0) return e;
+	}
+
+	if(entries_count == entries_cap)
+	{
+		size_t cap = entries_cap == 0 ? 1024 : entries_cap * 2;
+		struct history_entry * grown = realloc(entries, cap * sizeof(struct history_entry));
+
+		if(grown == NULL) return NULL;
+		entries = grown;
+		entries_cap = cap;
+	}
+	e = &entries[entries_count];
+	*e = (struct history_entry) { .line = line, .len = len, .hash = h };
+	if(!from_log)
+	{
+		char * copy = strndup(line, len);
+
+		if(copy == NULL) return NULL;
+		e->line = copy;
+	}
+	table[slot] = ++entries_count;
+	if(suffixes_built) suffixes_add(entries_count - 1);
+
+	return e;
+}
+
+//the line was typed once more: decay its score to now, and count it
+static void
+entry_use(struct history_entry *e)
+{
+	history_clock++;
+	e->score = e->score * exp2(-(double)(history_clock - e->last) / MSH_HISTORY_HALFLIFE) + 1;
+	e->last = history_clock;
+}
+
+//scores decay at the same rate, so their order is kept by log2(score) + last / halflife
+static int
+entry_rank(struct history_entry *e)
+{
+	return (int)((log2(e->score) + e->last / MSH_HISTORY_HALFLIFE) * 64) + 1;
+}
+
+static int
+index_set(struct history_entry *e)
+{
+	char buf[4096];
+	char * line = e->len < sizeof(buf) ? buf : malloc(e->len + 1);
+	int ret;
+
+	if(line == NULL) return -1;
+	memcpy(line, e->line, e->len);
+	line[e->len] = '\0';
+	ret = ptrie_set(prefix_index, line, entry_rank(e));
+	if(line != buf) free(line);
+
+	return ret;
+}
+
+//intern the log, and build the prefix index, the first time it is needed
+static int
+index_build(void)
+{
+	const char * end = log_map + log_len;
+
+	if(prefix_index != NULL) return 0;
+	prefix_index = ptrie_allocate();
+	if(prefix_index == NULL) return -1;
+
+	for(const char * line = log_map; line != NULL && line < end; )
+	{
+		const char * nl = memchr(line, '\n', end - line);
+		size_t len = (nl == NULL ? end : nl) - line;
+		struct history_entry * e;
+
+		if(len > 0 && (e = intern(line, len, 1)) != NULL) entry_use(e);
+		line = nl == NULL ? NULL : nl + 1;
+	}
+
+	for(size_t i = 0; i < pending_count; i++)
+	{
+		struct history_entry * e = intern(pending[i], strlen(pending[i]), 0);
+
+		if(e != NULL) entry_use(e);
+		free(pending[i]);
+	}
+	free(pending);
+	pending = NULL;
+	pending_count = 0;
+
+	for(size_t i = 0; i < entries_count; i++) index_set(&entries[i]);
+
+	return 0;
+}
+//end of helper functions
+
+int
+msh_history_init(void)
+{
+	char * file = getenv("MSH_HISTORY");
+	char path[4096];
+	struct stat st;
+	int persist = file != NULL || isatty(STDIN_FILENO);
+
+	in_memory = isatty(STDIN_FILENO);
+
+	if(file == NULL)
+	{
+		char * home = getenv("HOME");
+
+		if(home == NULL) return -1;
+		snprintf(path, sizeof(path), "%s/.msh_history", home);
+		file = path;
+	}
+	if(!persist || *file == '\0') return 0;
+
+	log_fd = open(file, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+	if(log_fd == -1 || fstat(log_fd, &st) == -1) return -1;
+
+	if(st.st_size > 0)
+	{
+		log_map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, log_fd, 0);
+		if(log_map == MAP_FAILED)
+		{
+			log_map = NULL;
+			return -1;
+		}
+		log_len = st.st_size;
+	}
+
+	return 0;
+}
+
+int
+msh_history_add(const char *line)
+{
+	size_t len = strlen(line);
+	int ret = 0;
+
+	if(len == 0) return -1;
+
+	//a script's lines are only logged: nothing searches them, they would pile up
+	pthread_mutex_lock(&history_lock);
+	if(in_memory && prefix_index == NULL)
+	{
+		//don't read the log before it is searched
+		char ** grown = realloc(pending, (pending_count + 1) * sizeof(char *));
+
+		if(grown != NULL) pending = grown;
+		if(grown == NULL || (pending[pending_count] = strdup(line)) == NULL) ret = -1;
+		else pending_count++;
+	}
+	else if(in_memory)
+	{
+		struct history_entry * e = intern(line, len, 0);
+
+		if(e == NULL) ret = -1;
+		else
+		{
+			entry_use(e);
+			index_set(e);
+		}
+	}
+	pthread_mutex_unlock(&history_lock);
+	if(ret == -1) return -1;
+
+	if(log_fd != -1)
+	{
+		//a single write, so that shells appending at the same time don't mix lines
+		char * record = malloc(len + 1);
+
+		if(record == NULL) return -1;
+		memcpy(record, line, len);
+		record[len] = '\n';
+		if(write(log_fd, record, len + 1) != (ssize_t)(len + 1)) perror("msh: history");
+		free(record);
+	}
+
+	return 0;
+}
+
+char *
+msh_history_hint(const char *prefix)
+{
+	char * line = NULL;
+
+	if(*prefix == '\0') return NULL;
+
+	pthread_mutex_lock(&history_lock);
+	if(index_build() == 0) line = ptrie_autocomplete(prefix_index, prefix);
+	pthread_mutex_unlock(&history_lock);
+	if(line != NULL && strlen(line) == strlen(prefix))
+	{
+		free(line);
+		return NULL;
+	}
+
+	return line;
+}
+
+int
+msh_history_search(const char *substr, char **lines, int max)
+{
+	size_t len = strlen(substr), budget = MSH_HISTORY_SCAN;
+	uint32_t found[MSH_HISTORY_MAXFOUND];
+	int nfound = 0, n = 0;
+
+	if(max > MSH_HISTORY_MAXFOUND) max = MSH_HISTORY_MAXFOUND;
+	if(len == 0 || max <= 0) return 0;
+
+	pthread_mutex_lock(&history_lock);
+	if(index_build() == 0 && suffixes_build() == 0)
+	{
+		search_collect(recent, recent_count, substr, len, found, &nfound, max, &budget);
+		search_collect(suffixes, suffixes_count, substr, len, found, &nfound, max, &budget);
+	}
+	for(int i = 0; i < nfound; i++)
+	{
+		lines[n] = strndup(entries[found[i]].line, entries[found[i]].len);
+		if(lines[n] != NULL) n++;
+	}
+	pthread_mutex_unlock(&history_lock);
+
+	return n;
+}
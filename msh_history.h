@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+
+/***
+ * The history of the lines typed in the shell. It is kept in an
+ * append-only log, `~/.msh_history` (or the file in the
+ * `MSH_HISTORY` environment variable), one line per command. At
+ * startup the log is only `mmap`ed: it is read the first time the
+ * history is searched.
+ *
+ * Lines are interned, so a command typed many times is kept once,
+ * along with its frecency: how often, and how recently, it was
+ * typed. Hints complete the line being typed to the line with the
+ * highest frecency starting with it, using a `ptrie` of the history.
+ *
+ * Lines can also be searched by any part of them, using a sorted
+ * array of the suffixes of the interned lines. Lines interned after
+ * the array was built have their suffixes sorted in a smaller array,
+ * merged into the larger one when it gets big enough, so that the
+ * array is never rebuilt.
+ *
+ * Lines are added by the shell's thread while the `linenoise`
+ * callbacks may be searching the history on the input thread: the
+ * functions below take a lock, and can be called from either.
+ */
+
+/**
+ * `msh_history_init` maps the history log. The log is only appended
+ * to if the shell is interactive, or `MSH_HISTORY` is set. Lines are
+ * only kept in memory, to be searched, if the shell is interactive.
+ *
+ * - `@return` - `0` on success, `-1` if the log couldn't be opened
+ *     (the history is then kept in memory).
+ */
+int msh_history_init(void);
+
+/**
+ * `msh_history_add` appends a line to the history.
+ *
+ * - `@line` - the borrowed line, without its newline.
+ * - `@return` - `0` on success, `-1` on failure.
+ */
+int msh_history_add(const char *line);
+
+/**
+ * `msh_history_hint` completes a prefix to the line of the history
+ * with the highest frecency.
+ *
+ * - `@prefix` - the borrowed beginning of the line.
+ * - `@return` - the completed line to `free`, or `NULL` if no line
+ *     of the history is longer and starts with `prefix`.
+ */
+char *msh_history_hint(const char *prefix);
+
+/**
+ * `msh_history_search` finds the most recently typed lines of the
+ * history containing a string.
+ *
+ * - `@substr` - the borrowed string to search for.
+ * - `@lines` - set to the lines found, most recent first, each to be
+ *     `free`d.
+ * - `@max` - the maximum number of lines to find (at most `64`).
+ * - `@return` - the number of lines found.
+ */
+int msh_history_search(const char *substr, char **lines, int max);
@@ -0,0 +1,563 @@
+#include <msh.h>
+#include <msh_job.h>
+#include <msh_event.h>
+#include <msh_timer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <termios.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+
+//waitid on a pidfd, not in every libc's headers
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+
+//a pipeline's processes, in their own process group
+struct msh_job {
+	int id; //as shown by jobs, the same for as long as it's in the table
+	pid_t pgid; //the process group, also the pid of the first process
+	pid_t pids[MSH_MAXCMNDS];
+	int exited[MSH_MAXCMNDS]; //1 once the process' exit status was collected
+	int pidfds[MSH_MAXCMNDS]; //watched by the event loop while the job is awaited, -1 otherwise
+	int nprocs; //how many processes were added
+	int nlive; //how many of them haven't exited
+	int launching; //1 until all its processes were added: it isn't done while its first ones exit
+	int status; //waitpid status of the last process of the pipeline
+	msh_job_state_t state;
+	int background;
+	char * input; //the pipeline, for jobs
+	struct termios tmodes; //the job's terminal modes, saved when it stops
+	int tmodes_saved;
+	msh_job_fn done_fn; //called when the job is removed, or NULL
+	void * done_data;
+	struct msh_timer * deadline; //SIGTERM when it expires, then SIGKILL when the grace period does
+	uint64_t grace_ms;
+	int timed_out;
+	int awaited; //by msh_job_await, which frees it: it isn't reaped meanwhile
+};
+
+//the job table, oldest job first. The foreground job is in it as well. Jobs move
+//down as the older ones leave, their ids don't.
+static struct msh_job * jobs[MSH_MAXBACKGROUND + 1];
+static int job_count;
+
+//called when any job is done
+static msh_job_fn listener;
+static void * listener_data;
+
+//the process group to forward signals to
+static pid_t foreground_pgid;
+
+//the shell's terminal, or -1 if the shell isn't interactive
+static int terminal = -1;
+static pid_t shell_pgid;
+static struct termios shell_tmodes;
+
+//Helper functions:
+
+static int
+job_index(struct msh_job *j)
+{
+	for(int i = 0; i < job_count; i++)
+	{
+		if(jobs[i] == j) return i;
+	}
+	return -1;
+}
+
+//the lowest id no job has, like POSIX shells give
+static int
+job_id_free(void)
+{
+	for(int id = 0; ; id++)
+	{
+		int used = 0;
+
+		for(int i = 0; i < job_count && !used; i++) used = jobs[i]->id == id;
+		if(!used) return id;
+	}
+}
+
+static void
+job_remove(struct msh_job *j)
+{
+	int i = job_index(j);
+
+	if(i == -1) return;
+	for(; i < job_count - 1; i++) jobs[i] = jobs[i + 1];
+	jobs[--job_count] = NULL;
+
+	for(int k = 0; k < j->nprocs; k++)
+	{
+		if(j->pidfds[k] == -1) continue;
+		msh_event_del(j->pidfds[k]);
+		close(j->pidfds[k]);
+	}
+	if(j->deadline != NULL) msh_timer_cancel(j->deadline);
+	if(j->done_fn != NULL) j->done_fn(j, j->done_data);
+	free(j->input);
+	free(j);
+}
+
+//the job's deadline expired: terminate it, and kill it if it's still there after the grace period
+static void
+job_expired(void *data)
+{
+	struct msh_job * j = data;
+
+	j->deadline = NULL;
+	if(j->timed_out)
+	{
+		msh_job_signal(j, SIGKILL);
+		return;
+	}
+
+	j->timed_out = 1;
+	fprintf(stderr, "msh: %s: timed out\n", j->input);
+	msh_job_signal(j, SIGTERM);
+	msh_job_signal(j, SIGCONT); //a stopped job gets the SIGTERM as well
+	j->deadline = msh_timer_add(j->grace_ms, job_expired, j);
+}
+
+//called by the event loop when a process of an awaited job exited
+static void
+pidfd_ready(int fd, uint32_t events, void *data)
+{
+	struct msh_job * j = data;
+	siginfo_t info = { 0 };
+
+	(void)events;
+	for(int k = 0; k < j->nprocs; k++)
+	{
+		if(j->pidfds[k] != fd) continue;
+
+		//ECHILD if SIGCHLD was handled first, or the process is the zygote's child (its status comes from the zygote)
+		if(waitid(P_PIDFD, fd, &info, WEXITED | WNOHANG) == 0 && info.si_pid != 0)
+		{
+			msh_job_update(info.si_pid, info.si_code == CLD_EXITED ? W_EXITCODE(info.si_status, 0) : W_EXITCODE(0, info.si_status));
+		}
+		msh_event_del(fd);
+		close(fd);
+		j->pidfds[k] = -1;
+	}
+}
+
+//watch the processes of a job that haven't exited
+static void
+job_pidfds(struct msh_job *j)
+{
+	for(int k = 0; k < j->nprocs; k++)
+	{
+		if(j->exited[k] || j->pidfds[k] != -1) continue;
+		j->pidfds[k] = syscall(SYS_pidfd_open, j->pids[k], 0);
+		if(j->pidfds[k] == -1) continue; //already gone, SIGCHLD tells us
+		if(msh_event_add(j->pidfds[k], EPOLLIN, pidfd_ready, j) == -1)
+		{
+			close(j->pidfds[k]);
+			j->pidfds[k] = -1;
+		}
+	}
+}
+
+//the pipeline without surrounding spaces nor the &, e.g. "sleep 10"
+static char *
+job_input(char *input)
+{
+	char * copy;
+	size_t len;
+
+	while(isspace((unsigned char)*input)) input++;
+	copy = strdup(input);
+	if(copy == NULL) return NULL;
+
+	len = strlen(copy);
+	while(len > 0 && (isspace((unsigned char)copy[len - 1]) || copy[len - 1] == '&')) copy[--len] = '\0';
+
+	return copy;
+}
+
+//all of the job's processes exited
+static void
+job_done(struct msh_job *j)
+{
+	j->state = MSH_JOB_DONE;
+	if(listener != NULL) listener(j, listener_data);
+}
+//end of helper functions
+
+void
+msh_job_init(void)
+{
+	if(!isatty(STDIN_FILENO)) return;
+	terminal = STDIN_FILENO;
+
+	//wait until we are in the foreground of the terminal
+	while(tcgetpgrp(terminal) != (shell_pgid = getpgrp())) kill(-shell_pgid, SIGTTIN);
+
+	//the terminal sends these to the foreground job, not to us
+	signal(SIGQUIT, SIG_IGN);
+	signal(SIGTTIN, SIG_IGN);
+	signal(SIGTTOU, SIG_IGN);
+
+	//our own process group, in the foreground
+	shell_pgid = getpid();
+	if(setpgid(shell_pgid, shell_pgid) == -1 && errno != EPERM) perror("msh: setpgid"); //EPERM: session leader
+	shell_pgid = getpgrp();
+	tcsetpgrp(terminal, shell_pgid);
+	tcgetattr(terminal, &shell_tmodes);
+}
+
+struct msh_job *
+msh_job_create(char *input, int background)
+{
+	struct msh_job * j;
+	int nbackground = 0;
+
+	for(int i = 0; i < job_count; i++) nbackground += jobs[i]->background;
+	if(job_count == MSH_MAXBACKGROUND + 1 || (background && nbackground >= MSH_MAXBACKGROUND)) return NULL;
+
+	j = calloc(1, sizeof(struct msh_job));
+	if(j == NULL) return NULL;
+	j->input = job_input(input);
+	if(j->input == NULL)
+	{
+		free(j);
+		return NULL;
+	}
+	j->id = job_id_free();
+	j->state = MSH_JOB_RUNNING;
+	j->background = background;
+	j->launching = 1;
+	jobs[job_count++] = j;
+
+	return j;
+}
+
+void
+msh_job_remove(struct msh_job *j)
+{
+	job_remove(j);
+}
+
+void
+msh_job_on_done(struct msh_job *j, msh_job_fn fn, void *data)
+{
+	j->done_fn = fn;
+	j->done_data = data;
+}
+
+int
+msh_job_deadline(struct msh_job *j, uint64_t ms, uint64_t grace_ms)
+{
+	if(j->deadline != NULL) msh_timer_cancel(j->deadline);
+	j->grace_ms = grace_ms;
+	j->deadline = msh_timer_add(ms, job_expired, j);
+
+	return j->deadline != NULL ? 0 : -1;
+}
+
+pid_t
+msh_job_pgid(struct msh_job *j)
+{
+	return j->pgid;
+}
+
+void
+msh_job_add_pid(struct msh_job *j, pid_t pid)
+{
+	if(j->nprocs == 0) j->pgid = pid;
+	//also done by the child: whichever runs first creates the group
+	setpgid(pid, j->pgid);
+
+	j->pidfds[j->nprocs] = -1;
+	j->pids[j->nprocs++] = pid;
+	j->nlive++;
+}
+
+void
+msh_job_launched(struct msh_job *j)
+{
+	j->launching = 0;
+	if(j->nlive == 0 && j->state != MSH_JOB_DONE) job_done(j);
+}
+
+void
+msh_job_child(struct msh_job *j)
+{
+	int signals[] = { SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGCHLD, SIGTERM, SIGCONT };
+
+	if(j != NULL)
+	{
+		pid_t pgid = j->pgid == 0 ? getpid() : j->pgid;
+
+		setpgid(0, pgid);
+		if(terminal != -1 && !j->background) tcsetpgrp(terminal, pgid);
+	}
+
+	//handled signals are reset by exec, but not ignored ones, nor for native stages
+	for(size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++) signal(signals[i], SIG_DFL);
+}
+
+struct msh_job *
+msh_job_update(pid_t pid, int status)
+{
+	for(int i = 0; i < job_count; i++)
+	{
+		struct msh_job * j = jobs[i];
+
+		for(int k = 0; k < j->nprocs; k++)
+		{
+			if(j->pids[k] != pid) continue;
+
+			if(WIFSTOPPED(status))
+			{
+				j->state = MSH_JOB_STOPPED;
+				j->status = status;
+			}
+			else if(WIFCONTINUED(status)) j->state = MSH_JOB_RUNNING;
+			else
+			{
+				if(j->exited[k]) return j; //collected by its pidfd, then by waitpid
+				j->exited[k] = 1;
+				if(k == j->nprocs - 1) j->status = status;
+				if(--j->nlive == 0 && !j->launching) job_done(j);
+			}
+			return j;
+		}
+	}
+	return NULL;
+}
+
+int
+msh_job_wait(struct msh_job *j)
+{
+	int status;
+
+	j->background = 0;
+	foreground_pgid = j->pgid;
+	if(terminal != -1)
+	{
+		tcsetpgrp(terminal, j->pgid);
+		if(j->tmodes_saved) tcsetattr(terminal, TCSADRAIN, &j->tmodes);
+	}
+
+	//SIGCHLD is handled by the event loop, which updates the job
+	msh_job_collect(); //in case it exited before we got here
+	while(j->state == MSH_JOB_RUNNING)
+	{
+		if(msh_event_wait(-1) == -1)
+		{
+			perror("msh: epoll_wait");
+			j->state = MSH_JOB_DONE;
+			break;
+		}
+	}
+
+	//the terminal is ours again
+	foreground_pgid = 0;
+	if(terminal != -1)
+	{
+		tcsetpgrp(terminal, shell_pgid);
+		tcgetattr(terminal, &j->tmodes);
+		j->tmodes_saved = 1;
+		tcsetattr(terminal, TCSADRAIN, &shell_tmodes);
+	}
+
+	status = msh_job_status(j);
+	if(j->state == MSH_JOB_STOPPED)
+	{
+		//cntl-z: the job stays in the table, and can be continued with fg or bg
+		j->background = 1;
+		printf("\n[%d] Stopped %s\n", j->id, j->input);
+		fflush(stdout);
+	}
+	else job_remove(j);
+
+	return status;
+}
+
+void
+msh_job_collect(void)
+{
+	pid_t pid;
+	int status;
+
+	while((pid = waitpid(-1, &status, WNOHANG | WUNTRACED | WCONTINUED)) > 0) msh_job_update(pid, status);
+}
+
+void
+msh_job_reap(void)
+{
+	msh_job_collect();
+
+	//the foreground job is removed by msh_job_wait, which may be waiting for it
+	for(int i = 0; i < job_count; i++)
+	{
+		if(jobs[i]->state != MSH_JOB_DONE || !jobs[i]->background || jobs[i]->awaited) continue;
+		job_remove(jobs[i]);
+		i--;
+	}
+}
+
+int
+msh_job_count(msh_job_state_t state)
+{
+	int count = 0;
+
+	for(int i = 0; i < job_count; i++) count += jobs[i]->background && jobs[i]->state == state;
+	return count;
+}
+
+msh_job_state_t
+msh_job_state(struct msh_job *j)
+{
+	return j->state;
+}
+
+const pid_t *
+msh_job_pids(struct msh_job *j, int *count)
+{
+	*count = j->nprocs;
+	return j->pids;
+}
+
+int
+msh_job_status(struct msh_job *j)
+{
+	return j->timed_out ? MSH_JOB_TIMEOUT << 8 : j->status; //an exit status, like timeout(1)
+}
+
+void
+msh_job_listen(msh_job_fn fn, void *data)
+{
+	listener = fn;
+	listener_data = data;
+}
+
+struct msh_job *
+msh_job_nth(int nth)
+{
+	if(nth < 0 || nth >= job_count) return NULL;
+	return jobs[nth];
+}
+
+struct msh_job *
+msh_job_find(int id)
+{
+	for(int i = 0; i < job_count; i++)
+	{
+		if(jobs[i]->id == id) return jobs[i];
+	}
+	return NULL;
+}
+
+int
+msh_job_id(struct msh_job *j)
+{
+	return j->id;
+}
+
+char *
+msh_job_input(struct msh_job *j)
+{
+	return j->input;
+}
+
+int
+msh_job_signal(struct msh_job *j, int sig)
+{
+	if(j->pgid == 0) return -1;
+	return killpg(j->pgid, sig);
+}
+
+void
+msh_job_foreground(int sig)
+{
+	pid_t pgid = foreground_pgid;
+
+	if(pgid > 0) killpg(pgid, sig);
+}
+
+int
+msh_job_continue(struct msh_job *j, int foreground)
+{
+	if(foreground)
+	{
+		//the terminal goes to the job before it continues
+		j->background = 0;
+		if(terminal != -1) tcsetpgrp(terminal, j->pgid);
+	}
+	if(j->state == MSH_JOB_STOPPED)
+	{
+		j->state = MSH_JOB_RUNNING;
+		msh_job_signal(j, SIGCONT);
+	}
+
+	if(foreground) return msh_job_wait(j);
+	j->background = 1;
+
+	return 0;
+}
+
+int
+msh_job_await(struct msh_job **list, int count, int any)
+{
+	struct msh_job * last = NULL;
+	int status;
+
+	for(int i = 0; i < count; i++)
+	{
+		list[i]->awaited++;
+		job_pidfds(list[i]);
+	}
+
+	for(;;)
+	{
+		int running = 0;
+
+		msh_job_collect();
+		for(int i = 0; i < count; i++)
+		{
+			if(list[i]->state == MSH_JOB_RUNNING) running++;
+			else if(any && last == NULL) last = list[i];
+		}
+		if(running == 0 || last != NULL) break;
+		if(msh_event_wait(-1) == -1)
+		{
+			perror("msh: epoll_wait");
+			break;
+		}
+	}
+	if(last == NULL) last = list[count - 1];
+	status = msh_job_status(last);
+
+	for(int i = 0; i < count; i++)
+	{
+		for(int k = 0; k < list[i]->nprocs; k++)
+		{
+			if(list[i]->pidfds[k] == -1) continue;
+			msh_event_del(list[i]->pidfds[k]);
+			close(list[i]->pidfds[k]);
+			list[i]->pidfds[k] = -1;
+		}
+		//the same job can be listed twice
+		if(--list[i]->awaited == 0 && list[i]->state == MSH_JOB_DONE) job_remove(list[i]);
+	}
+
+	return status;
+}
+
+void
+msh_job_print(FILE *out)
+{
+	for(int i = 0; i < job_count; i++) fprintf(out, "[%d] %s\n", jobs[i]->id, jobs[i]->input);
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* the exit status of a job terminated at its deadline */
+#define MSH_JOB_TIMEOUT 124
+
+/***
+ * The job table. Each pipeline the shell launches is a job: its
+ * processes are put in their own process group, so the job can be
+ * signaled as a whole with `killpg`, and a foreground job is given
+ * the terminal with `tcsetpgrp` (so `cntl-c` and `cntl-z` go straight
+ * to it). Jobs that run in the background or are stopped stay in the
+ * table, in creation order, for `jobs`, `fg` and `bg`. Each job has
+ * an id, the lowest one no other job had when it was created
+ * (starting from `0`), which it keeps until it leaves the table.
+ */
+
+struct msh_job;
+
+typedef enum {
+	MSH_JOB_RUNNING,
+	MSH_JOB_STOPPED,
+	MSH_JOB_DONE,
+} msh_job_state_t;
+
+/**
+ * `msh_job_init` is called from `msh_init`. If the shell runs on a
+ * terminal, it puts the shell in its own process group in the
+ * foreground of the terminal, and ignores the job control signals
+ * the terminal would otherwise send it.
+ */
+void msh_job_init(void);
+
+/**
+ * `msh_job_create` adds a job to the table.
+ *
+ * - `@input` - the pipeline's input, borrowed (the job keeps a copy).
+ * - `@background` - `1` if the job runs in the background.
+ * - `@return` - the job, or `NULL` if `MSH_MAXBACKGROUND` background
+ *     jobs are already in the table.
+ */
+struct msh_job *msh_job_create(char *input, int background);
+
+/**
+ * `msh_job_remove` removes a job from the table and frees it, e.g.
+ * when its first process couldn't be started.
+ */
+void msh_job_remove(struct msh_job *j);
+
+/**
+ * `msh_job_fn` is called when a job leaves the table, see
+ * `msh_job_on_done`.
+ *
+ * - `@j` - the job, whose processes all exited.
+ * - `@data` - the data passed to `msh_job_on_done`.
+ */
+typedef void (*msh_job_fn)(struct msh_job *j, void *data);
+
+/**
+ * `msh_job_on_done` sets a function to call once all the processes of
+ * a job exited, when it is removed from the table (whether it was
+ * waited for in the foreground, or reaped in the background).
+ *
+ * - `@j` - the job.
+ * - `@fn` - the function, which owns `data`.
+ * - `@data` - passed to `fn`.
+ */
+void msh_job_on_done(struct msh_job *j, msh_job_fn fn, void *data);
+
+/**
+ * `msh_job_deadline` gives a job a deadline: when it expires, the job
+ * gets `SIGTERM` (and `SIGCONT`, if it is stopped), then `SIGKILL`
+ * if it is still there after a grace period. `msh_job_wait` then
+ * returns the exit status `MSH_JOB_TIMEOUT`. The deadline is a timer
+ * of the event loop (see `msh_timer.h`).
+ *
+ * - `@j` - the job.
+ * - `@ms` - the milliseconds until the deadline.
+ * - `@grace_ms` - the milliseconds between `SIGTERM` and `SIGKILL`.
+ * - `@return` - `0` on success, `-1` if the timer couldn't be added.
+ */
+int msh_job_deadline(struct msh_job *j, uint64_t ms, uint64_t grace_ms);
+
+/**
+ * `msh_job_pgid` returns the process group of the job, or `0` if no
+ * process has been added to it yet. Children must `setpgid` into it
+ * (or create it, if it is `0`) before they `exec`.
+ */
+pid_t msh_job_pgid(struct msh_job *j);
+
+/**
+ * `msh_job_add_pid` records a process of the job in the parent. The
+ * first process added is the leader of the job's process group.
+ */
+void msh_job_add_pid(struct msh_job *j, pid_t pid);
+
+/**
+ * `msh_job_launched` is called once all the job's processes were
+ * added. Until then the job isn't done, even if the processes added
+ * so far have exited (their statuses can come from the zygote while
+ * the next ones are forked).
+ */
+void msh_job_launched(struct msh_job *j);
+
+/**
+ * `msh_job_child` is called in a child after `fork` and before
+ * `exec`: it joins the job's process group, takes the terminal if
+ * the job is in the foreground, and resets the signals the shell
+ * handles or ignores.
+ */
+void msh_job_child(struct msh_job *j);
+
+/**
+ * `msh_job_update` records the `waitpid` status of process `pid`,
+ * whichever job it belongs to.
+ *
+ * - `@return` - the job the process belongs to, or `NULL`.
+ */
+struct msh_job *msh_job_update(pid_t pid, int status);
+
+/**
+ * `msh_job_wait` runs a job in the foreground: it gets the terminal,
+ * and the shell handles events (see `msh_event_wait`) until all of
+ * its processes exit or the job is stopped (`cntl-z`), at which point
+ * it stays in the table.
+ *
+ * - `@return` - the `waitpid` status of the job's last process, the
+ *     status it was stopped with, or the exit status
+ *     `MSH_JOB_TIMEOUT` if its deadline expired.
+ */
+int msh_job_wait(struct msh_job *j);
+
+/**
+ * `msh_job_collect` collects the status of every child process that
+ * exited, stopped or continued, without blocking, and updates their
+ * jobs. It is called by the shell on `SIGCHLD`.
+ */
+void msh_job_collect(void);
+
+/**
+ * `msh_job_reap` collects the background processes that exited
+ * without blocking, and removes finished jobs from the table.
+ */
+void msh_job_reap(void);
+
+/**
+ * `msh_job_count` returns the number of background jobs in a state.
+ */
+int msh_job_count(msh_job_state_t state);
+
+/**
+ * `msh_job_state` returns whether a job runs, is stopped or is done.
+ */
+msh_job_state_t msh_job_state(struct msh_job *j);
+
+/**
+ * `msh_job_pids` returns the borrowed pids of a job's processes, in
+ * pipeline order, and sets `count` to how many there are.
+ */
+const pid_t *msh_job_pids(struct msh_job *j, int *count);
+
+/**
+ * `msh_job_status` returns the status of a job that is done, like
+ * `msh_job_wait`'s.
+ */
+int msh_job_status(struct msh_job *j);
+
+/**
+ * `msh_job_listen` sets a function to call whenever a job is done,
+ * as soon as its last process exited (before the job is removed from
+ * the table). It is the same for all jobs, unlike `msh_job_on_done`.
+ *
+ * - `@fn` - the function, or `NULL`.
+ * - `@data` - passed to `fn`.
+ */
+void msh_job_listen(msh_job_fn fn, void *data);
+
+/**
+ * `msh_job_nth` returns the `nth` job in the table, oldest first, or
+ * `NULL`. It is for going through the jobs: `nth` isn't their id.
+ */
+struct msh_job *msh_job_nth(int nth);
+
+/**
+ * `msh_job_find` returns the job with id `id`, or `NULL`.
+ */
+struct msh_job *msh_job_find(int id);
+
+/**
+ * `msh_job_id` returns the id of the job, as shown by `jobs`.
+ */
+int msh_job_id(struct msh_job *j);
+
+/**
+ * `msh_job_input` returns the job's pipeline, without the `&`.
+ */
+char *msh_job_input(struct msh_job *j);
+
+/**
+ * `msh_job_signal` sends `sig` to every process of the job with a
+ * single `killpg`.
+ */
+int msh_job_signal(struct msh_job *j, int sig);
+
+/**
+ * `msh_job_foreground` sends the foreground job, if any, `sig`. This
+ * is used to forward signals when the shell doesn't own a terminal.
+ */
+void msh_job_foreground(int sig);
+
+/**
+ * `msh_job_continue` continues a (possibly stopped) job, either in
+ * the foreground (waiting for it, see `msh_job_wait`) or in the
+ * background.
+ *
+ * - `@return` - the status returned by `msh_job_wait` in the
+ *     foreground, `0` in the background.
+ */
+int msh_job_continue(struct msh_job *j, int foreground);
+
+/**
+ * `msh_job_await` waits for background jobs to exit (or stop), for
+ * the `wait` builtin. Their processes are watched by the event loop
+ * through `pidfd`s, along with the other events, so waiting for many
+ * jobs is a single `epoll_wait` at a time. The jobs that are done are
+ * removed from the table.
+ *
+ * - `@list` - the jobs, at least one.
+ * - `@count` - how many there are.
+ * - `@any` - `1` to return once any of them is done, `0` to wait for
+ *     all of them.
+ * - `@return` - the status of the first job done with `any`, of the
+ *     last job of the list otherwise, like `msh_job_wait`'s.
+ */
+int msh_job_await(struct msh_job **list, int count, int any);
+
+/**
+ * `msh_job_print` prints the table for the `jobs` builtin, one
+ * `[N] pipeline` line per job.
+ */
+void msh_job_print(FILE *out);
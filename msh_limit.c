@@ -0,0 +1,293 @@
+#define _GNU_SOURCE
+#include <msh_limit.h>
+#include <msh_job.h>
+#include <msh_var.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static unsigned long cgroups_created; //to name the cgroups of the jobs
+
+//Helper functions:
+
+//a size like 512M
+static long long
+size_parse(const char *str)
+{
+	char * end;
+	long long size = strtoll(str, &end, 10);
+
+	if(end == str || size < 0) return -1;
+	switch(*end)
+	{
+		case 'K': size <<= 10; end++; break;
+		case 'M': size <<= 20; end++; break;
+		case 'G': size <<= 30; end++; break;
+	}
+	return *end == '\0' ? size : -1;
+}
+
+//write a string to a file of a cgroup
+static int
+cgroup_write(const char *cgroup, const char *file, const char *value)
+{
+	char path[PATH_MAX];
+	int fd, ret = 0;
+
+	snprintf(path, sizeof(path), "%s/%s", cgroup, file);
+	fd = open(path, O_WRONLY | O_CLOEXEC);
+	if(fd == -1) return -1;
+	if(write(fd, value, strlen(value)) == -1) ret = -1;
+	close(fd);
+
+	return ret;
+}
+
+//read a file of a cgroup, 0 on success
+static int
+cgroup_read(const char *cgroup, const char *file, char *buf, size_t size)
+{
+	char path[PATH_MAX];
+	ssize_t n;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", cgroup, file);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if(fd == -1) return -1;
+	n = read(fd, buf, size - 1);
+	close(fd);
+	if(n < 0) return -1;
+	buf[n] = '\0';
+
+	return 0;
+}
+
+//the directory of the shell's cgroup: its path in /proc/self/cgroup, under the cgroup2 mount
+static int
+cgroup_base(char *base, size_t size)
+{
+	char line[PATH_MAX], mount[PATH_MAX] = "", path[PATH_MAX] = "";
+	const char * env = msh_var_get("MSH_CGROUP");
+	FILE * f;
+
+	if(env != NULL)
+	{
+		snprintf(base, size, "%s", env);
+		return 0;
+	}
+
+	f = fopen("/proc/self/cgroup", "re");
+	if(f == NULL) return -1;
+	while(fgets(line, sizeof(line), f) != NULL)
+	{
+		if(strncmp(line, "0::", 3) == 0) sscanf(line + 3, "%s", path);
+	}
+	fclose(f);
+
+	//mountinfo: id parent dev root mountpoint options... - type source options
+	f = fopen("/proc/self/mountinfo", "re");
+	if(f == NULL) return -1;
+	while(fgets(line, sizeof(line), f) != NULL)
+	{
+		char point[PATH_MAX];
+		char * sep = strstr(line, " - ");
+
+		if(sep == NULL || strncmp(sep + 3, "cgroup2 ", 8) != 0) continue;
+		if(sscanf(line, "%*s %*s %*s %*s %s", point) == 1) strcpy(mount, point);
+		break;
+	}
+	fclose(f);
+
+	if(mount[0] == '\0' || path[0] == '\0')
+	{
+		errno = ENOENT;
+		return -1;
+	}
+	snprintf(base, size, "%s%s", mount, strcmp(path, "/") == 0 ? "" : path);
+
+	return 0;
+}
+
+//the value of a key in a file like cpu.stat, -1 if it isn't there
+static long long
+stat_value(const char *stats, const char *key)
+{
+	size_t len = strlen(key);
+
+	for(const char * line = stats; line != NULL && *line != '\0'; line = strchr(line, '\n'))
+	{
+		if(*line == '\n') line++;
+		if(strncmp(line, key, len) == 0 && line[len] == ' ') return atoll(line + len + 1);
+	}
+	return -1;
+}
+
+//called when the job is done: report what it used, and remove its cgroup
+static void
+cgroup_done(struct msh_job *j, void *data)
+{
+	char * cgroup = data;
+	char buf[1024];
+	long long peak = -1, usage = -1, throttled = -1, throttled_usec = -1;
+
+	if(cgroup_read(cgroup, "memory.peak", buf, sizeof(buf)) == 0) peak = atoll(buf);
+	if(cgroup_read(cgroup, "cpu.stat", buf, sizeof(buf)) == 0)
+	{
+		usage = stat_value(buf, "usage_usec");
+		throttled = stat_value(buf, "nr_throttled");
+		throttled_usec = stat_value(buf, "throttled_usec");
+	}
+
+	fprintf(stderr, "msh: limit: %s:", msh_job_input(j));
+	if(peak != -1) fprintf(stderr, " memory peak %lldK,", peak >> 10);
+	if(usage != -1) fprintf(stderr, " cpu %lldms", usage / 1000);
+	if(throttled > 0) fprintf(stderr, ", throttled %lld times for %lldms", throttled, throttled_usec / 1000);
+	fprintf(stderr, "\n");
+
+	if(rmdir(cgroup) == -1) fprintf(stderr, "msh: limit: %s: %s\n", cgroup, strerror(errno));
+	free(cgroup);
+}
+//end of helper functions
+
+int
+msh_limit_parse(char **args, struct msh_limit *limit)
+{
+	int i = 1;
+
+	*limit = (struct msh_limit) { .set = 1, .as = RLIM_INFINITY, .cpu = RLIM_INFINITY, .nofile = RLIM_INFINITY, .memory_max = -1 };
+	for(; args[i] != NULL && args[i][0] == '-' && args[i + 1] != NULL; i += 2)
+	{
+		char * opt = args[i], * value = args[i + 1], * end;
+		long long n;
+
+		if(strcmp(opt, "--") == 0) return i + 1;
+		if(strcmp(opt, "-c") == 0)
+		{
+			limit->cpus = strtod(value, &end);
+			if(*end == '\0' && limit->cpus > 0) continue;
+		}
+		else if(strcmp(opt, "-m") == 0 && (limit->memory_max = size_parse(value)) != -1) continue;
+		else if((n = size_parse(value)) != -1)
+		{
+			if(strcmp(opt, "-v") == 0) limit->as = n;
+			else if(strcmp(opt, "-t") == 0) limit->cpu = n;
+			else if(strcmp(opt, "-n") == 0) limit->nofile = n;
+			else n = -1;
+			if(n != -1) continue;
+		}
+		printf("msh: limit: %s %s: invalid option\n", opt, value);
+		return -1;
+	}
+	if(args[i] == NULL || args[i][0] == '-')
+	{
+		printf("msh: limit: usage: limit [-v SIZE] [-t SECONDS] [-n FILES] [-m SIZE] [-c CPUS] pipeline\n");
+		return -1;
+	}
+
+	return i;
+}
+
+int
+msh_limit_job(struct msh_limit *limit, struct msh_job *j)
+{
+	char base[PATH_MAX - 64], value[64];
+	char * cgroup;
+	int memory_err = 0, cpu_err = 0;
+
+	limit->cgroup = NULL;
+	if(limit->memory_max == -1 && limit->cpus == 0) return 0;
+
+	cgroup = malloc(PATH_MAX);
+	if(cgroup == NULL || cgroup_base(base, sizeof(base)) == -1)
+	{
+		memory_err = cpu_err = cgroup == NULL ? ENOMEM : errno;
+		free(cgroup);
+		cgroup = NULL;
+	}
+	else
+	{
+		snprintf(cgroup, PATH_MAX, "%s/msh.%d.%lu", base, getpid(), cgroups_created++);
+		if(mkdir(cgroup, 0755) == -1)
+		{
+			memory_err = cpu_err = errno;
+			fprintf(stderr, "msh: limit: %s: %s\n", cgroup, strerror(errno));
+			free(cgroup);
+			cgroup = NULL;
+		}
+	}
+
+	//the controllers may have to be enabled for the children of the base first, which cgroup v2
+	//refuses while the base has processes of its own
+	if(cgroup != NULL && limit->memory_max != -1)
+	{
+		snprintf(value, sizeof(value), "%lld", limit->memory_max);
+		if(cgroup_write(cgroup, "memory.max", value) == -1)
+		{
+			cgroup_write(base, "cgroup.subtree_control", "+memory");
+			if(cgroup_write(cgroup, "memory.max", value) == -1) memory_err = errno;
+		}
+	}
+	if(cgroup != NULL && limit->cpus != 0)
+	{
+		snprintf(value, sizeof(value), "%ld 100000", (long)(limit->cpus * 100000));
+		if(cgroup_write(cgroup, "cpu.max", value) == -1)
+		{
+			cgroup_write(base, "cgroup.subtree_control", "+cpu");
+			if(cgroup_write(cgroup, "cpu.max", value) == -1) cpu_err = errno;
+		}
+	}
+
+	//a CPU limit has no rlimit to fall back on: the job isn't run without it
+	if(limit->cpus != 0 && cpu_err != 0)
+	{
+		fprintf(stderr, "msh: limit: -c: cpu.max: %s, not run\n", strerror(cpu_err));
+		if(cgroup != NULL) rmdir(cgroup);
+		free(cgroup);
+		return -1;
+	}
+	//the memory of the job as a whole becomes the address space of each of its processes
+	if(limit->memory_max != -1 && memory_err != 0)
+	{
+		fprintf(stderr, "msh: limit: -m: memory.max: %s, limiting the address space of each process instead\n", strerror(memory_err));
+		if((rlim_t)limit->memory_max < limit->as) limit->as = limit->memory_max;
+		if(limit->cpus == 0 && cgroup != NULL)
+		{
+			rmdir(cgroup);
+			free(cgroup);
+			cgroup = NULL;
+		}
+	}
+	if(cgroup == NULL) return 0;
+
+	limit->cgroup = cgroup;
+	msh_job_on_done(j, cgroup_done, cgroup);
+
+	return 0;
+}
+
+void
+msh_limit_child(struct msh_limit *limit)
+{
+	struct rlimit r;
+
+	//the children of the process are in the cgroup as well; outside of it, nothing limits them
+	if(limit->cgroup != NULL && cgroup_write(limit->cgroup, "cgroup.procs", "0") == -1)
+	{
+		perror("msh: limit: cgroup.procs");
+		_exit(EXIT_FAILURE);
+	}
+
+	r.rlim_cur = r.rlim_max = limit->as;
+	if(limit->as != RLIM_INFINITY && setrlimit(RLIMIT_AS, &r) == -1) perror("msh: limit: RLIMIT_AS");
+	//SIGXCPU at the limit, SIGKILL a second later if it is ignored
+	r.rlim_cur = limit->cpu;
+	r.rlim_max = limit->cpu + 1;
+	if(limit->cpu != RLIM_INFINITY && setrlimit(RLIMIT_CPU, &r) == -1) perror("msh: limit: RLIMIT_CPU");
+	r.rlim_cur = r.rlim_max = limit->nofile;
+	if(limit->nofile != RLIM_INFINITY && setrlimit(RLIMIT_NOFILE, &r) == -1) perror("msh: limit: RLIMIT_NOFILE");
+}
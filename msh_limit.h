@@ -0,0 +1,68 @@
+#pragma once
+
+#include <sys/resource.h>
+
+/***
+ * Resource limits for a pipeline:
+ *
+ *     limit [-v SIZE] [-t SECONDS] [-n FILES] [-m SIZE] [-c CPUS] pipeline
+ *
+ * - `-v`, `-t` and `-n` are the `RLIMIT_AS`, `RLIMIT_CPU` and
+ *   `RLIMIT_NOFILE` of each process of the pipeline, set with
+ *   `setrlimit` between `fork` and `exec`,
+ * - `-m` (`memory.max`) and `-c` (`cpu.max`, e.g. `0.5` for half a
+ *   CPU) limit the job as a whole: it is put in its own cgroup (v2).
+ *
+ * Sizes are in bytes, or with a `K`, `M` or `G` suffix. The job's
+ * cgroup is created in `$MSH_CGROUP`, or in the shell's own cgroup.
+ * That cgroup must be writable (delegated to the user) and have the
+ * `memory` and `cpu` controllers enabled in its
+ * `cgroup.subtree_control`, which cgroup v2 refuses for a cgroup that
+ * has processes: the shell's own cgroup can only be used if the shell
+ * was moved into a leaf child of it first, so `$MSH_CGROUP` should
+ * usually be set. If `memory.max` can't be set, `-m` falls back to the
+ * `RLIMIT_AS` of each process (which is reported); if `cpu.max` can't
+ * be set, the pipeline isn't run. When the job is done, whether it
+ * ran in the foreground or not, its peak memory use (`memory.peak`),
+ * CPU time and throttling (`cpu.stat`) are reported, and the cgroup
+ * is removed.
+ */
+
+struct msh_job;
+
+struct msh_limit {
+	int set; //0 if the pipeline has no limits
+	rlim_t as, cpu, nofile; //RLIM_INFINITY if not set
+	long long memory_max; //-1 if not set
+	double cpus; //0 if not set
+	char * cgroup; //the job's cgroup, once created, owned by the job
+};
+
+/**
+ * `msh_limit_parse` reads the options of a `limit` prefix.
+ *
+ * - `@args` - the borrowed words of the command, starting with
+ *     `limit`.
+ * - `@limit` - set to the limits.
+ * - `@return` - the number of words of the prefix (`limit` and its
+ *     options), or `-1` if they are wrong (an error is printed).
+ */
+int msh_limit_parse(char **args, struct msh_limit *limit);
+
+/**
+ * `msh_limit_job` creates the cgroup of a job, if its limits need one,
+ * and reports and removes it when the job is done.
+ *
+ * - `@limit` - the limits, whose `RLIMIT_AS` takes the place of a
+ *     memory limit the cgroup couldn't have.
+ * - `@j` - the job, created before its processes.
+ * - `@return` - `0` on success, `-1` if the job mustn't be run: its
+ *     CPU limit couldn't be set (an error is printed).
+ */
+int msh_limit_job(struct msh_limit *limit, struct msh_job *j);
+
+/**
+ * `msh_limit_child` applies the limits to a process of the pipeline,
+ * in the child before it is executed.
+ */
+void msh_limit_child(struct msh_limit *limit);
@@ -0,0 +1,283 @@
+#define _GNU_SOURCE
+#include <msh.h>
+#include <msh_parse.h>
+#include <msh_parse_internal.h>
+#include <msh_loop.h>
+#include <msh_var.h>
+#include <msh_glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <signal.h>
+
+static int interrupted; //set by the event loop, which runs on the shell's thread, or once a job got a Ctrl-C
+
+//Helper functions:
+
+static char *
+skip_spaces(char *s)
+{
+	while(*s == ' ') s++;
+	return s;
+}
+
+//tells us if s starts with the word kw
+static int
+keyword(const char *s, const char *kw)
+{
+	size_t len = strlen(kw);
+
+	return strncmp(s, kw, len) == 0 && (s[len] == ' ' || s[len] == ';' || s[len] == '{' || s[len] == '\0');
+}
+
+//tells us if the len bytes of name are a variable name
+static int
+name_valid(const char *name, size_t len)
+{
+	if(len == 0 || isdigit((unsigned char)name[0])) return 0;
+	for(size_t i = 0; i < len; i++)
+	{
+		if(name[i] != '_' && !isalnum((unsigned char)name[i])) return 0;
+	}
+	return 1;
+}
+
+//parse the body of a loop once, the template of its iterations
+static struct msh_sequence *
+body_parse(char *body)
+{
+	struct msh_sequence * s = msh_sequence_alloc();
+	msh_err_t err;
+
+	if(s == NULL) return NULL;
+	msh_sequence_expander(s, msh_var_expand, NULL);
+	err = msh_sequence_parse(body, s);
+	if(err != 0)
+	{
+		printf("MSH Error: %s\n", msh_pipeline_err2str(err));
+		msh_sequence_free(s);
+		return NULL;
+	}
+	return s;
+}
+
+//add a word to the end of the command's arguments, growing them past MSH_MAXARGS
+static int
+word_add(struct msh_command *c, const char *word, size_t len)
+{
+	int n = 0;
+
+	while(c->comm_arguments[n] != NULL) n++;
+	if(msh_command_args_reserve(c, n + 2) == -1) return -1;
+	c->comm_arguments[n] = strndup(word, len);
+	if(c->comm_arguments[n] == NULL) return -1;
+	c->comm_args_count++;
+
+	return 0;
+}
+
+//add the words of a for loop's list to the command, expanded like a command's: a word
+//with a $ is replaced by the words of its value, and a $(...) is a single word
+static int
+words_add(struct msh_command *c, const char *list, size_t len)
+{
+	const char * end = list + len;
+
+	while(list < end)
+	{
+		const char * word;
+		int depth = 0;
+
+		while(list < end && *list == ' ') list++;
+		for(word = list; list < end && (depth > 0 || *list != ' '); list++)
+		{
+			if(list[0] == '$' && list + 1 < end && list[1] == '(')
+			{
+				depth++;
+				list++;
+			}
+			else if(depth > 0 && *list == '(') depth++;
+			else if(depth > 0 && *list == ')') depth--;
+		}
+		if(list == word) break;
+
+		if(memchr(word, '$', list - word) != NULL)
+		{
+			char * raw = strndup(word, list - word), * expanded, * save = NULL;
+			int failed = 0;
+
+			expanded = raw != NULL ? msh_var_expand(raw, NULL) : NULL;
+			free(raw);
+			if(expanded == NULL) return -1;
+			for(char * w = strtok_r(expanded, " \t\n", &save); w != NULL && !failed; w = strtok_r(NULL, " \t\n", &save))
+			{
+				failed = word_add(c, w, strlen(w)) == -1;
+			}
+			free(expanded);
+			if(failed) return -1;
+		}
+		else if(word_add(c, word, list - word) == -1) return -1;
+	}
+	return 0;
+}
+
+//run a copy of the body n times, with var set to each of the words if it's a for loop
+static void
+body_run(struct msh_sequence *body, const char *var, char **words, long n)
+{
+	interrupted = 0;
+	for(long i = 0; i < n && !interrupted; i++)
+	{
+		struct msh_sequence * s;
+		struct msh_pipeline * p;
+
+		if(var != NULL && msh_var_set(var, words[i]) == -1)
+		{
+			perror("msh: for");
+			break;
+		}
+		s = msh_sequence_copy(body);
+		if(s == NULL)
+		{
+			perror("msh: loop");
+			break;
+		}
+		//the terminal sends a Ctrl-C to the foreground job, not to the shell: its status tells
+		while(!interrupted && (p = msh_sequence_pipeline(s)) != NULL)
+		{
+			msh_execute(p);
+			if(msh_execute_status() == 128 + SIGINT) interrupted = 1;
+		}
+		if(msh_sequence_error(s, NULL) != 0)
+		{
+			printf("MSH Error: %s\n", msh_pipeline_err2str(msh_sequence_error(s, NULL)));
+			msh_sequence_free(s);
+			break;
+		}
+		msh_sequence_free(s);
+	}
+}
+
+//repeat N { body }
+static void
+repeat_run(char *line)
+{
+	char * open = strchr(line, '{'), * close = strrchr(line, '}');
+	char * count, * expanded, * end;
+	struct msh_sequence * body;
+	long n;
+
+	if(open == NULL || close == NULL || close < open || *skip_spaces(close + 1) != '\0')
+	{
+		printf("msh: repeat: usage: repeat N { pipelines }\n");
+		return;
+	}
+
+	count = strndup(line, open - line);
+	expanded = count != NULL ? msh_var_expand(count, NULL) : NULL;
+	free(count);
+	if(expanded == NULL)
+	{
+		perror("msh: repeat");
+		return;
+	}
+	end = expanded + strlen(expanded);
+	while(end > expanded && end[-1] == ' ') *--end = '\0';
+	n = strtol(expanded, &end, 10);
+	if(end == expanded || *end != '\0' || n < 0)
+	{
+		printf("msh: repeat: %s: not a count\n", skip_spaces(expanded));
+		free(expanded);
+		return;
+	}
+	free(expanded);
+
+	*close = '\0';
+	body = body_parse(open + 1);
+	*close = '}';
+	if(body == NULL) return;
+	body_run(body, NULL, NULL, n);
+	msh_sequence_free(body);
+}
+
+//for NAME in WORDS; do body; done
+static void
+for_run(char *line)
+{
+	char * name = skip_spaces(line), * in, * words, * semi, * body_start, * body_end, * list;
+	struct msh_sequence * body, * s;
+	struct msh_pipeline * p;
+	size_t name_len = strcspn(name, " ;");
+	char ** args;
+	char program[] = "for";
+
+	in = skip_spaces(name + name_len);
+	semi = strchr(in, ';');
+	body_start = semi != NULL ? skip_spaces(semi + 1) : NULL;
+	body_end = line + strlen(line);
+	while(body_end > line && body_end[-1] == ' ') body_end--;
+	if(!name_valid(name, name_len) || !keyword(in, "in") || body_start == NULL || !keyword(body_start, "do") ||
+	   body_end - body_start < 6 || strncmp(body_end - 4, "done", 4) != 0)
+	{
+		printf("msh: for: usage: for NAME in WORDS; do pipelines; done\n");
+		return;
+	}
+	words = in + 2;
+	body_start += 2;
+	body_end -= 4;
+	//the ; before done is optional
+	while(body_end > body_start && (body_end[-1] == ' ' || body_end[-1] == ';')) body_end--;
+
+	//the words are expanded as the arguments of a command, as many as there are
+	s = body_parse(program);
+	if(s == NULL) return;
+	p = msh_sequence_pipeline(s);
+	if(p == NULL && msh_sequence_error(s, NULL) != 0) printf("MSH Error: %s\n", msh_pipeline_err2str(msh_sequence_error(s, NULL)));
+	msh_sequence_free(s);
+	if(p == NULL) return;
+	if(words_add(msh_pipeline_command(p, 0), words, semi - words) == -1 || msh_glob_expand(p) == -1) perror("msh: for");
+	args = msh_command_args(msh_pipeline_command(p, 0));
+
+	list = strndup(body_start, body_end - body_start);
+	body = list != NULL ? body_parse(list) : NULL;
+	free(list);
+	if(body != NULL)
+	{
+		char * var = strndup(name, name_len);
+		long n = 0;
+
+		while(args[n + 1] != NULL) n++;
+		if(var != NULL) body_run(body, var, args + 1, n);
+		free(var);
+		msh_sequence_free(body);
+	}
+	msh_pipeline_free(p);
+}
+//end of helper functions
+
+int
+msh_loop_line(char *line)
+{
+	line = skip_spaces(line);
+
+	return keyword(line, "repeat") || keyword(line, "for");
+}
+
+int
+msh_loop_run(char *line)
+{
+	line = skip_spaces(line);
+
+	if(keyword(line, "repeat")) repeat_run(line + strlen("repeat"));
+	else if(keyword(line, "for")) for_run(line + strlen("for"));
+	else return 0;
+
+	return 1;
+}
+
+void
+msh_loop_interrupt(void)
+{
+	interrupted = 1;
+}
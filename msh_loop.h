@@ -0,0 +1,39 @@
+#pragma once
+
+/***
+ * Loops. A loop is a whole line:
+ *
+ * - `repeat N { pipelines }` runs the pipelines `N` times.
+ * - `for NAME in WORDS; do pipelines; done` runs the pipelines with
+ *     the variable `NAME` set to each of the words, after they are
+ *     expanded (variables, `$(...)` and globs).
+ *
+ * The body of a loop is parsed once, into a sequence that is copied
+ * for each iteration: an iteration only sets the loop's variable and
+ * expands the words that refer to variables, instead of reading,
+ * parsing and freeing the whole line again.
+ */
+
+/**
+ * `msh_loop_line` tells if a line is a loop, without running it.
+ *
+ * - `@line` - the borrowed line.
+ * - `@return` - `1` if `msh_loop_run` would run it, `0` otherwise.
+ */
+int msh_loop_line(char *line);
+
+/**
+ * `msh_loop_run` runs a line if it is a loop.
+ *
+ * - `@line` - the borrowed line typed.
+ * - `@return` - `1` if the line was a loop (that was run, or whose
+ *     error was printed), `0` if it must be run as a sequence.
+ */
+int msh_loop_run(char *line);
+
+/**
+ * `msh_loop_interrupt` stops the loop running, e.g. on a `Ctrl-C`,
+ * after its current pipeline. A loop also stops once one of its
+ * pipelines was killed by `SIGINT`.
+ */
+void msh_loop_interrupt(void);
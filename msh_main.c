@@ -1,5 +1,12 @@
 #include <msh.h>
 #include <msh_parse.h>
+#include <msh_event.h>
+#include <msh_complete.h>
+#include <msh_history.h>
+#include <msh_var.h>
+#include <msh_loop.h>
+#include <msh_sched.h>
+#include <msh_compile.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,13 +20,31 @@ msh_input(void)
 	char *line;
 
 	/* You can change this displayed string to whatever you'd like ;-) */
-	line = linenoise("msh > ");
+	line = msh_event_readline("msh > ");
+
+	/* ?text is a search: Enter runs the line its hint shows, the most recent containing text */
+	while (line && line[0] == '?') {
+		char *found;
+
+		if (msh_history_search(line + 1, &found, 1) == 0) {
+			printf("msh: %s: no line found\n", line);
+			free(line);
+			line = msh_event_readline("msh > ");
+			continue;
+		}
+		printf("%s\n", found);
+		free(line);
+		line = found;
+	}
 	if (line && strlen(line) == 0) {
 		free(line);
 
 		return NULL;
 	}
-	if (line) linenoiseHistoryAdd(line);
+	if (line) {
+		linenoiseHistoryAdd(line);
+		msh_history_add(line);
+	}
 
 	return line;
 }
@@ -29,8 +54,12 @@ main(int argc, char *argv[])
 {
 	struct msh_sequence *s;
 
-	if (argc > 1) {
-		fprintf(stderr, "Usage: %s\n", argv[0]);
+	/* scripts compiled once are run without parsing them again */
+	if (argc == 5 && strcmp(argv[1], "--compile") == 0 && strcmp(argv[3], "-o") == 0) {
+		return msh_compile(argv[2], argv[4]) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+		fprintf(stderr, "Usage: %s [script.mshc]\n       %s --compile script.msh -o script.mshc\n", argv[0], argv[0]);
 
 		return EXIT_FAILURE;
 	}
@@ -47,19 +76,45 @@ main(int argc, char *argv[])
 		printf("MSH Error: Could not allocate msh sequence at initialization\n");
 		return EXIT_FAILURE;
 	}
+	/* $NAME is replaced by the variable as each pipeline is dequeued to run */
+	msh_sequence_expander(s, msh_var_expand, NULL);
+
+	if (argc == 2) {
+		int ret = msh_compile_run(argv[1], s);
+
+		msh_sched_finish();
+		msh_sequence_free(s);
+
+		return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	/* <TAB> completes program names, and hints suggest them */
+	linenoiseSetCompletionCallback(msh_complete);
+	linenoiseSetHintsCallback(msh_hint);
+	linenoiseSetFreeHintsCallback(msh_hint_free);
+	msh_complete_init();
+	msh_history_init();
 
 	/* Lets keep getting inputs! */
 	while (1) {
 		char *str;
 		struct msh_pipeline *p;
 		msh_err_t err;
+		size_t pos;
 
 		str = msh_input();
 		if (!str) break; /* you must maintain this behavior: an empty command exits */
 
+		/* loops parse their body once, and run it themselves */
+		if (msh_loop_run(str)) {
+			free(str);
+			continue;
+		}
+
 		err = msh_sequence_parse(str, s);
 		if (err != 0) {
-			printf("MSH Error: %s\n", msh_pipeline_err2str(err));
+			msh_sequence_error(s, &pos);
+			printf("MSH Error: %s (column %zu)\n", msh_pipeline_err2str(err), pos + 1);
 
 			return err;
 		}
@@ -68,9 +123,14 @@ main(int argc, char *argv[])
 		while ((p = msh_sequence_pipeline(s)) != NULL) {
 			msh_execute(p);
 		}
+		/* a pipeline whose words couldn't be expanded isn't run, nor the rest of the input */
+		err = msh_sequence_error(s, &pos);
+		if (err != 0) printf("MSH Error: %s (column %zu)\n", msh_pipeline_err2str(err), pos + 1);
 
 		free(str);
 	}
+	/* background pipelines still queued are started before we exit */
+	msh_sched_finish();
 	msh_sequence_free(s);
 
 	return 0;
@@ -0,0 +1,570 @@
+#define _GNU_SOURCE
+#include <msh.h>
+#include <msh_parse.h>
+#include <msh_parse_internal.h>
+#include <msh_memo.h>
+#include <msh_var.h>
+#include <msh_event.h>
+#include <msh_util.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+
+#define MSH_MEMO_MAGIC "mshmemo2"
+#define MSH_MEMO_MAX_DEFAULT (64L * 1024 * 1024)
+//so that builtins and echo run in the shell can write their output before the loop copies it
+#define MSH_MEMO_PIPE_SIZE (1024 * 1024)
+#define MSH_MEMO_INPUTS MSH_MAXARGS
+
+//a result: the header, then its key, the standard output, and the standard error
+struct memo_header {
+	char magic[8];
+	int32_t status;
+	uint64_t key_len;
+	uint64_t out_len;
+	uint64_t err_len;
+};
+
+//the key of a result: the words, directory, variables and inputs it depends on, compared
+//before it is replayed, as their hash naming it can collide
+struct memo_key {
+	char * buf;
+	size_t len, cap;
+	uint64_t hash;
+};
+
+//the output of a pipeline run on a miss, copied to where it went and kept for the result
+struct memo_tee {
+	int from; //the read end of the pipe it's written to
+	int to; //where it went
+	char * buf;
+	size_t len, cap;
+	size_t max; //more isn't kept, -1 once it was exceeded
+	int eof; //1 once no process has the pipe anymore
+	int detached; //1 if its result was given up on: it copies until the end, and frees itself then
+};
+
+//what a pipeline's result depends on, besides its words
+struct memo_deps {
+	char * inputs[MSH_MEMO_INPUTS];
+	int inputs_count;
+	char * vars[MSH_MEMO_INPUTS];
+	int vars_count;
+};
+
+//a result in the store, when evicting
+struct memo_entry {
+	char name[17];
+	off_t size;
+	struct timespec used;
+};
+
+static unsigned long hits, misses, evictions;
+
+//Helper functions:
+
+
+static int
+key_add(struct memo_key *k, const void *data, size_t len)
+{
+	if(k->len + len > k->cap)
+	{
+		size_t cap = k->cap * 2 > k->len + len ? k->cap * 2 : k->len + len + 256;
+		char * grown = realloc(k->buf, cap);
+
+		if(grown == NULL) return -1;
+		k->buf = grown;
+		k->cap = cap;
+	}
+	memcpy(k->buf + k->len, data, len);
+	k->len += len;
+
+	return 0;
+}
+
+//a string with its NUL, so that "ab" "c" and "a" "bc" differ
+static int
+key_str(struct memo_key *k, const char *str)
+{
+	return key_add(k, str, strlen(str) + 1);
+}
+
+//an input file: its path, then its size and the hash of its contents
+static int
+key_file(struct memo_key *k, const char *path)
+{
+	char buf[64 * 1024];
+	uint64_t contents[2] = { 0, MSH_HASH_INIT };
+	ssize_t n;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	if(key_str(k, path) == -1) return -1;
+	if(fd == -1) return key_str(k, "\001missing");
+	while((n = read(fd, buf, sizeof(buf))) > 0)
+	{
+		contents[0] += n;
+		contents[1] = msh_hash(contents[1], buf, n);
+	}
+	close(fd);
+
+	return key_add(k, contents, sizeof(contents));
+}
+
+//what the result depends on, kept with it, and its hash, naming it
+static int
+memo_key(struct msh_pipeline *p, struct memo_deps *deps, struct memo_key *key)
+{
+	char cwd[PATH_MAX];
+	int ret;
+
+	*key = (struct memo_key) { 0 };
+	ret = key_str(key, getcwd(cwd, sizeof(cwd)) != NULL ? cwd : "");
+	for(int i = 0; ret == 0 && i < MSH_MAXCMNDS && p->pipeline_commands[i] != NULL; i++)
+	{
+		struct msh_command * c = p->pipeline_commands[i];
+
+		for(int k = 0; ret == 0 && c->comm_env != NULL && c->comm_env[k] != NULL; k++) ret = key_str(key, c->comm_env[k]);
+		if(ret == 0) ret = key_str(key, "\002");
+		for(int k = 0; ret == 0 && c->comm_arguments[k] != NULL; k++) ret = key_str(key, c->comm_arguments[k]);
+		if(ret == 0) ret = key_str(key, "\003");
+	}
+	for(int i = 0; ret == 0 && i < deps->vars_count; i++)
+	{
+		const char * value = msh_var_get(deps->vars[i]);
+
+		ret = key_str(key, deps->vars[i]);
+		if(ret == 0) ret = key_str(key, value != NULL ? value : "\001unset");
+	}
+	for(int i = 0; ret == 0 && i < deps->inputs_count; i++) ret = key_file(key, deps->inputs[i]);
+	if(ret == -1)
+	{
+		free(key->buf);
+		return -1;
+	}
+	key->hash = msh_hash(msh_hash(MSH_HASH_INIT, MSH_MEMO_MAGIC, sizeof(MSH_MEMO_MAGIC)), key->buf, key->len);
+
+	return 0;
+}
+
+//the store's directory, created if it doesn't exist
+static int
+memo_dir(char *dir, size_t size)
+{
+	const char * base;
+
+	if((base = msh_var_get("MSH_MEMO_DIR")) != NULL) snprintf(dir, size, "%s", base);
+	else if((base = msh_var_get("XDG_CACHE_HOME")) != NULL) snprintf(dir, size, "%s/msh/memo", base);
+	else if((base = msh_var_get("HOME")) != NULL) snprintf(dir, size, "%s/.cache/msh/memo", base);
+	else
+	{
+		errno = ENOENT;
+		return -1;
+	}
+
+	for(char * s = dir + 1; ; s++)
+	{
+		char c = *s;
+
+		if(c != '/' && c != '\0') continue;
+		*s = '\0';
+		if(mkdir(dir, 0700) == -1 && errno != EEXIST) return -1;
+		*s = c;
+		if(c == '\0') break;
+	}
+	return 0;
+}
+
+static long
+memo_max(void)
+{
+	const char * max = msh_var_get("MSH_MEMO_MAX");
+
+	return max != NULL ? atol(max) : MSH_MEMO_MAX_DEFAULT;
+}
+
+
+//take the first n words out of the pipeline's first command, 0 if none is left
+static int
+words_strip(struct msh_pipeline *p, int n)
+{
+	struct msh_command * c = p->pipeline_commands[0];
+	int i;
+
+	for(i = 0; i < n; i++) free(c->comm_arguments[i]);
+	for(i = 0; c->comm_arguments[i + n] != NULL; i++) c->comm_arguments[i] = c->comm_arguments[i + n];
+	for(int k = i; k < i + n; k++) c->comm_arguments[k] = NULL;
+	c->comm_args_count -= n;
+
+	free(c->command);
+	c->command = c->comm_arguments[0] != NULL ? strdup(c->comm_arguments[0]) : NULL;
+
+	return c->command != NULL;
+}
+
+//the -i and -e options after memo, returns how many words they are (memo included), -1 if they are wrong
+static int
+deps_parse(char **args, struct memo_deps *deps)
+{
+	int i = 1;
+
+	*deps = (struct memo_deps) { 0 };
+	for(; args[i] != NULL && args[i][0] == '-'; i += 2)
+	{
+		if(strcmp(args[i], "--") == 0) return i + 1;
+		if(args[i + 1] == NULL) return -1;
+		if(strcmp(args[i], "-i") == 0 && deps->inputs_count < MSH_MEMO_INPUTS) deps->inputs[deps->inputs_count++] = args[i + 1];
+		else if(strcmp(args[i], "-e") == 0 && deps->vars_count < MSH_MEMO_INPUTS) deps->vars[deps->vars_count++] = args[i + 1];
+		else return -1;
+	}
+	return i;
+}
+
+//replay the result of the key to out and err, returns its status, or -1 if there is none
+static int
+memo_replay(const char *path, struct memo_key *k, int out, int err)
+{
+	struct memo_header h;
+	struct stat st;
+	char * buf;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	if(fd == -1) return -1;
+	if(fstat(fd, &st) == -1 || pread(fd, &h, sizeof(h), 0) != sizeof(h) || memcmp(h.magic, MSH_MEMO_MAGIC, sizeof(h.magic)) != 0 ||
+	   h.key_len != k->len || sizeof(h) + h.key_len + h.out_len + h.err_len != (uint64_t)st.st_size)
+	{
+		close(fd);
+		return -1;
+	}
+	buf = malloc(h.key_len + h.out_len + h.err_len + 1);
+	if(buf == NULL || pread(fd, buf, h.key_len + h.out_len + h.err_len, sizeof(h)) != (ssize_t)(h.key_len + h.out_len + h.err_len) ||
+	   memcmp(buf, k->buf, k->len) != 0)
+	{
+		free(buf);
+		close(fd);
+		return -1;
+	}
+
+	fflush(stdout);
+	msh_write_all(out, buf + h.key_len, h.out_len);
+	msh_write_all(err, buf + h.key_len + h.out_len, h.err_len);
+
+	//recently used: evicted last
+	futimens(fd, NULL);
+	free(buf);
+	close(fd);
+
+	return h.status;
+}
+
+//called by the event loop when the pipeline wrote output, and once it is done to drain the rest
+static void
+tee_ready(int fd, uint32_t events, void *data)
+{
+	struct memo_tee * t = data;
+	char chunk[64 * 1024];
+	ssize_t n;
+
+	(void)events;
+	while((n = read(fd, chunk, sizeof(chunk))) > 0)
+	{
+		msh_write_all(t->to, chunk, n);
+		if(t->max == (size_t)-1) continue;
+		if(t->len + n > t->max)
+		{
+			t->max = (size_t)-1;
+			continue;
+		}
+		if(t->len + n > t->cap)
+		{
+			size_t cap = t->cap * 2 > t->len + n ? t->cap * 2 : t->len + n;
+			char * grown = realloc(t->buf, cap);
+
+			if(grown == NULL)
+			{
+				t->max = (size_t)-1;
+				continue;
+			}
+			t->buf = grown;
+			t->cap = cap;
+		}
+		memcpy(t->buf + t->len, chunk, n);
+		t->len += n;
+	}
+	if(n == 0) t->eof = 1;
+
+	//the last process holding the pipe of a detached tee is gone
+	if(t->eof && t->detached)
+	{
+		msh_event_del(t->from);
+		close(t->from);
+		close(t->to);
+		free(t);
+	}
+}
+
+//a pipe copied by the event loop to fd, whose write end is set in pipe_out for the pipeline
+//to write to instead of fd. Returns NULL if it can't.
+static struct memo_tee *
+tee_start(int fd, size_t max, int *pipe_out)
+{
+	struct memo_tee * t = calloc(1, sizeof(struct memo_tee));
+	int pipefd[2];
+
+	if(t == NULL) return NULL;
+	*t = (struct memo_tee) { .from = -1, .to = -1, .max = max };
+	if(pipe2(pipefd, O_CLOEXEC) == -1)
+	{
+		free(t);
+		return NULL;
+	}
+	fcntl(pipefd[1], F_SETPIPE_SZ, MSH_MEMO_PIPE_SIZE);
+	fcntl(pipefd[0], F_SETFL, O_NONBLOCK);
+
+	t->from = pipefd[0];
+	t->to = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if(t->to == -1 || msh_event_add(t->from, EPOLLIN, tee_ready, t) == -1)
+	{
+		if(t->to != -1) close(t->to);
+		close(pipefd[0]);
+		close(pipefd[1]);
+		free(t);
+		return NULL;
+	}
+	*pipe_out = pipefd[1];
+
+	return t;
+}
+
+//copy what's left in the pipe, returns 1 if that is all the output: a process
+//can still have the pipe, e.g. one of a stopped job
+static int
+tee_drain(struct memo_tee *t)
+{
+	tee_ready(t->from, 0, t);
+	return t->eof;
+}
+
+//free the tee, or let it copy what is still to come and free itself then (nothing more is kept)
+static void
+tee_stop(struct memo_tee *t)
+{
+	free(t->buf);
+	t->buf = NULL;
+	if(!t->eof)
+	{
+		t->max = (size_t)-1;
+		t->detached = 1;
+		return;
+	}
+	msh_event_del(t->from);
+	close(t->from);
+	close(t->to);
+	free(t);
+}
+
+//keep a result, written to a temporary file first so that a result is never seen half written
+static void
+memo_store(const char *dir, const char *path, struct memo_key *k, int status, struct memo_tee *out, struct memo_tee *err)
+{
+	struct memo_header h = { .status = status, .key_len = k->len, .out_len = out->len, .err_len = err->len };
+	char tmp[PATH_MAX];
+	int fd;
+
+	memcpy(h.magic, MSH_MEMO_MAGIC, sizeof(h.magic));
+	snprintf(tmp, sizeof(tmp), "%s/.tmp.%d", dir, getpid());
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if(fd == -1) return;
+	if(msh_write_all(fd, &h, sizeof(h)) == -1 || msh_write_all(fd, k->buf, k->len) == -1 || msh_write_all(fd, out->buf, out->len) == -1 ||
+	   msh_write_all(fd, err->buf, err->len) == -1 ||
+	   close(fd) == -1 || rename(tmp, path) == -1)
+	{
+		perror("msh: memo");
+		unlink(tmp);
+	}
+}
+
+static int
+entry_cmp(const void *a, const void *b)
+{
+	const struct memo_entry * x = a, * y = b;
+
+	if(x->used.tv_sec != y->used.tv_sec) return x->used.tv_sec < y->used.tv_sec ? -1 : 1;
+	if(x->used.tv_nsec != y->used.tv_nsec) return x->used.tv_nsec < y->used.tv_nsec ? -1 : 1;
+	return 0;
+}
+
+//the results in the store, returns how many there are, -1 on failure
+static long
+entries_list(const char *dir, struct memo_entry **entries, off_t *total)
+{
+	DIR * d = opendir(dir);
+	struct dirent * de;
+	long count = 0, cap = 0;
+
+	*entries = NULL;
+	*total = 0;
+	if(d == NULL) return -1;
+	while((de = readdir(d)) != NULL)
+	{
+		struct stat st;
+
+		if(strlen(de->d_name) != 16 || strspn(de->d_name, "0123456789abcdef") != 16) continue;
+		if(fstatat(dirfd(d), de->d_name, &st, 0) == -1) continue;
+		if(count == cap)
+		{
+			struct memo_entry * grown = realloc(*entries, (cap = cap == 0 ? 64 : cap * 2) * sizeof(struct memo_entry));
+
+			if(grown == NULL) break;
+			*entries = grown;
+		}
+		strcpy((*entries)[count].name, de->d_name);
+		(*entries)[count].size = st.st_size;
+		(*entries)[count].used = st.st_mtim;
+		*total += st.st_size;
+		count++;
+	}
+	closedir(d);
+
+	return count;
+}
+
+//remove the least recently used results until the store fits in max bytes
+static void
+memo_evict(const char *dir, long max)
+{
+	struct memo_entry * entries;
+	off_t total;
+	long count = entries_list(dir, &entries, &total);
+	char path[PATH_MAX];
+
+	if(count > 0 && total > max)
+	{
+		qsort(entries, count, sizeof(struct memo_entry), entry_cmp);
+		for(long i = 0; i < count && total > max; i++)
+		{
+			snprintf(path, sizeof(path), "%s/%s", dir, entries[i].name);
+			if(unlink(path) == -1) continue;
+			total -= entries[i].size;
+			evictions++;
+		}
+	}
+	free(entries);
+}
+
+static void
+memo_stats(const char *dir, int out)
+{
+	struct memo_entry * entries;
+	off_t total;
+	long count = entries_list(dir, &entries, &total);
+
+	free(entries);
+	dprintf(out, "%s: %ld results, %lld bytes of %ld\n", dir, count < 0 ? 0 : count, (long long)total, memo_max());
+	dprintf(out, "%lu hits, %lu misses, %lu evicted\n", hits, misses, evictions);
+}
+//end of helper functions
+
+int
+msh_memo_execute(struct msh_pipeline *p, int out, int err)
+{
+	struct memo_deps deps;
+	struct memo_tee * tout, * terr;
+	char ** args = p->pipeline_commands[0]->comm_arguments;
+	char dir[PATH_MAX - 32], path[PATH_MAX];
+	struct memo_key key;
+	int words, status, complete, pout, perr;
+	long max = memo_max();
+
+	if(args[1] != NULL && strcmp(args[1], "stats") == 0 && args[2] == NULL && p->pipeline_commands[1] == NULL)
+	{
+		fflush(stdout);
+		if(memo_dir(dir, sizeof(dir)) == -1) perror("msh: memo");
+		else memo_stats(dir, out);
+		msh_pipeline_free(p);
+		return 0;
+	}
+	words = deps_parse(args, &deps);
+	if(words == -1 || args[words] == NULL)
+	{
+		fflush(stdout);
+		dprintf(out, "msh: memo: usage: memo [-i FILE]... [-e NAME]... pipeline\n");
+		msh_pipeline_free(p);
+		return 1;
+	}
+
+	//the options are hashed with the pipeline, while deps still points into the arguments
+	if(memo_key(p, &deps, &key) == -1)
+	{
+		perror("msh: memo");
+		msh_pipeline_free(p);
+		return 1;
+	}
+	if(!words_strip(p, words))
+	{
+		free(key.buf);
+		msh_pipeline_free(p);
+		return 1;
+	}
+
+	//a background pipeline isn't waited for, its result is never complete
+	if(msh_pipeline_background(p) || memo_dir(dir, sizeof(dir)) == -1)
+	{
+		free(key.buf);
+		msh_execute_fds(p, out, err);
+		return msh_execute_status();
+	}
+	snprintf(path, sizeof(path), "%s/%016llx", dir, (unsigned long long)key.hash);
+
+	status = memo_replay(path, &key, out, err);
+	if(status != -1)
+	{
+		hits++;
+		free(key.buf);
+		msh_pipeline_free(p);
+		return status;
+	}
+	misses++;
+
+	//only this pipeline writes to the pipes: what the shell or other jobs print isn't in the result
+	tout = tee_start(out, max, &pout);
+	terr = tout == NULL ? NULL : tee_start(err, max, &perr);
+	if(terr == NULL)
+	{
+		if(tout != NULL)
+		{
+			close(pout);
+			tee_drain(tout);
+			tee_stop(tout);
+		}
+		free(key.buf);
+		msh_execute_fds(p, out, err);
+		return msh_execute_status();
+	}
+	msh_execute_fds(p, pout, perr);
+	status = msh_execute_status();
+	close(pout);
+	close(perr);
+
+	//a process still has a pipe if the pipeline was stopped: what it writes once resumed isn't kept
+	complete = tee_drain(tout) & tee_drain(terr);
+
+	//killed or stopped by a signal, or too large to keep
+	if(complete && status < 128 && tout->max != (size_t)-1 && terr->max != (size_t)-1 && tout->len + terr->len <= (size_t)max)
+	{
+		memo_store(dir, path, &key, status, tout, terr);
+		memo_evict(dir, max);
+	}
+	tee_stop(tout);
+	tee_stop(terr);
+	free(key.buf);
+
+	return status;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+/***
+ * A cache of the results of deterministic commands: `memo pipeline`
+ * runs the pipeline once, and then replays its output and exit
+ * status, as long as what it depends on is unchanged. It's meant for
+ * the expensive commands scripts re-run over the same inputs (code
+ * generators, checksums, `find` listings).
+ *
+ *     memo [-i FILE]... [-e NAME]... pipeline
+ *     memo stats
+ *
+ * A result is found by its key: the pipeline's words (after
+ * expansion), the current directory, the values of the variables
+ * named with `-e`, and the size and hash of the contents of the input
+ * files named with `-i`. Results are files named by the FNV-1a hash
+ * of their key, which they keep: it is compared before a result is
+ * replayed, so that a collision is a miss. They are in `$MSH_MEMO_DIR`
+ * (`$XDG_CACHE_HOME/msh/memo` or `~/.cache/msh/memo` by default).
+ * When the store grows over `$MSH_MEMO_MAX` bytes (64MB by default),
+ * the least recently used results are removed.
+ *
+ * On a miss, the pipeline is run by `msh_execute_fds` with its
+ * standard output and error going to pipes, which the event loop
+ * copies to where they went and into the result while the pipeline
+ * runs. Results of pipelines killed or stopped by a signal aren't
+ * kept: a stopped pipeline keeps its pipes, copied until it is done.
+ */
+
+struct msh_pipeline;
+
+/**
+ * `msh_memo_execute` runs a pipeline starting with `memo`, from the
+ * cache if it can.
+ *
+ * - `@p` - the pipeline, freed like by `msh_execute`.
+ * - `@out` - where its standard output goes.
+ * - `@err` - where its standard error goes.
+ * - `@return` - the exit status of the pipeline, replayed or not.
+ */
+int msh_memo_execute(struct msh_pipeline *p, int out, int err);
@@ -0,0 +1,283 @@
+#include <msh.h>
+#include <msh_parse.h>
+#include <msh_parse_internal.h>
+#include <msh_optimize.h>
+#include <msh_coproc.h>
+#include <msh_util.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+//Helper functions:
+
+static int
+args_count(struct msh_command *c)
+{
+	int n = 0;
+
+	while(c->comm_arguments[n] != NULL) n++;
+	return n;
+}
+
+static int
+is_redirect(char *arg)
+{
+	return strcmp(arg, "<") == 0 || strcmp(arg, "<<") == 0 || strcmp(arg, "<<<") == 0 ||
+	       strcmp(arg, "1>") == 0 || strcmp(arg, "1>>") == 0 ||
+	       strcmp(arg, "2>") == 0 || strcmp(arg, "2>>") == 0;
+}
+
+static int
+has_input_redirect(struct msh_command *c)
+{
+	for(int i = 1; c->comm_arguments[i] != NULL; i++)
+	{
+		if(c->comm_arguments[i][0] == '<') return 1;
+	}
+	return 0;
+}
+
+//is the command exactly the words in args?
+static int
+args_are(struct msh_command *c, int n, char **args)
+{
+	if(args_count(c) != n) return 0;
+	for(int i = 0; i < n; i++)
+	{
+		if(args[i] != NULL && strcmp(c->comm_arguments[i], args[i]) != 0) return 0;
+	}
+	return 1;
+}
+
+//cat with a single file argument, which can be read: cat reports the other files
+//itself, and then its output is still piped to the next command
+static int
+is_cat_file(struct msh_command *c)
+{
+	struct stat st;
+	char *file;
+
+	if(!args_are(c, 2, (char *[]){"cat", NULL})) return 0;
+	file = c->comm_arguments[1];
+	if(file[0] == '-' || is_redirect(file)) return 0;
+	return stat(file, &st) == 0 && !S_ISDIR(st.st_mode) && access(file, R_OK) == 0;
+}
+
+//echo without options nor redirections
+static int
+is_echo_literal(struct msh_command *c)
+{
+	if(strcmp(c->comm_arguments[0], "echo") != 0) return 0;
+	if(c->comm_arguments[1] != NULL && c->comm_arguments[1][0] == '-') return 0;
+	for(int i = 1; c->comm_arguments[i] != NULL; i++)
+	{
+		if(is_redirect(c->comm_arguments[i])) return 0;
+	}
+	return 1;
+}
+
+//add a redirection to the end of a command, taking ownership of file
+static int
+redirect_append(struct msh_command *c, char *op, char *file)
+{
+	int n = args_count(c);
+
+	if(msh_command_args_reserve(c, n + 3) == -1) return -1;
+	c->comm_arguments[n] = strdup(op);
+	c->comm_arguments[n + 1] = file;
+	c->comm_arguments[n + 2] = NULL;
+	c->comm_args_count += 2;
+
+	return 0;
+}
+
+//take the nth command out of the pipeline
+static void
+stage_remove(struct msh_pipeline *p, int nth)
+{
+	int i;
+
+	msh_command_free(p->pipeline_commands[nth]);
+	for(i = nth; i < MSH_MAXCMNDS - 1; i++) p->pipeline_commands[i] = p->pipeline_commands[i + 1];
+	p->pipeline_commands[MSH_MAXCMNDS - 1] = NULL;
+	p->pipeline_comm_count--;
+
+	for(i = 0; p->pipeline_commands[i + 1] != NULL; i++);
+	p->pipeline_commands[i]->command_last = true;
+}
+
+static int
+stages_count(struct msh_pipeline *p)
+{
+	int n = 0;
+
+	while(n < MSH_MAXCMNDS && p->pipeline_commands[n] != NULL) n++;
+	return n;
+}
+
+//a single rewrite of the pipeline, returns 1 if a stage was eliminated
+static int
+optimize_once(struct msh_pipeline *p, int out)
+{
+	int n = stages_count(p);
+	struct msh_command * first, * next, * last;
+
+	if(n < 2) return 0;
+	first = p->pipeline_commands[0];
+	next = p->pipeline_commands[1];
+	last = p->pipeline_commands[n - 1];
+
+	//cat file | cmd => cmd < file
+	if(is_cat_file(first) && !has_input_redirect(next) && msh_command_args_reserve(next, args_count(next) + 3) == 0)
+	{
+		char * file = first->comm_arguments[1];
+
+		first->comm_arguments[1] = NULL;
+		redirect_append(next, "<", file);
+		stage_remove(p, 0);
+		return 1;
+	}
+
+	//echo words | cmd => cmd <<< words
+	if(is_echo_literal(first) && !has_input_redirect(next) && msh_command_args_reserve(next, args_count(next) + 3) == 0)
+	{
+		size_t len = 1;
+		char * words;
+
+		for(int i = 1; first->comm_arguments[i] != NULL; i++) len += strlen(first->comm_arguments[i]) + 1;
+		words = calloc(1, len);
+		if(words == NULL) return 0;
+		for(int i = 1; first->comm_arguments[i] != NULL; i++)
+		{
+			if(i > 1) strcat(words, " ");
+			strcat(words, first->comm_arguments[i]);
+		}
+		redirect_append(next, "<<<", words);
+		stage_remove(p, 0);
+		return 1;
+	}
+
+	//cat in the middle of a pipeline (or first, reading the shell's input) is a no-op
+	for(int i = 0; i < n - 1; i++)
+	{
+		if(args_are(p->pipeline_commands[i], 1, (char *[]){"cat"}))
+		{
+			stage_remove(p, i);
+			return 1;
+		}
+	}
+
+	//cmd | cat 1> file => cmd 1> file
+	if(args_are(last, 3, (char *[]){"cat", NULL, NULL}) &&
+	   (strcmp(last->comm_arguments[1], "1>") == 0 || strcmp(last->comm_arguments[1], "1>>") == 0) &&
+	   msh_command_args_reserve(p->pipeline_commands[n - 2], args_count(p->pipeline_commands[n - 2]) + 3) == 0)
+	{
+		char * file = last->comm_arguments[2];
+
+		last->comm_arguments[2] = NULL;
+		redirect_append(p->pipeline_commands[n - 2], last->comm_arguments[1], file);
+		stage_remove(p, n - 1);
+		return 1;
+	}
+
+	//cmd | cat => cmd, unless cat hides the terminal from cmd
+	if(args_are(last, 1, (char *[]){"cat"}) && !isatty(out))
+	{
+		stage_remove(p, n - 1);
+		return 1;
+	}
+
+	return 0;
+}
+
+//end of helper functions
+
+int
+msh_optimize(struct msh_pipeline *p, int out)
+{
+	int eliminated = 0;
+
+	if(getenv("MSH_NOOPT") != NULL) return 0;
+
+	while(optimize_once(p, out)) eliminated++;
+
+	return eliminated;
+}
+
+int
+msh_optimize_inline(struct msh_pipeline *p, int out, int *status)
+{
+	struct msh_command * c = p->pipeline_commands[0];
+	char ** args = c->comm_arguments;
+	char * file = NULL;
+	int append = 0;
+	int n;
+
+	//a background pipeline is a job, which $!, jobs and wait must see
+	if(getenv("MSH_NOOPT") != NULL || stages_count(p) != 1 || p->background_pipe) return 0;
+
+	//only standard output redirections, as the last arguments
+	n = args_count(c);
+	if(n >= 3 && (strcmp(args[n - 2], "1>") == 0 || strcmp(args[n - 2], "1>>") == 0))
+	{
+		file = args[n - 1];
+		append = strcmp(args[n - 2], "1>>") == 0;
+		n -= 2;
+	}
+	for(int i = 1; i < n; i++)
+	{
+		if(is_redirect(args[i])) return 0;
+	}
+
+	if(strcmp(args[0], "true") == 0 || strcmp(args[0], ":") == 0 || strcmp(args[0], "false") == 0)
+	{
+		*status = strcmp(args[0], "false") == 0;
+		if(file == NULL) return 1;
+		n = 1; //creating/truncating the file is the only effect
+	}
+	else if(!is_echo_literal(c)) return 0;
+	else *status = 0;
+
+	fflush(stdout);
+	int fd = out;
+	if(file != NULL)
+	{
+		fd = msh_coproc_open(file, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC));
+		if(fd == -1)
+		{
+			fprintf(stderr, "msh: %s: %s\n", file, strerror(errno));
+			*status = 1;
+			return 1;
+		}
+	}
+
+	//echo: the arguments separated by spaces, and a newline
+	for(int i = 1; i < n && strcmp(args[0], "echo") == 0; i++)
+	{
+		if(msh_write_all(fd, args[i], strlen(args[i])) == -1) break;
+		if(i < n - 1 && msh_write_all(fd, " ", 1) == -1) break;
+	}
+	if(strcmp(args[0], "echo") == 0) msh_write_all(fd, "\n", 1);
+
+	if(fd != out) close(fd);
+
+	return 1;
+}
+
+void
+msh_optimize_explain(struct msh_pipeline *p, FILE *out)
+{
+	for(int i = 0; i < MSH_MAXCMNDS && p->pipeline_commands[i] != NULL; i++)
+	{
+		char ** args = p->pipeline_commands[i]->comm_arguments;
+
+		if(i > 0) fprintf(out, " | ");
+		for(int j = 0; args[j] != NULL; j++) fprintf(out, j == 0 ? "%s" : " %s", args[j]);
+	}
+	if(p->background_pipe) fprintf(out, " &");
+	fprintf(out, "\n");
+}
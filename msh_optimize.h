@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdio.h>
+
+/***
+ * A pass over parsed pipelines, run before they are launched, that
+ * rewrites stages which only cost a fork, an exec and a pipe copy:
+ *
+ * - `cat file | cmd` becomes `cmd < file`, if file can be read,
+ * - `echo words | cmd` becomes `cmd <<< words`,
+ * - a `cat` without arguments in the middle of a pipeline is
+ *   dropped, as is a trailing one when the output isn't a terminal,
+ * - foreground pipelines that are a single `echo`, `true`, `false` or
+ *   `:` run in the shell without forking.
+ *
+ * Setting the `MSH_NOOPT` environment variable disables the pass.
+ */
+
+struct msh_pipeline;
+
+/**
+ * `msh_optimize` rewrites the redundant stages out of a pipeline.
+ * It must be called before the redirections are taken out of the
+ * commands' arguments, as it moves them around.
+ *
+ * - `@p` - the pipeline to rewrite.
+ * - `@out` - the descriptor the pipeline writes its output to.
+ * - `@return` - the number of stages that were eliminated.
+ */
+int msh_optimize(struct msh_pipeline *p, int out);
+
+/**
+ * `msh_optimize_inline` runs a pipeline in the shell, if it is a
+ * single command simple enough to not need a process.
+ *
+ * - `@p` - the (optimized) pipeline.
+ * - `@out` - the descriptor the pipeline writes its output to.
+ * - `@status` - set to the exit status of the pipeline, if it was
+ *     run.
+ * - `@return` - `1` if the pipeline was run, `0` if it must be
+ *     launched as usual.
+ */
+int msh_optimize_inline(struct msh_pipeline *p, int out, int *status);
+
+/**
+ * `msh_optimize_explain` prints a pipeline the way it will be run,
+ * e.g. after `msh_optimize`, for the `explain` builtin.
+ *
+ * - `@p` - the pipeline to print.
+ * - `@out` - where to print it.
+ */
+void msh_optimize_explain(struct msh_pipeline *p, FILE *out);
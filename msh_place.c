@@ -0,0 +1,144 @@
+#define _GNU_SOURCE
+#include <msh_place.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+//from linux/ioprio.h, which isn't exported by every libc
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+
+//Helper functions:
+
+//a list of CPUs like 0-3,6
+static int
+cpus_parse(const char *list, cpu_set_t *cpus)
+{
+	char * end;
+
+	CPU_ZERO(cpus);
+	while(*list != '\0')
+	{
+		long first = strtol(list, &end, 10), last = first;
+
+		if(end == list || first < 0) return -1;
+		if(*end == '-')
+		{
+			list = end + 1;
+			last = strtol(list, &end, 10);
+			if(end == list || last < first) return -1;
+		}
+		if(last >= CPU_SETSIZE) return -1;
+		for(long cpu = first; cpu <= last; cpu++) CPU_SET(cpu, cpus);
+
+		if(*end == ',') end++;
+		else if(*end != '\0') return -1;
+		list = end;
+	}
+	return CPU_COUNT(cpus) > 0 ? 0 : -1;
+}
+
+//an I/O priority like be:4
+static int
+ioprio_parse(const char *prio)
+{
+	const char * classes[] = { "rt", "be", "idle" };
+	size_t len = strcspn(prio, ":");
+	int level = 4;
+
+	if(prio[len] == ':')
+	{
+		char * end;
+
+		level = strtol(prio + len + 1, &end, 10);
+		if(*end != '\0' || level < 0 || level > 7) return -1;
+	}
+	for(int class = 0; class < 3; class++)
+	{
+		if(strlen(classes[class]) == len && strncmp(prio, classes[class], len) == 0) return ((class + 1) << IOPRIO_CLASS_SHIFT) | level;
+	}
+	return -1;
+}
+
+//the nth CPU of a set, wrapping around
+static int
+cpus_nth(cpu_set_t *cpus, int nth)
+{
+	int count = CPU_COUNT(cpus);
+
+	nth %= count;
+	for(int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		if(CPU_ISSET(cpu, cpus) && nth-- == 0) return cpu;
+	}
+	return -1;
+}
+//end of helper functions
+
+int
+msh_place_parse(char **args, struct msh_place *place)
+{
+	int i = 1;
+
+	*place = (struct msh_place) { .set = 1, .policy = -1, .ioprio = -1 };
+	for(; args[i] != NULL && args[i][0] == '-'; i++)
+	{
+		char * opt = args[i], * value = args[i + 1];
+
+		if(strcmp(opt, "--") == 0) return i + 1;
+		if(strcmp(opt, "-a") == 0)
+		{
+			place->spread = 1;
+			continue;
+		}
+		if(value == NULL) break;
+		i++;
+
+		if(strcmp(opt, "-c") == 0 && cpus_parse(value, &place->cpus) == 0) place->has_cpus = 1;
+		else if(strcmp(opt, "-n") == 0)
+		{
+			place->nice = atoi(value);
+			place->has_nice = 1;
+		}
+		else if(strcmp(opt, "-s") == 0 && strcmp(value, "batch") == 0) place->policy = SCHED_BATCH;
+		else if(strcmp(opt, "-s") == 0 && strcmp(value, "idle") == 0) place->policy = SCHED_IDLE;
+		else if(strcmp(opt, "-i") == 0 && (place->ioprio = ioprio_parse(value)) != -1) continue;
+		else
+		{
+			printf("msh: place: %s %s: invalid option\n", opt, value);
+			return -1;
+		}
+	}
+	if(args[i] == NULL || args[i][0] == '-')
+	{
+		printf("msh: place: usage: place [-c CPUS] [-a] [-n NICE] [-s batch|idle] [-i CLASS[:LEVEL]] pipeline\n");
+		return -1;
+	}
+
+	return i;
+}
+
+void
+msh_place_child(struct msh_place *place, int stage)
+{
+	cpu_set_t cpus = place->cpus;
+	struct sched_param param = { .sched_priority = 0 };
+
+	if(!place->has_cpus && place->spread) sched_getaffinity(0, sizeof(cpus), &cpus);
+	if(place->spread)
+	{
+		int cpu = cpus_nth(&cpus, stage);
+
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+	}
+	if((place->has_cpus || place->spread) && sched_setaffinity(0, sizeof(cpus), &cpus) == -1) perror("msh: place: sched_setaffinity");
+
+	if(place->has_nice && setpriority(PRIO_PROCESS, 0, place->nice) == -1) perror("msh: place: setpriority");
+	if(place->policy != -1 && sched_setscheduler(0, place->policy, &param) == -1) perror("msh: place: sched_setscheduler");
+	if(place->ioprio != -1 && syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, place->ioprio) == -1) perror("msh: place: ioprio_set");
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <sched.h> //cpu_set_t, with _GNU_SOURCE
+
+/***
+ * Where and how a pipeline's processes run:
+ *
+ *     place [-c CPUS] [-a] [-n NICE] [-s batch|idle] [-i CLASS[:LEVEL]] pipeline
+ *
+ * - `-c 0-3,6` pins the processes to these CPUs (`sched_setaffinity`),
+ * - `-a` spreads the stages over distinct CPUs (of `-c`, or of the
+ *   ones the shell may use), the first stage on the first CPU, so a
+ *   producer and its consumer don't share a core's caches,
+ * - `-n` is the `nice` value,
+ * - `-s` is the scheduling policy: `batch` for CPU-bound work,
+ *   `idle` for work that only runs when nothing else does,
+ * - `-i` is the I/O priority (`ioprio_set`): the class `rt`, `be` or
+ *   `idle`, and a level from `0` (the highest) to `7`.
+ *
+ * E.g. `place -s idle -n 19 -i idle make -j8 &` builds in the
+ * background without slowing down the interactive jobs. The settings
+ * are applied in each process of the pipeline between `fork` and
+ * `exec`.
+ */
+
+struct msh_place {
+	int set; //0 if the pipeline has no placement
+	cpu_set_t cpus;
+	int has_cpus;
+	int spread;
+	int nice;
+	int has_nice;
+	int policy; //SCHED_BATCH or SCHED_IDLE, -1 to keep the shell's
+	int ioprio; //as given to ioprio_set, -1 to keep the shell's
+};
+
+/**
+ * `msh_place_parse` reads the options of a `place` prefix.
+ *
+ * - `@args` - the borrowed words of the command, starting with
+ *     `place`.
+ * - `@place` - set to the placement.
+ * - `@return` - the number of words of the prefix (`place` and its
+ *     options), or `-1` if they are wrong (an error is printed).
+ */
+int msh_place_parse(char **args, struct msh_place *place);
+
+/**
+ * `msh_place_child` applies a placement to the process of a stage,
+ * in the child before it is executed. Settings that can't be applied
+ * (e.g. a CPU that doesn't exist) are reported, and the stage runs
+ * without them.
+ *
+ * - `@place` - the placement.
+ * - `@stage` - the index of the stage in the pipeline.
+ */
+void msh_place_child(struct msh_place *place, int stage);
@@ -0,0 +1,162 @@
+#include <msh.h>
+#include <msh_parse.h>
+#include <msh_parse_internal.h>
+#include <msh_sched.h>
+#include <msh_job.h>
+#include <msh_var.h>
+#include <msh_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+
+//a pipeline waiting to start
+struct queued {
+	struct msh_pipeline * p;
+	long prio;
+	unsigned long seq; //arrival order, among equal priorities
+};
+
+//sorted by the order they start in
+static struct queued * queue;
+static size_t queue_count, queue_cap;
+static unsigned long arrivals;
+
+static int starting; //the pipelines started from the queue are run, not queued again
+
+//Helper functions:
+
+//how many background jobs can run at once
+static long
+jobs_limit(void)
+{
+	const char * limit = msh_var_get("MSH_JOBS");
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	double load;
+
+	if(cpus < 1) cpus = 1;
+	if(limit == NULL || strcmp(limit, "cpus") == 0) return cpus;
+	if(strcmp(limit, "load") == 0)
+	{
+		if(getloadavg(&load, 1) != 1) return cpus;
+		return cpus - (long)load > 1 ? cpus - (long)load : 1;
+	}
+	return atol(limit) > 0 ? atol(limit) : 1;
+}
+
+static int
+admit(void)
+{
+	int running = msh_job_count(MSH_JOB_RUNNING);
+
+	return running < jobs_limit() && running + msh_job_count(MSH_JOB_STOPPED) < MSH_MAXBACKGROUND;
+}
+
+//$MSH_PRIO, or the MSH_PRIO=N assignment before the pipeline
+static long
+pipeline_prio(struct msh_pipeline *p)
+{
+	char ** args = p->pipeline_commands[0]->comm_arguments;
+	const char * prio = msh_var_get("MSH_PRIO");
+
+	for(int i = 0; args[i] != NULL && msh_var_assignment(args[i]) > 0; i++)
+	{
+		if(strncmp(args[i], "MSH_PRIO=", 9) == 0) prio = args[i] + 9;
+	}
+	return prio != NULL ? atol(prio) : 0;
+}
+
+static int
+queue_insert(struct msh_pipeline *p)
+{
+	struct queued q = { .p = p, .prio = pipeline_prio(p), .seq = arrivals++ };
+	size_t i = queue_count;
+
+	if(queue_count == queue_cap)
+	{
+		size_t cap = queue_cap == 0 ? 16 : queue_cap * 2;
+		struct queued * grown = realloc(queue, cap * sizeof(struct queued));
+
+		if(grown == NULL) return -1;
+		queue = grown;
+		queue_cap = cap;
+	}
+
+	//after the ones of the same or a higher priority
+	while(i > 0 && queue[i - 1].prio < q.prio) i--;
+	memmove(&queue[i + 1], &queue[i], (queue_count - i) * sizeof(struct queued));
+	queue[i] = q;
+	queue_count++;
+
+	return 0;
+}
+
+//the pipeline without surrounding spaces nor the &, like the job table shows it
+static void
+input_print(FILE *out, const char *input)
+{
+	size_t len;
+
+	while(isspace((unsigned char)*input)) input++;
+	len = strlen(input);
+	while(len > 0 && (isspace((unsigned char)input[len - 1]) || input[len - 1] == '&')) len--;
+	fprintf(out, "[queued] %.*s\n", (int)len, input);
+}
+//end of helper functions
+
+int
+msh_sched_queue(struct msh_pipeline *p)
+{
+	if(starting || !msh_pipeline_background(p)) return 0;
+
+	//the queue goes first, in case no job exited since there was room
+	msh_sched_run();
+	if(queue_count == 0 && admit()) return 0;
+
+	if(queue_insert(p) == -1) return 0;
+	input_print(stdout, msh_pipeline_input(p));
+
+	return 1;
+}
+
+void
+msh_sched_run(void)
+{
+	if(starting) return;
+
+	starting = 1;
+	msh_job_reap(); //the jobs that are done leave room
+	while(queue_count > 0 && admit())
+	{
+		struct msh_pipeline * p = queue[0].p;
+
+		memmove(&queue[0], &queue[1], (--queue_count) * sizeof(struct queued));
+		msh_execute(p);
+	}
+	starting = 0;
+}
+
+void
+msh_sched_finish(void)
+{
+	msh_sched_run();
+
+	//started as jobs exit, unless none is running to make room (e.g. the table is full of stopped ones)
+	while(queue_count > 0 && msh_job_count(MSH_JOB_RUNNING) > 0)
+	{
+		if(msh_event_wait(-1) == -1) break;
+	}
+}
+
+int
+msh_sched_queued(void)
+{
+	return queue_count;
+}
+
+void
+msh_sched_print(FILE *out)
+{
+	for(size_t i = 0; i < queue_count; i++) input_print(out, msh_pipeline_input(queue[i].p));
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdio.h>
+
+/***
+ * Admission control for background pipelines. At most `$MSH_JOBS`
+ * background jobs run at once; the pipelines sent to the background
+ * past that wait in a queue, and are started as the running jobs exit
+ * or stop. A script firing a burst of `cmd &` lines thus keeps the
+ * machine busy without oversubscribing it.
+ *
+ * `$MSH_JOBS` is a number of jobs, `cpus` (the default) for one job
+ * per online CPU, or `load` for the CPUs the load average leaves idle
+ * (at least one). The job table holds `MSH_MAXBACKGROUND` background
+ * jobs whatever the limit.
+ *
+ * The queue is ordered by priority, then first in, first out. A
+ * pipeline's priority is `$MSH_PRIO` (`0` if unset, higher starts
+ * first), which can be given to a single pipeline with an assignment,
+ * e.g. `MSH_PRIO=5 make -C docs &`.
+ */
+
+struct msh_pipeline;
+
+/**
+ * `msh_sched_queue` queues a background pipeline if it can't start
+ * now. It is called by `msh_execute` before it runs a pipeline.
+ *
+ * - `@p` - the pipeline.
+ * - `@return` - `1` if the pipeline was queued (the queue owns it),
+ *     `0` if it must be run now.
+ */
+int msh_sched_queue(struct msh_pipeline *p);
+
+/**
+ * `msh_sched_run` starts the queued pipelines there is room for. It
+ * is called when background jobs exit or stop.
+ */
+void msh_sched_run(void);
+
+/**
+ * `msh_sched_finish` waits for the queued pipelines to start, at the
+ * end of the shell's input, so that none is left behind.
+ */
+void msh_sched_finish(void);
+
+/**
+ * `msh_sched_queued` returns the number of queued pipelines.
+ */
+int msh_sched_queued(void);
+
+/**
+ * `msh_sched_print` prints the queue for the `jobs` builtin, one
+ * `[queued] pipeline` line per pipeline, in the order they'll start.
+ */
+void msh_sched_print(FILE *out);
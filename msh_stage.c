@@ -0,0 +1,411 @@
+#define _GNU_SOURCE
+#include <msh_stage.h>
+#include <msh_util.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/sendfile.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+//how many bytes we ask the kernel to move per splice/sendfile
+#define STAGE_CHUNK (1 << 20)
+//size of the buffer used when the kernel can't move the bytes for us
+#define STAGE_BUFSZ (1 << 16)
+
+//Helper functions:
+
+static int
+is_pipe(int fd)
+{
+	struct stat st;
+
+	if(fstat(fd, &st) == -1) return 0;
+	return S_ISFIFO(st.st_mode);
+}
+
+
+//read/write copy of up to len bytes, returns bytes moved, 0 on EOF, or -1
+static ssize_t
+copy_fallback(int in, int out, size_t len)
+{
+	char buf[STAGE_BUFSZ];
+	ssize_t n;
+
+	do {
+		n = read(in, buf, len < sizeof(buf) ? len : sizeof(buf));
+	} while(n == -1 && errno == EINTR);
+	if(n <= 0) return n;
+	if(msh_write_all(out, buf, n) == -1) return -1;
+
+	return n;
+}
+
+//move everything from in to out until EOF: splice if one side is a pipe,
+//sendfile if in is a regular file, and copy through user-space otherwise
+static int
+move_all(int in, int out)
+{
+	enum { MOVE_SPLICE, MOVE_SENDFILE, MOVE_COPY } method = MOVE_SPLICE;
+
+	if(!is_pipe(in) && !is_pipe(out)) method = MOVE_SENDFILE;
+
+	while(1)
+	{
+		ssize_t n;
+
+		if(method == MOVE_SPLICE)
+		{
+			n = splice(in, NULL, out, NULL, STAGE_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE);
+			if(n == -1 && errno == EINVAL)
+			{
+				method = MOVE_SENDFILE;
+				continue;
+			}
+		}
+		else if(method == MOVE_SENDFILE)
+		{
+			n = sendfile(out, in, NULL, STAGE_CHUNK);
+			if(n == -1 && (errno == EINVAL || errno == ENOSYS))
+			{
+				method = MOVE_COPY;
+				continue;
+			}
+		}
+		else n = copy_fallback(in, out, STAGE_CHUNK);
+
+		if(n == 0) return 0; //EOF
+		if(n == -1)
+		{
+			if(errno == EINTR) continue;
+			return -1;
+		}
+	}
+}
+
+//move exactly len bytes out of the pipe in and into out
+static int
+drain(int in, int out, size_t len)
+{
+	int copy = 0;
+
+	while(len > 0)
+	{
+		ssize_t n;
+
+		if(!copy)
+		{
+			n = splice(in, NULL, out, NULL, len, SPLICE_F_MOVE | SPLICE_F_MORE);
+			if(n == -1 && errno == EINVAL) //e.g. O_APPEND files on older kernels
+			{
+				copy = 1;
+				continue;
+			}
+		}
+		else n = copy_fallback(in, out, len);
+
+		if(n == 0) return -1; //the pipe can't run dry, it still holds len bytes
+		if(n == -1)
+		{
+			if(errno == EINTR) continue;
+			return -1;
+		}
+		len -= n;
+	}
+	return 0;
+}
+
+//duplicate the pipe in into every descriptor in outs. For each chunk, the
+//bytes are tee(2)d into a private pipe and spliced from there to every
+//output but the last one, which consumes the chunk from in.
+static int
+tee_pipe(int in, int *outs, int nouts)
+{
+	int tmp[2];
+	int ret = -1;
+
+	if(nouts == 1) return move_all(in, outs[0]);
+
+	if(pipe(tmp) == -1) return -1;
+	//an empty private pipe at least as large as in always takes a full tee
+	fcntl(tmp[1], F_SETPIPE_SZ, fcntl(in, F_GETPIPE_SZ) * 2);
+
+	while(1)
+	{
+		ssize_t chunk = 0;
+
+		for(int i = 0; i < nouts - 1; i++)
+		{
+			ssize_t n = tee(in, tmp[1], i == 0 ? STAGE_CHUNK : (size_t)chunk, 0);
+
+			if(n == -1 && errno == EINTR)
+			{
+				i--;
+				continue;
+			}
+			if(n == 0 && i == 0) //EOF
+			{
+				ret = 0;
+				goto done;
+			}
+			if(n == -1 || (i > 0 && n != chunk)) goto done;
+			chunk = n;
+
+			if(drain(tmp[0], outs[i], chunk) == -1) goto done;
+		}
+		if(drain(in, outs[nouts - 1], chunk) == -1) goto done;
+	}
+done:
+	close(tmp[0]);
+	close(tmp[1]);
+	return ret;
+}
+
+//read/write version of tee_pipe for when in isn't a pipe
+static int
+tee_copy(int in, int *outs, int nouts)
+{
+	char buf[STAGE_BUFSZ];
+
+	while(1)
+	{
+		ssize_t n = read(in, buf, sizeof(buf));
+
+		if(n == 0) return 0;
+		if(n == -1)
+		{
+			if(errno == EINTR) continue;
+			return -1;
+		}
+		for(int i = 0; i < nouts; i++)
+		{
+			if(msh_write_all(outs[i], buf, n) == -1) return -1;
+		}
+	}
+}
+
+static int
+stage_cat(char **args)
+{
+	int status = EXIT_SUCCESS;
+
+	if(args[1] == NULL)
+	{
+		if(move_all(STDIN_FILENO, STDOUT_FILENO) == -1)
+		{
+			fprintf(stderr, "cat: %s\n", strerror(errno));
+			return EXIT_FAILURE;
+		}
+		return status;
+	}
+
+	for(int i = 1; args[i] != NULL; i++)
+	{
+		int fd = STDIN_FILENO;
+
+		if(strcmp(args[i], "-") != 0) fd = open(args[i], O_RDONLY);
+		if(fd == -1)
+		{
+			fprintf(stderr, "cat: %s: %s\n", args[i], strerror(errno));
+			status = EXIT_FAILURE;
+			continue;
+		}
+		if(move_all(fd, STDOUT_FILENO) == -1)
+		{
+			fprintf(stderr, "cat: %s: %s\n", args[i], strerror(errno));
+			status = EXIT_FAILURE;
+		}
+		if(fd != STDIN_FILENO) close(fd);
+	}
+
+	return status;
+}
+
+static int
+stage_tee(char **args)
+{
+	int status = EXIT_SUCCESS;
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+	int nargs = 0, nouts = 0;
+	int *outs;
+	int ret;
+	int i;
+
+	for(i = 1; args[i] != NULL; i++) nargs++;
+	outs = malloc(sizeof(int) * (nargs + 1));
+	if(outs == NULL)
+	{
+		perror("tee: malloc failure");
+		return EXIT_FAILURE;
+	}
+
+	//-a appends to every file, wherever it is
+	for(i = 1; args[i] != NULL; i++)
+	{
+		if(strcmp(args[i], "-a") == 0) flags = O_WRONLY | O_CREAT | O_APPEND;
+	}
+
+	for(i = 1; args[i] != NULL; i++)
+	{
+		if(strcmp(args[i], "-a") == 0) continue;
+
+		outs[nouts] = open(args[i], flags, 0666);
+		if(outs[nouts] == -1)
+		{
+			fprintf(stderr, "tee: %s: %s\n", args[i], strerror(errno));
+			status = EXIT_FAILURE;
+			continue;
+		}
+		nouts++;
+	}
+	//standard out is last: it gets the bytes moved rather than duplicated
+	outs[nouts++] = STDOUT_FILENO;
+
+	if(is_pipe(STDIN_FILENO)) ret = tee_pipe(STDIN_FILENO, outs, nouts);
+	else ret = tee_copy(STDIN_FILENO, outs, nouts);
+	if(ret == -1)
+	{
+		fprintf(stderr, "tee: %s\n", strerror(errno));
+		status = EXIT_FAILURE;
+	}
+
+	for(i = 0; i < nouts - 1; i++) close(outs[i]);
+	free(outs);
+
+	return status;
+}
+//end of helper functions
+
+int
+msh_stage_native(char **args)
+{
+	if(args == NULL || args[0] == NULL) return 0;
+
+	//only the option-less forms are native, anything else runs the real program
+	if(strcmp(args[0], "cat") == 0)
+	{
+		for(int i = 1; args[i] != NULL; i++)
+		{
+			if(args[i][0] == '-' && args[i][1] != '\0') return 0;
+		}
+		return 1;
+	}
+
+	if(strcmp(args[0], "tee") == 0)
+	{
+		for(int i = 1; args[i] != NULL; i++)
+		{
+			if(args[i][0] == '-' && strcmp(args[i], "-a") != 0) return 0;
+		}
+		return 1;
+	}
+
+	return 0;
+}
+
+int
+msh_stage_run(char **args)
+{
+	if(strcmp(args[0], "cat") == 0) return stage_cat(args);
+	if(strcmp(args[0], "tee") == 0) return stage_tee(args);
+
+	return EXIT_FAILURE;
+}
+
+int
+msh_stage_buffer_grow(char **buf, size_t *cap, size_t len)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t new_cap = *cap == 0 ? page : *cap;
+	void * new_buf;
+
+	if(len <= *cap) return 0;
+	while(new_cap < len) new_cap *= 2;
+
+	//page-backed, so that vmsplice can give whole pages to the pipe
+	if(*buf == NULL) new_buf = mmap(NULL, new_cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	else new_buf = mremap(*buf, *cap, new_cap, MREMAP_MAYMOVE);
+	if(new_buf == MAP_FAILED) return -1;
+
+	*buf = new_buf;
+	*cap = new_cap;
+	return 0;
+}
+
+int
+msh_stage_heredoc(char *body, size_t len, size_t cap)
+{
+	int fds[2];
+	int fd;
+
+	if(pipe2(fds, O_CLOEXEC) == -1)
+	{
+		if(body != NULL) munmap(body, cap);
+		return -1;
+	}
+
+	//bodies that fit in a pipe: hand the body's pages over to the pipe. The
+	//pipe keeps its own references to them, so the buffer can be unmapped.
+	if(len <= (size_t)fcntl(fds[1], F_GETPIPE_SZ) || (size_t)fcntl(fds[1], F_SETPIPE_SZ, len) >= len)
+	{
+		struct iovec iov = { .iov_base = body, .iov_len = len };
+
+		while(iov.iov_len > 0)
+		{
+			//never block: we are the pipe's only reader and writer
+			ssize_t n = vmsplice(fds[1], &iov, 1, SPLICE_F_NONBLOCK);
+
+			if(n == -1)
+			{
+				if(errno == EINTR) continue;
+				break; //e.g. EAGAIN, the pipe holds fewer pages than it claimed
+			}
+			iov.iov_base = (char *)iov.iov_base + n;
+			iov.iov_len -= n;
+		}
+		if(iov.iov_len == 0)
+		{
+			close(fds[1]);
+			if(body != NULL) munmap(body, cap);
+			return fds[0];
+		}
+	}
+	close(fds[0]);
+	close(fds[1]);
+
+	//larger bodies (the pipe can only grow to /proc/sys/fs/pipe-max-size):
+	//a sealed memfd that the command reads like a file
+	fd = memfd_create("msh-heredoc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if(fd != -1)
+	{
+		if(msh_write_all(fd, body, len) == -1 ||
+		   fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == -1 ||
+		   lseek(fd, 0, SEEK_SET) == -1)
+		{
+			close(fd);
+			fd = -1;
+		}
+	}
+	munmap(body, cap);
+
+	return fd;
+}
+
+int
+msh_stage_herestring(char *str)
+{
+	char * body = NULL;
+	size_t cap = 0;
+	size_t len = strlen(str);
+
+	if(msh_stage_buffer_grow(&body, &cap, len + 1) == -1) return -1;
+	memcpy(body, str, len);
+	body[len] = '\n';
+
+	return msh_stage_heredoc(body, len + 1, cap);
+}
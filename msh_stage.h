@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+
+/***
+ * Shell-native pipeline stages. Some programs (`cat`, `tee`) only
+ * move bytes from one descriptor to another. Instead of `exec`ing
+ * them, the child forked for the stage runs them directly, moving
+ * the data with `splice`, `tee` and `sendfile` so that it never
+ * gets copied into user-space. Here-documents are handed to the
+ * first command of a pipeline the same way: their pages are given
+ * to a pipe rather than written into it.
+ */
+
+/**
+ * `msh_stage_native` tells us if the command with arguments `args`
+ * can be executed as a shell-native stage.
+ *
+ * - `@args` - the `NULL`-terminated argument list of the command.
+ * - `@return` - `1` if `msh_stage_run` can execute it, `0` if the
+ *     program must be `exec`ed.
+ */
+int msh_stage_native(char **args);
+
+/**
+ * `msh_stage_run` executes a shell-native stage reading from
+ * `STDIN_FILENO` and writing to `STDOUT_FILENO`. It is called in the
+ * child process of the stage instead of `execvp`.
+ *
+ * - `@args` - the `NULL`-terminated argument list of the command.
+ * - `@return` - the exit status of the stage.
+ */
+int msh_stage_run(char **args);
+
+/**
+ * `msh_stage_buffer_grow` makes sure a page-backed buffer can hold
+ * `len` bytes. Such buffers hold here-document bodies: their pages
+ * can be handed to a pipe by `msh_stage_heredoc` without copying.
+ *
+ * - `@buf` - the buffer, `NULL` before its first growth.
+ * - `@cap` - the buffer's capacity, `0` before its first growth.
+ * - `@len` - the number of bytes the buffer must be able to hold.
+ * - `@return` - `0` on success, `-1` if the buffer couldn't grow.
+ */
+int msh_stage_buffer_grow(char **buf, size_t *cap, size_t len);
+
+/**
+ * `msh_stage_heredoc` turns a here-document body into a descriptor
+ * from which a command can read it. Bodies that fit in a pipe are
+ * `vmsplice`d into one, larger bodies are put into a sealed
+ * `memfd`.
+ *
+ * - `@body` - the body, in a buffer from `msh_stage_buffer_grow`.
+ *     Ownership is passed to this function.
+ * - `@len` - the length of the body.
+ * - `@cap` - the capacity of the buffer holding the body.
+ * - `@return` - the descriptor to read the body from, or `-1`.
+ */
+int msh_stage_heredoc(char *body, size_t len, size_t cap);
+
+/**
+ * `msh_stage_herestring` is `msh_stage_heredoc` for the here-string
+ * `str` (i.e. `cmd <<< str`), whose body is `str` and a newline.
+ *
+ * - `@str` - the borrowed here-string.
+ * - `@return` - the descriptor to read the body from, or `-1`.
+ */
+int msh_stage_herestring(char *str);
@@ -0,0 +1,64 @@
+#define _GNU_SOURCE
+#include <msh.h>
+#include <msh_parse.h>
+#include <msh_subst.h>
+#include <msh_var.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+char *
+msh_subst_capture(const char *input)
+{
+	struct msh_sequence * s;
+	struct msh_pipeline * p;
+	struct stat st;
+	char * line, * out = NULL;
+	int fd;
+	ssize_t n = 0;
+
+	fd = memfd_create("msh_subst", MFD_CLOEXEC);
+	if(fd == -1)
+	{
+		perror("msh: $(...)");
+		return strdup("");
+	}
+	line = strdup(input);
+	s = msh_sequence_alloc();
+	if(line == NULL || s == NULL)
+	{
+		free(line);
+		if(s != NULL) msh_sequence_free(s);
+		close(fd);
+		return NULL;
+	}
+	msh_sequence_expander(s, msh_var_expand, NULL);
+
+	//the pipelines write to the file, the shell and the jobs it starts meanwhile write where they did.
+	//exit ends the substitution, as it would a subshell: the pipelines left are freed with s
+	if(msh_sequence_parse(line, s) == 0)
+	{
+		while((p = msh_sequence_pipeline(s)) != NULL)
+		{
+			if(msh_execute_fds(p, fd, STDERR_FILENO)) break;
+		}
+	}
+	if(msh_sequence_error(s, NULL) != 0) fprintf(stderr, "msh: $(%s): %s\n", input, msh_pipeline_err2str(msh_sequence_error(s, NULL)));
+	msh_sequence_free(s);
+	free(line);
+
+	if(fstat(fd, &st) == 0) out = malloc(st.st_size + 1);
+	if(out != NULL)
+	{
+		n = pread(fd, out, st.st_size, 0);
+		if(n < 0) n = 0;
+		while(n > 0 && out[n - 1] == '\n') n--;
+		out[n] = '\0';
+	}
+	close(fd);
+
+	return out;
+}
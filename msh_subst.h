@@ -0,0 +1,27 @@
+#pragma once
+
+/***
+ * Command substitution: `$(pipeline)` is replaced by the output of
+ * the pipeline, split into words. The pipeline is parsed and run by
+ * `msh_execute_fds` like any other, with an in-memory file (a
+ * `memfd`) as its standard output. Its processes write straight into
+ * the file, which the shell reads back with a single `read` once the
+ * pipeline is done; there is no pipe to drain while waiting for it.
+ * Builtins, and the stages the optimizer runs in the shell, print
+ * into the same file: a substituted builtin doesn't `fork`. The
+ * shell's own standard output is left alone, so the jobs it starts
+ * and the notifications it prints meanwhile aren't captured, and
+ * `exit` only ends the substitution, as it would a subshell.
+ */
+
+/**
+ * `msh_subst_capture` runs a sequence of pipelines and returns their
+ * output.
+ *
+ * - `@input` - the borrowed pipelines, as typed between the `$(` and
+ *     the `)`.
+ * - `@return` - the output to `free`, without its trailing newlines,
+ *     or `NULL` on allocation failure. The output is empty if the
+ *     pipelines couldn't be run.
+ */
+char *msh_subst_capture(const char *input);
@@ -0,0 +1,181 @@
+#include <msh_timer.h>
+#include <msh_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+struct msh_timer {
+	uint64_t when; //CLOCK_MONOTONIC nanoseconds
+	size_t index; //in the heap
+	msh_timer_fn fn;
+	void * data;
+};
+
+//the min-heap of the timers, the first to expire at its root
+static struct msh_timer ** heap;
+static size_t heap_count, heap_cap;
+static int timer_fd = -1;
+
+//Helper functions:
+
+static uint64_t
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+heap_set(size_t i, struct msh_timer *t)
+{
+	heap[i] = t;
+	t->index = i;
+}
+
+static void
+sift_up(size_t i)
+{
+	struct msh_timer * t = heap[i];
+
+	while(i > 0 && heap[(i - 1) / 2]->when > t->when)
+	{
+		heap_set(i, heap[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+	heap_set(i, t);
+}
+
+static void
+sift_down(size_t i)
+{
+	struct msh_timer * t = heap[i];
+
+	for(;;)
+	{
+		size_t child = 2 * i + 1;
+
+		if(child >= heap_count) break;
+		if(child + 1 < heap_count && heap[child + 1]->when < heap[child]->when) child++;
+		if(heap[child]->when >= t->when) break;
+		heap_set(i, heap[child]);
+		i = child;
+	}
+	heap_set(i, t);
+}
+
+static void
+heap_remove(struct msh_timer *t)
+{
+	struct msh_timer * last;
+	size_t i = t->index;
+
+	//the last timer takes its place, and goes down or up from there
+	last = heap[--heap_count];
+	if(i == heap_count) return;
+	heap_set(i, last);
+	sift_down(i);
+	sift_up(last->index);
+}
+
+//arm the timerfd for the first timer to expire
+static void
+timer_arm(void)
+{
+	struct itimerspec spec = { 0 }; //disarmed without timers
+
+	if(heap_count > 0)
+	{
+		spec.it_value.tv_sec = heap[0]->when / 1000000000;
+		spec.it_value.tv_nsec = heap[0]->when % 1000000000;
+	}
+	if(timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) == -1) perror("msh: timerfd_settime");
+}
+
+//called by the event loop when the first timer expired
+static void
+timer_ready(int fd, uint32_t events, void *data)
+{
+	uint64_t expirations;
+	uint64_t time = now();
+
+	(void)events;
+	(void)data;
+	if(read(fd, &expirations, sizeof(expirations)) == -1) return; //re-armed before we got here
+
+	while(heap_count > 0 && heap[0]->when <= time)
+	{
+		struct msh_timer * t = heap[0];
+
+		heap_remove(t);
+		t->fn(t->data);
+		free(t);
+	}
+	timer_arm();
+}
+//end of helper functions
+
+struct msh_timer *
+msh_timer_add(uint64_t ms, msh_timer_fn fn, void *data)
+{
+	struct msh_timer * t;
+
+	if(timer_fd == -1)
+	{
+		timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		if(timer_fd == -1) return NULL;
+		if(msh_event_add(timer_fd, EPOLLIN, timer_ready, NULL) == -1)
+		{
+			close(timer_fd);
+			timer_fd = -1;
+			return NULL;
+		}
+	}
+	if(heap_count == heap_cap)
+	{
+		size_t cap = heap_cap == 0 ? 64 : heap_cap * 2;
+		struct msh_timer ** grown = realloc(heap, cap * sizeof(struct msh_timer *));
+
+		if(grown == NULL) return NULL;
+		heap = grown;
+		heap_cap = cap;
+	}
+
+	t = malloc(sizeof(struct msh_timer));
+	if(t == NULL) return NULL;
+	*t = (struct msh_timer) { .when = now() + ms * 1000000, .fn = fn, .data = data };
+	heap[heap_count] = t;
+	sift_up(heap_count++);
+	if(heap[0] == t) timer_arm();
+
+	return t;
+}
+
+void
+msh_timer_cancel(struct msh_timer *t)
+{
+	int first = t->index == 0;
+
+	heap_remove(t);
+	free(t);
+	if(first) timer_arm();
+}
+
+long
+msh_timer_duration(const char *str)
+{
+	char * end;
+	double n = strtod(str, &end);
+
+	if(end == str || n < 0) return -1;
+	if(strcmp(end, "ms") == 0) return n;
+	if(strcmp(end, "") == 0 || strcmp(end, "s") == 0) return n * 1000;
+	if(strcmp(end, "m") == 0) return n * 60 * 1000;
+	if(strcmp(end, "h") == 0) return n * 3600 * 1000;
+	return -1;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+/***
+ * Timers run by the event loop. All the timers share a single
+ * `timerfd`, armed for the one that expires first: the timers are
+ * kept in a binary min-heap on their expiry time, so adding and
+ * cancelling one is `O(log n)` whatever the number of jobs with a
+ * deadline, and no process sleeps on behalf of a job.
+ */
+
+struct msh_timer;
+
+/**
+ * `msh_timer_fn` is called by the event loop when a timer expires.
+ * The timer is freed once it returns, and mustn't be cancelled.
+ *
+ * - `@data` - the data passed to `msh_timer_add`.
+ */
+typedef void (*msh_timer_fn)(void *data);
+
+/**
+ * `msh_timer_add` starts a timer.
+ *
+ * - `@ms` - the milliseconds until it expires.
+ * - `@fn` - called when it expires.
+ * - `@data` - passed to `fn`.
+ * - `@return` - the timer, or `NULL` on failure.
+ */
+struct msh_timer *msh_timer_add(uint64_t ms, msh_timer_fn fn, void *data);
+
+/**
+ * `msh_timer_cancel` stops a timer that hasn't expired, and frees it.
+ */
+void msh_timer_cancel(struct msh_timer *t);
+
+/**
+ * `msh_timer_duration` reads a duration: a number of seconds (e.g.
+ * `1.5`), or a number followed by `ms`, `s`, `m` or `h`.
+ *
+ * - `@str` - the duration.
+ * - `@return` - the duration in milliseconds, or `-1` if `str` isn't
+ *     one.
+ */
+long msh_timer_duration(const char *str);
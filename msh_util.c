@@ -0,0 +1,33 @@
+#include <msh_util.h>
+#include <errno.h>
+#include <unistd.h>
+
+int
+msh_write_all(int fd, const void *buf, size_t len)
+{
+	const char * p = buf;
+
+	while(len > 0)
+	{
+		ssize_t n = write(fd, p, len);
+
+		if(n == -1 && errno == EINTR) continue;
+		if(n == -1) return -1;
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+uint64_t
+msh_hash(uint64_t h, const void *data, size_t len)
+{
+	const unsigned char * bytes = data;
+
+	for(size_t i = 0; i < len; i++)
+	{
+		h ^= bytes[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
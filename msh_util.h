@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/***
+ * Small helpers shared by the shell's modules: writing a whole
+ * buffer, and the 64 bit FNV-1a hash (of compiled scripts, of `memo`
+ * keys).
+ */
+
+//the FNV-1a offset basis, the hash of no data
+#define MSH_HASH_INIT 14695981039346656037ull
+
+/**
+ * `msh_write_all` writes a whole buffer, retrying short writes and
+ * interrupted ones.
+ *
+ * - `@fd` - the descriptor.
+ * - `@buf` - the data.
+ * - `@len` - its size.
+ * - `@return` - `0` on success, `-1` on failure (`errno` is set).
+ */
+int msh_write_all(int fd, const void *buf, size_t len);
+
+/**
+ * `msh_hash` adds data to a 64 bit FNV-1a hash. It is fast, not
+ * collision resistant: what it finds must be checked.
+ *
+ * - `@h` - the hash so far, `MSH_HASH_INIT` to start one.
+ * - `@data` - the data.
+ * - `@len` - its size.
+ * - `@return` - the hash of the data added to `h`.
+ */
+uint64_t msh_hash(uint64_t h, const void *data, size_t len);
@@ -0,0 +1,399 @@
+#define _GNU_SOURCE
+#include <msh.h>
+#include <msh_var.h>
+#include <msh_subst.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <pthread.h>
+
+extern char **environ;
+
+struct msh_var {
+	char * str; //"NAME=value", or "NAME=" while it isn't set
+	size_t name_len;
+	uint32_t hash;
+	int set;
+	int exported;
+	long env; //its index in envp, -1 if it isn't in the environment
+};
+
+//the variables, and an open-addressing table of their index + 1
+static struct msh_var * vars;
+static size_t vars_count, vars_cap;
+static uint32_t * table;
+static size_t table_cap;
+
+//the environment: the strings of the exported variables that are set, NULL terminated
+static char ** envp;
+static size_t envp_count, envp_cap;
+
+//the variables are only changed by the shell's thread, which holds the lock for writing
+//meanwhile: the other threads read them with it held, see msh_var_copy
+static pthread_rwlock_t vars_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+//Helper functions:
+
+//FNV-1a
+static uint32_t
+hash_name(const char *name, size_t len)
+{
+	uint32_t h = 2166136261u;
+
+	for(size_t i = 0; i < len; i++)
+	{
+		h ^= (unsigned char)name[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static int
+table_grow(void)
+{
+	size_t cap = table_cap == 0 ? 256 : table_cap * 2;
+	uint32_t * grown = calloc(cap, sizeof(uint32_t));
+
+	if(grown == NULL) return -1;
+	for(size_t i = 0; i < vars_count; i++)
+	{
+		size_t slot = vars[i].hash & (cap - 1);
+
+		while(grown[slot] != 0) slot = (slot + 1) & (cap - 1);
+		grown[slot] = i + 1;
+	}
+	free(table);
+	table = grown;
+	table_cap = cap;
+
+	return 0;
+}
+
+static struct msh_var *
+var_find(const char *name, size_t len)
+{
+	uint32_t h = hash_name(name, len);
+
+	if(table_cap == 0) return NULL;
+	for(size_t slot = h & (table_cap - 1); table[slot] != 0; slot = (slot + 1) & (table_cap - 1))
+	{
+		struct msh_var * v = &vars[table[slot] - 1];
+
+		if(v->hash == h && v->name_len == len && memcmp(v->str, name, len) == 0) return v;
+	}
+	return NULL;
+}
+
+//the variable, added unset if there's none
+static struct msh_var *
+var_intern(const char *name, size_t len)
+{
+	struct msh_var * v = var_find(name, len);
+	size_t slot;
+
+	if(v != NULL) return v;
+
+	if((vars_count + 1) * 2 > table_cap && table_grow() == -1) return NULL;
+	if(vars_count == vars_cap)
+	{
+		size_t cap = vars_cap == 0 ? 128 : vars_cap * 2;
+		struct msh_var * grown = realloc(vars, cap * sizeof(struct msh_var));
+
+		if(grown == NULL) return NULL;
+		vars = grown;
+		vars_cap = cap;
+	}
+
+	v = &vars[vars_count];
+	*v = (struct msh_var) { .name_len = len, .hash = hash_name(name, len), .env = -1 };
+	v->str = malloc(len + 2);
+	if(v->str == NULL) return NULL;
+	memcpy(v->str, name, len);
+	strcpy(v->str + len, "=");
+
+	for(slot = v->hash & (table_cap - 1); table[slot] != 0; slot = (slot + 1) & (table_cap - 1));
+	table[slot] = ++vars_count;
+
+	return v;
+}
+
+//make room for one more string in the environment
+static int
+envp_reserve(void)
+{
+	if(envp_count + 2 > envp_cap)
+	{
+		size_t cap = envp_cap == 0 ? 128 : envp_cap * 2;
+		char ** grown = realloc(envp, cap * sizeof(char *));
+
+		if(grown == NULL) return -1;
+		envp = grown;
+		envp_cap = cap;
+		environ = envp;
+	}
+	return 0;
+}
+
+//put a variable's string in the environment, replacing the one it had there
+static int
+envp_update(struct msh_var *v)
+{
+	if(!v->exported || !v->set) return 0;
+
+	if(v->env == -1)
+	{
+		if(envp_reserve() == -1) return -1;
+		v->env = envp_count++;
+		envp[envp_count] = NULL;
+	}
+	envp[v->env] = v->str;
+
+	return 0;
+}
+
+//set the variable named by the len bytes of name, without updating the environment
+static struct msh_var *
+var_set(const char *name, size_t len, const char *value)
+{
+	struct msh_var * v = var_intern(name, len);
+	char * str;
+
+	if(v == NULL) return NULL;
+	str = malloc(len + strlen(value) + 2);
+	if(str == NULL) return NULL;
+	sprintf(str, "%.*s=%s", (int)len, name, value);
+
+	free(v->str);
+	v->str = str;
+	v->set = 1;
+
+	return v;
+}
+
+static int
+is_name_char(char c, int first)
+{
+	return c == '_' || isalpha((unsigned char)c) || (!first && isdigit((unsigned char)c));
+}
+
+//append len bytes to a growing buffer
+static int
+buf_append(char **buf, size_t *len, size_t *cap, const char *str, size_t n)
+{
+	if(*len + n + 1 > *cap)
+	{
+		size_t new_cap = *cap * 2 > *len + n + 1 ? *cap * 2 : *len + n + 1;
+		char * grown = realloc(*buf, new_cap);
+
+		if(grown == NULL) return -1;
+		*buf = grown;
+		*cap = new_cap;
+	}
+	memcpy(*buf + *len, str, n);
+	*len += n;
+	(*buf)[*len] = '\0';
+
+	return 0;
+}
+//end of helper functions
+
+int
+msh_var_init(void)
+{
+	char ** env = environ; //environ is envp from the first envp_reserve
+	int ret = 0;
+
+	pthread_rwlock_wrlock(&vars_lock);
+	if(envp_reserve() == -1) ret = -1;
+	else envp[0] = NULL;
+	for(size_t i = 0; ret == 0 && env != NULL && env[i] != NULL; i++)
+	{
+		char * eq = strchr(env[i], '=');
+		struct msh_var * v;
+
+		if(eq == NULL) continue;
+		v = var_set(env[i], eq - env[i], eq + 1);
+		if(v == NULL)
+		{
+			ret = -1;
+			break;
+		}
+		v->exported = 1;
+		ret = envp_update(v);
+	}
+	pthread_rwlock_unlock(&vars_lock);
+
+	return ret;
+}
+
+const char *
+msh_var_get(const char *name)
+{
+	struct msh_var * v = var_find(name, strlen(name));
+
+	if(v == NULL || !v->set) return NULL;
+	return v->str + v->name_len + 1;
+}
+
+char *
+msh_var_copy(const char *name)
+{
+	struct msh_var * v;
+	char * value = NULL;
+
+	pthread_rwlock_rdlock(&vars_lock);
+	v = var_find(name, strlen(name));
+	if(v != NULL && v->set) value = strdup(v->str + v->name_len + 1);
+	pthread_rwlock_unlock(&vars_lock);
+
+	return value;
+}
+
+int
+msh_var_set(const char *name, const char *value)
+{
+	struct msh_var * v;
+	int ret = -1;
+
+	pthread_rwlock_wrlock(&vars_lock);
+	v = var_set(name, strlen(name), value);
+	if(v != NULL) ret = envp_update(v);
+	pthread_rwlock_unlock(&vars_lock);
+
+	return ret;
+}
+
+int
+msh_var_export(const char *name)
+{
+	struct msh_var * v;
+	int ret = -1;
+
+	pthread_rwlock_wrlock(&vars_lock);
+	v = var_intern(name, strlen(name));
+	if(v != NULL)
+	{
+		v->exported = 1;
+		ret = envp_update(v);
+	}
+	pthread_rwlock_unlock(&vars_lock);
+
+	return ret;
+}
+
+int
+msh_var_assignment(const char *word)
+{
+	int len = 0;
+
+	if(!is_name_char(word[0], 1)) return 0;
+	while(is_name_char(word[len], 0)) len++;
+
+	return word[len] == '=' ? len : 0;
+}
+
+char *
+msh_var_expand(const char *word, void *data)
+{
+	char * buf = NULL;
+	size_t len = 0, cap = 0;
+
+	(void)data;
+
+	if(buf_append(&buf, &len, &cap, "", 0) == -1) return NULL;
+	while(*word != '\0')
+	{
+		const char * dollar = strchr(word, '$'), * name, * value;
+		size_t name_len = 0;
+		int braces;
+		struct msh_var * v;
+
+		if(dollar == NULL) dollar = word + strlen(word);
+		if(buf_append(&buf, &len, &cap, word, dollar - word) == -1) goto fail;
+		if(*dollar == '\0') break;
+
+		//$(pipeline) is replaced by its output
+		if(dollar[1] == '(')
+		{
+			const char * end = dollar + 2;
+			char * inner, * out;
+			int depth = 1;
+
+			for(; *end != '\0'; end++)
+			{
+				if(*end == '(') depth++;
+				else if(*end == ')' && --depth == 0) break;
+			}
+			if(*end == ')')
+			{
+				inner = strndup(dollar + 2, end - dollar - 2);
+				out = inner != NULL ? msh_subst_capture(inner) : NULL;
+				free(inner);
+				if(out == NULL || buf_append(&buf, &len, &cap, out, strlen(out)) == -1)
+				{
+					free(out);
+					goto fail;
+				}
+				free(out);
+				word = end + 1;
+				continue;
+			}
+		}
+
+		//$? is the exit status of the last pipeline
+		if(dollar[1] == '?')
+		{
+			char status[16];
+
+			snprintf(status, sizeof(status), "%d", msh_execute_status());
+			if(buf_append(&buf, &len, &cap, status, strlen(status)) == -1) goto fail;
+			word = dollar + 2;
+			continue;
+		}
+
+		braces = dollar[1] == '{';
+		name = dollar + 1 + braces;
+		if(is_name_char(name[0], 1))
+		{
+			while(is_name_char(name[name_len], 0)) name_len++;
+		}
+		if(name_len == 0 || (braces && name[name_len] != '}'))
+		{
+			//a $ without a name is kept
+			if(buf_append(&buf, &len, &cap, "$", 1) == -1) goto fail;
+			word = dollar + 1;
+			continue;
+		}
+
+		v = var_find(name, name_len);
+		value = v != NULL && v->set ? v->str + v->name_len + 1 : "";
+		if(buf_append(&buf, &len, &cap, value, strlen(value)) == -1) goto fail;
+		word = name + name_len + braces;
+	}
+
+	return buf;
+fail:
+	free(buf);
+	return NULL;
+}
+
+void
+msh_var_child(char **assignments)
+{
+	for(int i = 0; assignments[i] != NULL; i++)
+	{
+		struct msh_var * v = var_find(assignments[i], msh_var_assignment(assignments[i]));
+
+		//only this process' copy of the array is written to
+		if(v != NULL && v->env != -1) envp[v->env] = assignments[i];
+		else if(envp_reserve() == 0)
+		{
+			envp[envp_count++] = assignments[i];
+			envp[envp_count] = NULL;
+		}
+	}
+	environ = envp;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+/***
+ * The shell's variables. Each variable has a value, and is exported
+ * or not: the exported ones make up the environment of the programs
+ * the shell runs. At startup, the variables are the shell's
+ * environment, all exported.
+ *
+ * Variables are kept in a hash table. The environment is an `envp`
+ * array of the exported variables, kept up to date as they change (a
+ * changed variable only has its entry replaced), so that running a
+ * program never builds it. `environ` is that array, thus `getenv` and
+ * `execvp` see the shell's variables.
+ *
+ * The `NAME=value` assignments before a program (e.g. `LC_ALL=C sort`)
+ * are only set in the environment of that program, in its child
+ * process, over the inherited copy of the array.
+ *
+ * Variables are set and read by the shell's thread. As setting one
+ * can free the previous value and move `environ`, the other threads
+ * (e.g. the `linenoise` callbacks on the input thread) must neither
+ * call `getenv` nor `msh_var_get`, but `msh_var_copy`.
+ */
+
+/**
+ * `msh_var_init` imports the environment as the shell's variables.
+ *
+ * - `@return` - `0` on success, `-1` on allocation failure.
+ */
+int msh_var_init(void);
+
+/**
+ * `msh_var_get` returns the value of a variable.
+ *
+ * - `@name` - the borrowed name of the variable.
+ * - `@return` - the borrowed value, until the variable changes, or
+ *     `NULL` if the variable isn't set.
+ */
+const char *msh_var_get(const char *name);
+
+/**
+ * `msh_var_copy` returns a copy of the value of a variable. Unlike
+ * `msh_var_get`, it can be called from any thread.
+ *
+ * - `@name` - the borrowed name of the variable.
+ * - `@return` - the value to `free`, or `NULL` if the variable isn't
+ *     set (or on allocation failure).
+ */
+char *msh_var_copy(const char *name);
+
+/**
+ * `msh_var_set` sets a variable, which stays exported if it was.
+ *
+ * - `@name` - the borrowed name of the variable.
+ * - `@value` - the borrowed value.
+ * - `@return` - `0` on success, `-1` on allocation failure.
+ */
+int msh_var_set(const char *name, const char *value);
+
+/**
+ * `msh_var_export` adds a variable to the environment. A variable
+ * that isn't set is added once it is.
+ *
+ * - `@name` - the borrowed name of the variable.
+ * - `@return` - `0` on success, `-1` on allocation failure.
+ */
+int msh_var_export(const char *name);
+
+/**
+ * `msh_var_assignment` tells us if a word is a `NAME=value`
+ * assignment.
+ *
+ * - `@word` - the word.
+ * - `@return` - the length of `NAME`, or `0` if `word` isn't an
+ *     assignment.
+ */
+int msh_var_assignment(const char *word);
+
+/**
+ * `msh_var_expand` replaces the `$NAME` and `${NAME}` in a word by
+ * the values of the variables, or by nothing for the ones that
+ * aren't set, and `$?` by the exit status of the last pipeline. It is the `msh_expand_fn_t` of the shell's sequence.
+ *
+ * - `@word` - the borrowed word.
+ * - `@data` - unused.
+ * - `@return` - the expanded word to `free`, or `NULL` on allocation
+ *     failure.
+ */
+char *msh_var_expand(const char *word, void *data);
+
+/**
+ * `msh_var_child` sets `NAME=value` assignments in the environment,
+ * in the child process of a command about to be executed. The shell's
+ * variables are left as they were, in the shell.
+ *
+ * - `@assignments` - the `NULL`-terminated assignments, borrowed for
+ *     as long as the environment is used.
+ */
+void msh_var_child(char **assignments);
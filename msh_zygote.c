@@ -0,0 +1,309 @@
+#define _GNU_SOURCE
+#include <msh.h>
+#include <msh_zygote.h>
+#include <msh_job.h>
+#include <msh_event.h>
+#include <msh_stage.h>
+#include <msh_sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+
+//the largest request: the arguments and the environment of a command, under the socket's buffer size
+#define MSH_ZYGOTE_MSGMAX (64 * 1024)
+
+extern char **environ;
+
+//followed by the arguments, then the environment (the command's assignments first), each NUL terminated
+struct zygote_request {
+	pid_t pgid;
+	int foreground;
+	mode_t umask; //the shell's, for the command
+	int argc;
+	int envc;
+};
+
+//passed with a request: the command's standard input, output and error, then the shell's working directory
+#define ZYGOTE_FDS 4
+
+typedef enum {
+	ZYGOTE_PID, //the pid of the command requested, -1 if it couldn't be forked
+	ZYGOTE_STATUS, //a command's waitpid status
+} zygote_reply_t;
+
+struct zygote_reply {
+	zygote_reply_t type;
+	pid_t pid;
+	int status;
+};
+
+static int sock = -1; //the shell's end, -1 without a zygote
+
+//Helper functions:
+
+//the zygote's side: fork the command of a request, in the shell's working directory
+static pid_t
+zygote_fork(char *msg, size_t len, int fds[ZYGOTE_FDS], int terminal, sigset_t *mask)
+{
+	struct zygote_request * req = (struct zygote_request *)msg;
+	char ** strs = calloc(req->argc + req->envc + 2, sizeof(char *));
+	char * s = msg + sizeof(struct zygote_request);
+	pid_t pid;
+
+	if(strs == NULL) return -1;
+	for(int i = 0; i < req->argc + req->envc; i++)
+	{
+		strs[i + (i >= req->argc)] = s;
+		s += strnlen(s, msg + len - s) + 1;
+		if(s > msg + len)
+		{
+			free(strs);
+			return -1;
+		}
+	}
+
+	pid = fork();
+	if(pid == 0)
+	{
+		pid_t pgid = req->pgid == 0 ? getpid() : req->pgid;
+
+		setpgid(0, pgid);
+		if(terminal != -1 && req->foreground) tcsetpgrp(terminal, pgid);
+		msh_job_child(NULL);
+		sigprocmask(SIG_SETMASK, mask, NULL);
+		if(fchdir(fds[3]) == -1)
+		{
+			perror("msh: zygote: fchdir");
+			_exit(EXIT_FAILURE);
+		}
+		umask(req->umask);
+
+		for(int fd = 0; fd < 3; fd++)
+		{
+			if(fds[fd] != fd) dup2(fds[fd], fd);
+		}
+		for(int fd = 0; fd < ZYGOTE_FDS; fd++)
+		{
+			if(fds[fd] > 2) close(fds[fd]);
+		}
+		close(sock);
+		if(terminal != -1) close(terminal);
+		environ = strs + req->argc + 1;
+
+		//cat/tee only move bytes, so run them here instead of exec'ing them
+		if(msh_stage_native(strs)) _exit(msh_stage_run(strs));
+		execvp(strs[0], strs);
+		perror("msh_execute: execvp");
+		_exit(EXIT_FAILURE);
+	}
+	//also done by the child: whichever runs first creates the group
+	if(pid > 0) setpgid(pid, req->pgid == 0 ? pid : req->pgid);
+	free(strs);
+
+	return pid;
+}
+
+//the zygote's loop: fork the commands requested, and send back their statuses
+static void
+zygote_run(void)
+{
+	sigset_t chld, mask;
+	struct pollfd polls[2];
+	char * msg = malloc(MSH_ZYGOTE_MSGMAX);
+	int terminal = isatty(STDIN_FILENO) ? dup(STDIN_FILENO) : -1;
+
+	//terminal signals are for the shell and its jobs, not for us
+	setpgid(0, 0);
+	signal(SIGINT, SIG_IGN);
+	signal(SIGTSTP, SIG_IGN);
+	signal(SIGQUIT, SIG_IGN);
+
+	sigemptyset(&chld);
+	sigaddset(&chld, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &chld, &mask);
+	polls[0] = (struct pollfd) { .fd = sock, .events = POLLIN };
+	polls[1] = (struct pollfd) { .fd = signalfd(-1, &chld, SFD_NONBLOCK | SFD_CLOEXEC), .events = POLLIN };
+	if(msg == NULL || polls[1].fd == -1) _exit(EXIT_FAILURE);
+
+	while(poll(polls, 2, -1) != -1 || errno == EINTR)
+	{
+		if(polls[1].revents & POLLIN)
+		{
+			struct signalfd_siginfo info;
+			struct zygote_reply r = { .type = ZYGOTE_STATUS };
+
+			while(read(polls[1].fd, &info, sizeof(info)) > 0);
+			while((r.pid = waitpid(-1, &r.status, WNOHANG | WUNTRACED | WCONTINUED)) > 0) send(sock, &r, sizeof(r), MSG_NOSIGNAL);
+		}
+		if(polls[0].revents & (POLLIN | POLLHUP))
+		{
+			char control[CMSG_SPACE(ZYGOTE_FDS * sizeof(int))];
+			struct iovec iov = { .iov_base = msg, .iov_len = MSH_ZYGOTE_MSGMAX };
+			struct msghdr hdr = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control, .msg_controllen = sizeof(control) };
+			struct cmsghdr * cmsg;
+			struct zygote_reply r = { .type = ZYGOTE_PID, .pid = -1 };
+			int fds[ZYGOTE_FDS] = { -1, -1, -1, -1 };
+			ssize_t n = recvmsg(sock, &hdr, MSG_CMSG_CLOEXEC);
+
+			if(n <= 0) _exit(EXIT_SUCCESS); //the shell is gone
+
+			cmsg = CMSG_FIRSTHDR(&hdr);
+			if(cmsg != NULL && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(fds))) memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+			if(fds[0] != -1 && (size_t)n >= sizeof(struct zygote_request) && !(hdr.msg_flags & MSG_TRUNC))
+			{
+				r.pid = zygote_fork(msg, n, fds, terminal, &mask);
+			}
+			for(int i = 0; i < ZYGOTE_FDS; i++)
+			{
+				if(fds[i] != -1) close(fds[i]);
+			}
+			send(sock, &r, sizeof(r), MSG_NOSIGNAL);
+		}
+	}
+	_exit(EXIT_FAILURE);
+}
+
+//the shell's side: a status or pid from the zygote
+static void
+reply_handle(struct zygote_reply *r)
+{
+	if(r->type == ZYGOTE_STATUS) msh_job_update(r->pid, r->status);
+}
+
+//called by the event loop when statuses can be read
+static void
+zygote_ready(int fd, uint32_t events, void *data)
+{
+	struct zygote_reply r;
+
+	(void)events;
+	(void)data;
+	while(recv(fd, &r, sizeof(r), MSG_DONTWAIT) == sizeof(r)) reply_handle(&r);
+	msh_sched_run();
+}
+
+//append a NULL-terminated array of strings to a request
+static int
+request_append(char *msg, size_t *len, char **strs, int *count)
+{
+	for(int i = 0; strs != NULL && strs[i] != NULL; i++)
+	{
+		size_t n = strlen(strs[i]) + 1;
+
+		if(*len + n > MSH_ZYGOTE_MSGMAX) return -1;
+		memcpy(msg + *len, strs[i], n);
+		*len += n;
+		(*count)++;
+	}
+	return 0;
+}
+//end of helper functions
+
+int
+msh_zygote_init(void)
+{
+	int pair[2];
+	pid_t pid;
+
+	if(getenv("MSH_ZYGOTE") == NULL) return 0;
+	if(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, pair) == -1) return -1;
+
+	fflush(stdout);
+	pid = fork();
+	if(pid == -1)
+	{
+		close(pair[0]);
+		close(pair[1]);
+		return -1;
+	}
+	if(pid == 0)
+	{
+		close(pair[0]);
+		sock = pair[1];
+		zygote_run();
+	}
+	close(pair[1]);
+	sock = pair[0];
+
+	return 0;
+}
+
+int
+msh_zygote_listen(void)
+{
+	if(sock == -1) return 0;
+	return msh_event_add(sock, EPOLLIN, zygote_ready, NULL);
+}
+
+pid_t
+msh_zygote_spawn(char **args, char **assignments, pid_t pgid, int foreground, int fds[3])
+{
+	static char msg[MSH_ZYGOTE_MSGMAX];
+	struct zygote_request * req = (struct zygote_request *)msg;
+	size_t len = sizeof(struct zygote_request);
+	char control[CMSG_SPACE(ZYGOTE_FDS * sizeof(int))] = { 0 };
+	int passed[ZYGOTE_FDS] = { fds[0], fds[1], fds[2], -1 };
+	struct iovec iov;
+	struct msghdr hdr;
+	struct cmsghdr * cmsg;
+	struct zygote_reply r;
+	int sent;
+
+	if(sock == -1) return -1;
+
+	//the assignments come before the environment, so that getenv finds them first
+	*req = (struct zygote_request) { .pgid = pgid, .foreground = foreground, .umask = umask(0) };
+	umask(req->umask);
+	if(request_append(msg, &len, args, &req->argc) == -1 || request_append(msg, &len, assignments, &req->envc) == -1 ||
+	   request_append(msg, &len, environ, &req->envc) == -1)
+	{
+		return -1;
+	}
+
+	//the zygote stays where the shell started, the command goes where the shell is now
+	passed[3] = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+	if(passed[3] == -1) return -1;
+
+	iov = (struct iovec) { .iov_base = msg, .iov_len = len };
+	hdr = (struct msghdr) { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control, .msg_controllen = sizeof(control) };
+	cmsg = CMSG_FIRSTHDR(&hdr);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(ZYGOTE_FDS * sizeof(int));
+	memcpy(CMSG_DATA(cmsg), passed, ZYGOTE_FDS * sizeof(int));
+
+	sent = sendmsg(sock, &hdr, MSG_NOSIGNAL) != -1;
+	close(passed[3]);
+	if(!sent)
+	{
+		if(errno == EMSGSIZE) return -1;
+		perror("msh: zygote");
+		msh_event_del(sock);
+		close(sock);
+		sock = -1;
+		return -1;
+	}
+
+	//statuses of other commands can come before the pid
+	while(recv(sock, &r, sizeof(r), 0) == sizeof(r))
+	{
+		if(r.type == ZYGOTE_PID) return r.pid;
+		reply_handle(&r);
+	}
+
+	//the zygote is gone, commands are forked by the shell from now on
+	msh_event_del(sock);
+	close(sock);
+	sock = -1;
+	return -1;
+}
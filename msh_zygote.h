@@ -0,0 +1,56 @@
+#pragma once
+
+#include <sys/types.h>
+
+/***
+ * The zygote: an optional helper process that forks the shell's
+ * commands. It is forked by `msh_init` while the shell is still small
+ * (before its threads, history and completion tables exist), so that
+ * forking from it costs the same whatever the shell grows into.
+ *
+ * The shell sends it launch requests over a Unix socket: the
+ * arguments, the environment, the umask, and the descriptors of the
+ * command's standard input, output and error (pipe ends, redirected
+ * files) and of the shell's working directory, passed with
+ * `SCM_RIGHTS`. The zygote forks the command, puts it in
+ * its job's process group, and sends its pid back. Commands are the
+ * zygote's children, so it also sends back their `waitpid` statuses,
+ * which the shell reads in its event loop to update its jobs.
+ *
+ * The zygote is used if the `MSH_ZYGOTE` environment variable is set
+ * when the shell starts. If it can't be used, commands are forked by
+ * the shell as usual.
+ */
+
+/**
+ * `msh_zygote_init` forks the zygote, if `MSH_ZYGOTE` is set. It is
+ * called before the event loop is set up.
+ *
+ * - `@return` - `0` on success (or if there is no zygote to fork),
+ *     `-1` if the zygote couldn't be started.
+ */
+int msh_zygote_init(void);
+
+/**
+ * `msh_zygote_listen` adds the zygote's socket to the event loop, so
+ * that the statuses of the commands update their jobs.
+ *
+ * - `@return` - `0` on success, `-1` on failure.
+ */
+int msh_zygote_listen(void);
+
+/**
+ * `msh_zygote_spawn` has the zygote fork and execute a command.
+ *
+ * - `@args` - the `NULL`-terminated arguments, the program first.
+ * - `@assignments` - the `NULL`-terminated `NAME=value` assignments
+ *     for the command's environment, or `NULL`.
+ * - `@pgid` - the process group of the command's job, `0` for a new
+ *     one led by the command.
+ * - `@foreground` - `1` if the job gets the terminal.
+ * - `@fds` - the descriptors to use as the command's standard input,
+ *     output and error. They stay open in the shell.
+ * - `@return` - the pid of the command, or `-1` if the zygote couldn't
+ *     run it (it must then be forked by the shell).
+ */
+pid_t msh_zygote_spawn(char **args, char **assignments, pid_t pgid, int foreground, int fds[3]);
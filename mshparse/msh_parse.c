@@ -1,35 +1,179 @@
 #include <msh_parse.h>
+#include <msh_parse_internal.h>
 #include <stdbool.h>
 #include <stdlib.h>
-#include <stdio.h>
 #include <string.h>
 
-//define msh's structs
-struct msh_command{
-	char* comm_arguments[MSH_MAXARGS + 2]; //plus 1 for the command/program itself plus 1 for NULL termination
-	bool command_last; //boolean flag for last command
-	int comm_args_count; //how many arguments in a command so far
-	char* command; 
-};
-
-//a pipeline is a set of commands
-//a struct array of msh_commands
-//of length MSH_MAXCMNDS
-struct msh_pipeline{
-	struct msh_command * pipeline_commands[MSH_MAXCMNDS];
-	char * pipe; 
-	int background_pipe;
-	int pipeline_comm_count;//how many commands in a pipe so far
-};
-
-//a sequence is a set of pipelines
-//1 foreground pipeline and a maximum
-//of MSH_MAXBACKGROUND amount of background pipelines
-struct msh_sequence{
-	struct msh_pipeline * sequence_pipelines[MSH_MAXBACKGROUND + 1];
-	int cur;
-	int seq_pipeline_count;//how many pipelines are in sequence so far
-};
+//record where parsing the input of a sequence failed, and why
+static msh_err_t
+parse_error(struct msh_sequence *s, msh_err_t err, size_t pos)
+{
+	s->err = err;
+	s->err_pos = pos;
+	return err;
+}
+
+//free the passed in command
+void
+msh_command_free(struct msh_command *c)
+{
+	free(c->command); //free the command pointer
+
+	int j;
+	for(j = 0; c->comm_arguments != NULL && j < c->comm_args_cap; j++)
+	{
+		if(c->comm_arguments[j] != NULL)
+		{
+			free(c->comm_arguments[j]); //free arguments
+		}
+	}
+	free(c->comm_arguments);
+	for(j = 0; c->comm_env != NULL && c->comm_env[j] != NULL; j++) free(c->comm_env[j]);
+	free(c->comm_env);
+	free(c); //free the command
+}
+
+//grow the argument array of the passed in command to n slots
+int
+msh_command_args_reserve(struct msh_command *c, int n)
+{
+	int cap = c->comm_args_cap;
+	char ** grown;
+
+	if(n <= cap) return 0;
+	while(cap < n) cap *= 2;
+
+	grown = realloc(c->comm_arguments, cap * sizeof(char *));
+	if(grown == NULL) return -1;
+	memset(grown + c->comm_args_cap, 0, (cap - c->comm_args_cap) * sizeof(char *));
+	c->comm_arguments = grown;
+	c->comm_args_cap = cap;
+
+	return 0;
+}
+
+//the separators inside a $(...) are swapped for these while the input is split,
+//so that the substitution stays one word
+static const char subst_separators[] = " |;&";
+static const char subst_protected[] = "\x01\x02\x03\x04";
+
+//swap the separators inside the $(...)s of the passed in string
+static void
+subst_protect(char *str)
+{
+	int depth = 0;
+
+	for(; *str != '\0'; str++)
+	{
+		char * sep;
+
+		if(str[0] == '$' && str[1] == '(')
+		{
+			depth++;
+			str++;
+		}
+		else if(depth > 0 && *str == '(') depth++;
+		else if(depth > 0 && *str == ')') depth--;
+		else if(depth > 0 && (sep = strchr(subst_separators, *str)) != NULL) *str = subst_protected[sep - subst_separators];
+	}
+}
+
+//swap the separators of the passed in string back
+static char *
+subst_restore(char *str)
+{
+	for(char * c = str; c != NULL && *c != '\0'; c++)
+	{
+		char * sep = strchr(subst_protected, *c);
+
+		if(sep != NULL) *c = subst_separators[sep - subst_protected];
+	}
+	return str;
+}
+
+//add a word as the nth argument of the passed in command
+static int
+command_arg_add(struct msh_command *c, int nth, const char *word)
+{
+	if(msh_command_args_reserve(c, nth + 2) == -1) return -1;
+
+	if(nth == 0)
+	{
+		c->command = subst_restore(strdup(word));
+		if(c->command == NULL) return -1;
+	}
+	c->comm_arguments[nth] = subst_restore(strdup(word));
+	if(c->comm_arguments[nth] == NULL) return -1;
+	c->comm_args_count++;
+
+	return 0;
+}
+
+//replace the words with a $ of the passed in command by what they expand to, split on whitespace
+static int
+command_expand(struct msh_command *c, msh_expand_fn_t fn, void *data)
+{
+	for(int j = 0; c->comm_arguments[j] != NULL; j++)
+	{
+		char * expanded, * word, * word_ptr;
+		char ** words = NULL;
+		int count = 0, args = 0;
+
+		if(strchr(c->comm_arguments[j], '$') == NULL) continue;
+		expanded = fn(c->comm_arguments[j], data);
+		if(expanded == NULL) return -1;
+
+		for(word = strtok_r(expanded, " \t\n", &word_ptr); word != NULL; word = strtok_r(NULL, " \t\n", &word_ptr))
+		{
+			char ** grown = realloc(words, (count + 1) * sizeof(char *));
+
+			if(grown == NULL || (grown[count] = strdup(word)) == NULL)
+			{
+				words = grown != NULL ? grown : words;
+				while(count > 0) free(words[--count]);
+				free(words);
+				free(expanded);
+				return -1;
+			}
+			words = grown;
+			count++;
+		}
+		free(expanded);
+
+		//the words take the place of the one expanded, which can be replaced by none
+		while(c->comm_arguments[args] != NULL) args++;
+		if(msh_command_args_reserve(c, args + count) == -1)
+		{
+			while(count > 0) free(words[--count]);
+			free(words);
+			return -1;
+		}
+		free(c->comm_arguments[j]);
+		memmove(&c->comm_arguments[j + count], &c->comm_arguments[j + 1], (args - j) * sizeof(char *));
+		if(count > 0) memcpy(&c->comm_arguments[j], words, count * sizeof(char *));
+		free(words);
+		c->comm_args_count += count - 1;
+		j += count - 1;
+	}
+
+	//a command expanding to nothing is an empty program
+	if(c->comm_arguments[0] == NULL)
+	{
+		c->comm_arguments[0] = strdup("");
+		if(c->comm_arguments[0] == NULL) return -1;
+		c->comm_args_count++;
+	}
+	if(strcmp(c->command, c->comm_arguments[0]) != 0)
+	{
+		char * command = strdup(c->comm_arguments[0]);
+
+		if(command == NULL) return -1;
+		free(c->command);
+		c->command = command;
+	}
+
+	return 0;
+}
 
 //free the passed in pipeline
 void
@@ -42,17 +186,7 @@ msh_pipeline_free(struct msh_pipeline *p)
 	{
 		if(p->pipeline_commands[i] != NULL)
 		{			
-			free(p->pipeline_commands[i]->command); //free the command pointer
-			
-			int j;
-			for(j = 0; j < (MSH_MAXARGS + 1); j++)
-			{
-				if(p->pipeline_commands[i]->comm_arguments[j] != NULL)
-				{
-					free(p->pipeline_commands[i]->comm_arguments[j]); //free arguments
-				}
-			}
-			free(p->pipeline_commands[i]); //free the command
+			msh_command_free(p->pipeline_commands[i]);
 		}
 	}
 
@@ -88,11 +222,7 @@ msh_sequence_alloc(void)
 	struct msh_sequence * s = calloc(1, sizeof(struct msh_sequence));
 
 	//calloc() fails in allocating memory for the sequence
-	if(s == NULL)
-	{
-		printf("msh_sequence_alloc: calloc() failure\n");
-		return NULL;
-	}
+	if(s == NULL) return NULL;
 
 	//initialize cur and pipeline count
 	s->cur = 0;
@@ -101,6 +231,125 @@ msh_sequence_alloc(void)
 	return s;
 }
 
+//copy a NULL terminated array of strings into n slots
+static char **
+strings_copy(char **strs, int n)
+{
+	char ** copy = calloc(n, sizeof(char *));
+
+	for(int i = 0; copy != NULL && strs[i] != NULL; i++)
+	{
+		copy[i] = strdup(strs[i]);
+		if(copy[i] == NULL)
+		{
+			while(i > 0) free(copy[--i]);
+			free(copy);
+			return NULL;
+		}
+	}
+	return copy;
+}
+
+//copy the passed in pipeline, returns NULL on allocation failure
+static struct msh_pipeline *
+pipeline_copy(struct msh_pipeline *p)
+{
+	struct msh_pipeline * copy = calloc(1, sizeof(struct msh_pipeline));
+
+	if(copy == NULL) return NULL;
+	copy->background_pipe = p->background_pipe;
+	copy->pipe_pos = p->pipe_pos;
+	copy->pipeline_comm_count = p->pipeline_comm_count;
+	copy->pipe = strdup(p->pipe);
+	if(copy->pipe == NULL) goto fail;
+
+	for(int i = 0; i < MSH_MAXCMNDS && p->pipeline_commands[i] != NULL; i++)
+	{
+		struct msh_command * c = p->pipeline_commands[i], * d = calloc(1, sizeof(struct msh_command));
+
+		if(d == NULL) goto fail;
+		copy->pipeline_commands[i] = d;
+		d->comm_args_cap = c->comm_args_cap;
+		d->command_last = c->command_last;
+		d->comm_args_count = c->comm_args_count;
+		d->command = strdup(c->command);
+		d->comm_arguments = strings_copy(c->comm_arguments, c->comm_args_cap);
+		if(d->command == NULL || d->comm_arguments == NULL) goto fail;
+		if(c->comm_env != NULL)
+		{
+			int n = 0;
+
+			while(c->comm_env[n] != NULL) n++;
+			d->comm_env = strings_copy(c->comm_env, n + 1);
+			if(d->comm_env == NULL) goto fail;
+		}
+	}
+	return copy;
+fail:
+	msh_pipeline_free(copy);
+	return NULL;
+}
+
+//copy the pipelines of the sequence that are still queued
+struct msh_sequence *
+msh_sequence_copy(struct msh_sequence *s)
+{
+	struct msh_sequence * copy = msh_sequence_alloc();
+
+	if(copy == NULL) return NULL;
+	copy->expand = s->expand;
+	copy->expand_data = s->expand_data;
+	for(int i = s->cur; i < s->seq_pipeline_count; i++)
+	{
+		if(s->sequence_pipelines[i] == NULL) continue;
+		copy->sequence_pipelines[copy->seq_pipeline_count] = pipeline_copy(s->sequence_pipelines[i]);
+		if(copy->sequence_pipelines[copy->seq_pipeline_count] == NULL)
+		{
+			msh_sequence_free(copy);
+			return NULL;
+		}
+		copy->seq_pipeline_count++;
+	}
+
+	return copy;
+}
+
+//queue a pipeline built by the caller
+msh_err_t
+msh_sequence_append(struct msh_sequence *s, struct msh_pipeline *p)
+{
+	int queued = 0;
+
+	for(int i = s->cur; i < s->seq_pipeline_count; i++) queued += s->sequence_pipelines[i] != NULL;
+	if(queued == 0)
+	{
+		s->cur = 0;
+		s->seq_pipeline_count = 0;
+		s->err = 0;
+		s->err_pos = 0;
+	}
+	if(s->seq_pipeline_count == MSH_MAXBACKGROUND + 1) return MSH_ERR_TOO_MANY_PIPELINES;
+	s->sequence_pipelines[s->seq_pipeline_count++] = p;
+
+	return 0;
+}
+
+//set the function expanding the words of the sequence's commands
+void
+msh_sequence_expander(struct msh_sequence *s, msh_expand_fn_t fn, void *data)
+{
+	s->expand = fn;
+	s->expand_data = data;
+}
+
+//the last error of the sequence, and where it was in the input
+msh_err_t
+msh_sequence_error(struct msh_sequence *s, size_t *pos)
+{
+	if(pos != NULL) *pos = s->err_pos;
+	return s->err;
+}
+
 //return the passed in pipeline's input
 //that was used to make that pipeline in the first place
 char *
@@ -110,205 +359,148 @@ msh_pipeline_input(struct msh_pipeline *p)
 }
 
 //takes a string that has pipelines and commands
-//and puts them into the given sequence  
+//and puts them into the given sequence, whole or not at all
 msh_err_t
 msh_sequence_parse(char *str, struct msh_sequence *seq)
 {
 	int index = 0; //current position in sequence, which is an array of struct pipelines
-	char *token, *ptr; 
-	char *str_copy = malloc(strlen(str) + 1);
+	char *token, *ptr;
+	char *str_copy, *token_copy = NULL, *tok_copy = NULL;
+	msh_err_t err = 0;
+	size_t pos = 0;
 
-	//malloc() failure
-	if(str_copy == NULL)
+	seq->err = 0;
+	seq->err_pos = 0;
+
+	//pipelines of the previous input haven't all been dequeued yet
+	for(int i = seq->cur; i < seq->seq_pipeline_count; i++)
 	{
-		printf("MSH Error: %s\n", msh_pipeline_err2str(-5));
-		return -5;
+		if(seq->sequence_pipelines[i] != NULL) return parse_error(seq, MSH_ERR_SEQ_BUSY, 0);
 	}
+	//otherwise, the queue starts over for this input
+	seq->cur = 0;
+	seq->seq_pipeline_count = 0;
+
+	str_copy = strdup(str);
+	if(str_copy == NULL) return parse_error(seq, MSH_ERR_NOMEM, 0);
+	subst_protect(str_copy);
 
-	strcpy(str_copy, str);
 	for(token = strtok_r(str_copy, ";", &ptr); token != NULL; token = strtok_r(NULL, ";", &ptr))
 	{
-		//error checking for pipelines
-		int error = 0;
-		int i;
-		for (i = 0; i < (int)strlen(token); i++)
-		{
-			if(token[i] == '|' && error == 0)
-			{
-				free(str_copy);
-				printf("MSH Error: %s\n", msh_pipeline_err2str(-8));
-				return -8;
-			}
+		struct msh_pipeline * p;
+		char * amp = strchr(token, '&');
+		char *tok, *tok_ptr;
+		int command_counter = 0; //counter for number of commands
 
-			else if(token[i] != ' ')
-			{
-				error = 1;
-			}
-		}
+		pos = token - str_copy;
 
-		if(token[strlen(token) - 1] == '|')
+		//a | without a command before or after it
+		if(token[strspn(token, " ")] == '|' || token[strlen(token) - 1] == '|')
 		{
-			free(str_copy);
-			printf("MSH Error: %s\n", msh_pipeline_err2str(-8));
-			return -8;
+			err = MSH_ERR_PIPE_MISSING_CMD;
+			goto fail;
 		}
-		
-		//allocate pipelines
-		seq->sequence_pipelines[index] = calloc(1, sizeof(struct msh_pipeline));
-
-		//calloc() failure
-		if(seq->sequence_pipelines[index] == NULL)
+		//cannot have more arguments after &
+		if(amp != NULL && amp[1] != '\0')
 		{
-			free(str_copy);
-			printf("MSH Error: %s\n", msh_pipeline_err2str(-5));
-			return -5;
+			pos += amp - token;
+			err = MSH_ERR_MISUSED_BACKGROUND;
+			goto fail;
 		}
-		seq->sequence_pipelines[index]->pipe = strdup(token); //put token into sequence
-
-		//check whether to run the pipeline in the background
-		for(size_t i = 0; i < strlen(token); i++)
+		if(index == MSH_MAXBACKGROUND + 1)
 		{
-			int and_counter = 0;
-			if(token[i] == '&')
-			{
-				and_counter++;
-
-				//cannot have more arguments after &
-				if((token[i + 1] != '\0'))
-				{
-					printf("%s\n", msh_pipeline_err2str(-3));
-					return -3;
-				}
-			}
-
-			if(and_counter > 1)
-			{
-				printf("%s\n", msh_pipeline_err2str(-3));
-				return -3;
-			}
-			
-			if(and_counter == 0) seq->sequence_pipelines[index]->background_pipe = 0;
-			else seq->sequence_pipelines[index]->background_pipe = 1;
+			err = MSH_ERR_TOO_MANY_PIPELINES;
+			goto fail;
 		}
 
-		seq->sequence_pipelines[index]->pipeline_comm_count = 1;
-
-		int command_counter = 0; //counter for number of commands
-		char * token_copy = malloc(strlen(token) + 1);
-
-		//malloc() failure
-		if(token_copy == NULL)
+		//allocate pipelines
+		p = calloc(1, sizeof(struct msh_pipeline));
+		if(p == NULL) goto nomem;
+		seq->sequence_pipelines[index++] = p;
+		p->pipe = subst_restore(strdup(token)); //put token into sequence
+		if(p->pipe == NULL) goto nomem;
+		p->pipe_pos = pos;
+		p->background_pipe = amp != NULL; //run the pipeline in the background
+		p->pipeline_comm_count = 1;
+
+		token_copy = strdup(token);
+		if(token_copy == NULL) goto nomem;
+
+		for(tok = strtok_r(token_copy, "|", &tok_ptr); tok != NULL; tok = strtok_r(NULL, "|", &tok_ptr))
 		{
-			free(str_copy);
-			printf("MSH Error: %s\n", msh_pipeline_err2str(-5));
-			return -5;
-		}
-		strcpy(token_copy, token);
+			struct msh_command * c;
+			char *word, *word_ptr;
+			int arguments_counter = 0; //counter for number of arguments
 
-		char *tok, *tok_ptr;
-		for(tok = strtok_r(token_copy, "|", &tok_ptr); tok != NULL; tok = strtok_r(tok_ptr, "|", &tok_ptr))
-		{
-			//error checking related to commands
-			int err = 0;
-			int i;
-			for(i = 0; i < (int) strlen(tok); i++)
-			{
-				if(tok[i] != ' ')
-				{
-					err = 1;
-				}
-			}
+			pos = token - str_copy + (tok - token_copy);
 
-			if(err == 0)
+			//error checking related to commands
+			if(tok[strspn(tok, " ")] == '\0')
 			{
-				seq->seq_pipeline_count++;
-				free(str_copy);
-				free(token_copy);
-				printf("MSH Error: %s\n", msh_pipeline_err2str(-8));
-				return -8;
+				err = MSH_ERR_PIPE_MISSING_CMD;
+				goto fail;
 			}
-
-			if(seq->sequence_pipelines[index]->pipeline_comm_count > MSH_MAXCMNDS)
+			if(p->pipeline_comm_count > MSH_MAXCMNDS)
 			{
-				seq->seq_pipeline_count++;
-				free(str_copy);
-				free(token_copy);
-				printf("MSH Error: %s\n", msh_pipeline_err2str(-7));
-				return -7;
+				err = MSH_ERR_TOO_MANY_CMDS;
+				goto fail;
 			}
 
 			//allocate commands
-			seq->sequence_pipelines[index]->pipeline_commands[command_counter] = calloc(1, sizeof(struct msh_command));
-
-			//calloc() allocation failure
-			if(seq->sequence_pipelines[index]->pipeline_commands[command_counter] == NULL)
-			{
-				free(str_copy);
-				free(token_copy);
-				printf("MSH Error: %s\n", msh_pipeline_err2str(-5));
-				return -5;
-			}
-
-			seq->sequence_pipelines[index]->pipeline_commands[command_counter]->command_last = false;
-
-			seq->sequence_pipelines[index]->pipeline_commands[command_counter]->comm_args_count = 1;
-
-			int arguments_counter = 0; //counter for number of arguments
-			char *tok_copy = malloc(strlen(tok) + 1);
-
-			//malloc() failure
-			if(tok_copy == NULL)
-			{
-				free(str_copy);
-				free(token_copy);
-				printf("MSH Error: %s\n", msh_pipeline_err2str(-5));
-				return -5;
-			}
-			strcpy(tok_copy, tok);
-
-			char* _token, *_ptr;
-			for(_token = strtok_r(tok_copy, " ", &_ptr); _token != NULL; _token = strtok_r(_ptr, " ", &_ptr))
+			c = calloc(1, sizeof(struct msh_command));
+			if(c == NULL) goto nomem;
+			p->pipeline_commands[command_counter++] = c;
+			c->comm_arguments = calloc(MSH_MAXARGS + 2, sizeof(char *));
+			if(c->comm_arguments == NULL) goto nomem;
+			c->comm_args_cap = MSH_MAXARGS + 2;
+			c->command_last = false;
+			c->comm_args_count = 1;
+
+			tok_copy = strdup(tok);
+			if(tok_copy == NULL) goto nomem;
+			for(word = strtok_r(tok_copy, " ", &word_ptr); word != NULL; word = strtok_r(NULL, " ", &word_ptr))
 			{
 				//error checking related to arguments
-				if(seq->sequence_pipelines[index]->pipeline_commands[command_counter]->comm_args_count > (MSH_MAXARGS + 1))
+				if(c->comm_args_count > MSH_MAXARGS + 1)
 				{
-					seq->seq_pipeline_count++;
-					free(str_copy);
-					free(token_copy);
-					free(tok_copy);
-					printf("MSH Error: %s\n", msh_pipeline_err2str(-6));
-					return -6;
+					pos += word - tok_copy;
+					err = MSH_ERR_TOO_MANY_ARGS;
+					goto fail;
 				}
 
-				//allocate arguments
-				if(arguments_counter == 0)
-				{
-					seq->sequence_pipelines[index]->pipeline_commands[command_counter]->command = strdup(_token);
-				}
-
-				seq->sequence_pipelines[index]->pipeline_commands[command_counter]->comm_arguments[arguments_counter] = strdup(_token);
-
-				seq->sequence_pipelines[index]->pipeline_commands[command_counter]->comm_args_count++;
-
+				//allocate arguments, the array stays NULL terminated
+				if(command_arg_add(c, arguments_counter, word) == -1) goto nomem;
 				arguments_counter++;
 			}
-			seq->sequence_pipelines[index]->pipeline_comm_count++;
-
-			//null terminate the comm_arguments array
-			seq->sequence_pipelines[index]->pipeline_commands[command_counter]->comm_arguments[arguments_counter] = NULL;
-
-			command_counter++;
 			free(tok_copy);
+			tok_copy = NULL;
+			p->pipeline_comm_count++;
 		}
 		//set boolean to true for final command
-		seq->sequence_pipelines[index]->pipeline_commands[command_counter - 1]->command_last = true;
+		p->pipeline_commands[command_counter - 1]->command_last = true;
 
-		index++;
 		seq->seq_pipeline_count++;
 		free(token_copy);
+		token_copy = NULL;
 	}
 	free(str_copy);
 	return 0; //success
+
+nomem:
+	err = MSH_ERR_NOMEM;
+fail:
+	//none of the input's pipelines are queued
+	for(int i = 0; i < index; i++)
+	{
+		msh_pipeline_free(seq->sequence_pipelines[i]);
+		seq->sequence_pipelines[i] = NULL;
+	}
+	seq->seq_pipeline_count = 0;
+	free(str_copy);
+	free(token_copy);
+	free(tok_copy);
+
+	return parse_error(seq, err, pos);
 }
 
 //dequeues the first pipeline in sequence
@@ -316,31 +508,36 @@ msh_sequence_parse(char *str, struct msh_sequence *seq)
 struct msh_pipeline *
 msh_sequence_pipeline(struct msh_sequence *s)
 {
-	//the pipeline is already freed, or was empty beforehand
-	if(s->sequence_pipelines[s->cur] == NULL)
+	struct msh_pipeline *p;
+
+	//the pipelines were all dequeued, or there were none
+	if(s->cur >= s->seq_pipeline_count || s->sequence_pipelines[s->cur] == NULL)
 	{
 		return NULL;
 	}
 
-	//allocate new space
-	struct msh_pipeline *p = malloc(sizeof(struct msh_pipeline));
+	//the caller owns the pipeline from now on
+	p = s->sequence_pipelines[s->cur];
+	s->sequence_pipelines[s->cur] = NULL;
+	s->cur++; //increment index
 
-	//malloc() memory allocation failure
-	if(p == NULL)
+	//words are expanded once the pipelines before have run, e.g. to see the variables they set
+	for(int i = 0; s->expand != NULL && i < MSH_MAXCMNDS && p->pipeline_commands[i] != NULL; i++)
 	{
-		printf("msh_sequence_pipeline: malloc() failure\n");
-		return NULL;
+		if(command_expand(p->pipeline_commands[i], s->expand, s->expand_data) == -1)
+		{
+			//a partly expanded pipeline isn't run, nor the rest of its input
+			parse_error(s, MSH_ERR_NOMEM, p->pipe_pos);
+			msh_pipeline_free(p);
+			for(; s->cur < s->seq_pipeline_count; s->cur++)
+			{
+				msh_pipeline_free(s->sequence_pipelines[s->cur]);
+				s->sequence_pipelines[s->cur] = NULL;
+			}
+			return NULL;
+		}
 	}
 
-	//copy sequence's pipeline to the newly allocated space
-	memcpy(p, s->sequence_pipelines[s->cur], sizeof(struct msh_pipeline));
-
-	free(s->sequence_pipelines[s->cur]); //dequeue pipeline from sequence
-
-	s->sequence_pipelines[s->cur] = NULL; //set the pipeline to NULL
-
-	s->cur++; //increment index
-
 	return p;
 }
 
@@ -6,16 +6,50 @@
  * Parse a string which is a pipeline of commands into a set of
  * commands, along with information about where their standard in,
  * error, and out should be connected.
+ *
+ * The library is reentrant: it has no writable globals, prints
+ * nothing (errors are returned, and kept with their position by the
+ * sequence), and all of its state is in the sequences and pipelines
+ * it returns. Threads can thus parse at the same time into different
+ * sequences. A sequence, and the pipelines still queued in it, must
+ * only be used by one thread at a time; a pipeline that was dequeued
+ * belongs to whoever dequeued it. Its memory comes from `malloc`,
+ * whose per-thread arenas keep threads parsing at once from
+ * contending on a single heap.
  */
 
 #include <msh.h>
 
 /**
  * `msh_sequence_alloc` simply allocates a sequence structure which is
- * effectively a queue.
+ * effectively a queue. It returns `NULL` if it couldn't be allocated.
  */
 struct msh_sequence *msh_sequence_alloc(void);
 
+/**
+ * `msh_expand_fn_t` is a function expanding the `$` references of a
+ * word, e.g. to the values of shell variables.
+ *
+ * - `@word` - the borrowed word, containing a `$`.
+ * - `@data` - the data passed to `msh_sequence_expander`.
+ * - `@return` - the expanded word to `free`, which is split into
+ *     arguments on its whitespace, or `NULL` on allocation failure.
+ */
+typedef char *(*msh_expand_fn_t)(const char *word, void *data);
+
+/**
+ * `msh_sequence_expander` sets the function expanding the words of
+ * the commands parsed into a sequence. Words are expanded as their
+ * pipeline is dequeued with `msh_sequence_pipeline`, so that they
+ * see the effects of the pipelines before them (e.g. `X=1; echo
+ * $X`). Without an expansion function, words are kept as they are.
+ *
+ * - `@s` - the sequence.
+ * - `@fn` - the expansion function, or `NULL`.
+ * - `@data` - passed to `fn` with each word.
+ */
+void msh_sequence_expander(struct msh_sequence *s, msh_expand_fn_t fn, void *data);
+
 /**
  * `msh_sequence_parse` takes the command string, parses it, and
  * inserts pipelines therein into the sequence queue.
@@ -24,10 +58,25 @@ struct msh_sequence *msh_sequence_alloc(void);
  *     borrows this string, thus does not `free` it.
  * - `@s` - the sequence into which you can queue up pipelines.
  * - `@return` - return `0` on success (in which case `result` is
- *     set), or a `msg_err_t` otherwise.
+ *     set), or a `msg_err_t` otherwise. On an error, none of the
+ *     pipelines of `str` are queued, and `msh_sequence_error` tells
+ *     where the error is.
  */
 msh_err_t msh_sequence_parse(char *str, struct msh_sequence *s);
 
+/**
+ * `msh_sequence_error` returns the error of the last call to
+ * `msh_sequence_parse` with the sequence, or of expanding the words
+ * of the last pipeline dequeued.
+ *
+ * - `@s` - the sequence.
+ * - `@pos` - if not `NULL`, set to the offset in the string parsed of
+ *     the pipeline, command or word in error (`0` for errors of no
+ *     particular place, like `MSH_ERR_NOMEM`).
+ * - `@return` - the error, or `0` if there was none.
+ */
+msh_err_t msh_sequence_error(struct msh_sequence *s, size_t *pos);
+
 /**
  * `msh_sequence_free` deallocates the entire sequence, including all
  * constituent pipelines and commands. However, pipelines that have
@@ -38,6 +87,18 @@ msh_err_t msh_sequence_parse(char *str, struct msh_sequence *s);
  */
 void msh_sequence_free(struct msh_sequence *s);
 
+/**
+ * `msh_sequence_copy` copies the pipelines still queued in a
+ * sequence into a new one, along with its expansion function. A
+ * sequence parsed once can thus be run many times (e.g. as the body
+ * of a loop), each copy expanding its words as it is dequeued.
+ *
+ * - `@s` - the borrowed sequence to copy.
+ * - `@return` - the copy, to free with `msh_sequence_free`, or `NULL`
+ *     on allocation failure.
+ */
+struct msh_sequence *msh_sequence_copy(struct msh_sequence *s);
+
 /**
  * `msh_sequence_pipeline` dequeues the first pipeline in the sequence.
  *
@@ -45,7 +106,10 @@ void msh_sequence_free(struct msh_sequence *s);
  * - `@return` - return a pointer to the zero-indexed `nth` command in
  *     the pipeline, or `NULL` if `nth` >= the number of commands in
  *     the pipeline. The caller of this function is passed the
- *     ownership for the pipeline, thus must free the pipeline.
+ *     ownership for the pipeline, thus must free the pipeline. If its
+ *     words couldn't all be expanded, it is freed with the rest of the
+ *     queue, `NULL` is returned, and `msh_sequence_error` returns
+ *     `MSH_ERR_NOMEM` at the pipeline's position.
  */
 struct msh_pipeline *msh_sequence_pipeline(struct msh_sequence *s);
 
@@ -0,0 +1,76 @@
+#pragma once
+
+/***
+ * The definitions of the structures behind `msh_parse.h`. These are
+ * private to the parser and to the parts of the shell that must
+ * inspect or rewrite parsed pipelines (e.g. the executor and the
+ * pipeline optimizer). Everything else uses the `msh_parse.h` API.
+ */
+
+#include <msh_parse.h>
+#include <stdbool.h>
+
+//define msh's structs
+struct msh_command{
+	char** comm_arguments; //NULL terminated, with comm_args_cap slots (unused ones are NULL)
+	int comm_args_cap; //MSH_MAXARGS + 2 when parsed: the program, its arguments and the NULL
+	bool command_last; //boolean flag for last command
+	int comm_args_count; //how many arguments in a command so far
+	char* command; 
+	char** comm_env; //the NAME=value words before the program, NULL terminated, or NULL
+};
+
+//a pipeline is a set of commands
+//a struct array of msh_commands
+//of length MSH_MAXCMNDS
+struct msh_pipeline{
+	struct msh_command * pipeline_commands[MSH_MAXCMNDS];
+	char * pipe; 
+	size_t pipe_pos; //offset of the pipeline in the input parsed
+	int background_pipe;
+	int pipeline_comm_count;//how many commands in a pipe so far
+};
+
+//a sequence is a set of pipelines
+//1 foreground pipeline and a maximum
+//of MSH_MAXBACKGROUND amount of background pipelines
+struct msh_sequence{
+	struct msh_pipeline * sequence_pipelines[MSH_MAXBACKGROUND + 1];
+	int cur;
+	int seq_pipeline_count;//how many pipelines are in sequence so far
+	msh_expand_fn_t expand; //expands the words with a $, if set
+	void * expand_data;
+	msh_err_t err; //of the last parse or expansion, 0 if none
+	size_t err_pos; //offset of the error in the input parsed
+};
+
+/**
+ * `msh_command_free` frees a command that has been taken out of its
+ * pipeline. Commands still in a pipeline are freed with it.
+ */
+void msh_command_free(struct msh_command *c);
+
+/**
+ * `msh_command_args_reserve` makes room for `n` slots in the
+ * command's argument array, e.g. so that a stage rewriting it (glob
+ * expansion, the optimizer) can add arguments past `MSH_MAXARGS`.
+ *
+ * - `@c` - the command.
+ * - `@n` - the number of slots needed, including the `NULL`.
+ * - `@return` - `0` on success, `-1` if the array couldn't grow (it
+ *     is then unchanged).
+ */
+int msh_command_args_reserve(struct msh_command *c, int n);
+
+/**
+ * `msh_sequence_append` queues a pipeline that was built rather than
+ * parsed (e.g. loaded from a compiled script) at the end of a
+ * sequence. Like with `msh_sequence_parse`, the queue starts over
+ * once all its pipelines were dequeued.
+ *
+ * - `@s` - the sequence.
+ * - `@p` - the pipeline, whose ownership is passed to the sequence.
+ * - `@return` - `0` on success, `MSH_ERR_TOO_MANY_PIPELINES` if the
+ *     sequence is full (`p` is then still the caller's).
+ */
+msh_err_t msh_sequence_append(struct msh_sequence *s, struct msh_pipeline *p);
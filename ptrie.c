@@ -0,0 +1,363 @@
+#include <ptrie.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include <limits.h>
+
+#define PTRIE_CHUNK (64 * 1024)
+
+//a node holds the run of characters leading to it from its parent
+struct ptrie_node {
+	const char * label; //in the arena, not NUL-terminated
+	size_t len;
+	int count; //how many times the string ending here was added, 0 if none does
+	int best; //the highest count in the subtree, 0 if it holds no string
+	struct ptrie_node * child; //the children, sorted by their first character
+	struct ptrie_node * sibling;
+};
+
+//the arena the nodes and labels are allocated from
+struct ptrie_chunk {
+	struct ptrie_chunk * next;
+	size_t used;
+	size_t cap;
+	alignas(struct ptrie_node) char mem[];
+};
+
+struct ptrie {
+	struct ptrie_node root; //with an empty label
+	struct ptrie_chunk * chunks;
+};
+
+//a growable string
+struct ptrie_buf {
+	char * s;
+	size_t len;
+	size_t cap;
+};
+
+//Helper functions:
+
+static void *
+arena_alloc(struct ptrie *pt, size_t size, size_t align)
+{
+	struct ptrie_chunk * c = pt->chunks;
+	size_t off = 0;
+
+	if(c != NULL) off = (c->used + align - 1) & ~(align - 1);
+	if(c == NULL || off + size > c->cap)
+	{
+		size_t cap = size > PTRIE_CHUNK ? size : PTRIE_CHUNK;
+
+		c = malloc(sizeof(struct ptrie_chunk) + cap);
+		if(c == NULL) return NULL;
+		c->cap = cap;
+		c->next = pt->chunks;
+		pt->chunks = c;
+		off = 0;
+	}
+	c->used = off + size;
+
+	return c->mem + off;
+}
+
+static struct ptrie_node *
+node_new(struct ptrie *pt, const char *label, size_t len)
+{
+	struct ptrie_node * n = arena_alloc(pt, sizeof(struct ptrie_node), alignof(struct ptrie_node));
+	char * copy = arena_alloc(pt, len, 1);
+
+	if(n == NULL || copy == NULL) return NULL;
+	memcpy(copy, label, len);
+	*n = (struct ptrie_node) { .label = copy, .len = len };
+
+	return n;
+}
+
+static void
+node_best(struct ptrie_node *n)
+{
+	n->best = n->count;
+	for(struct ptrie_node * c = n->child; c != NULL; c = c->sibling)
+	{
+		if(c->best > n->best) n->best = c->best;
+	}
+}
+
+//how many characters of the label of n are a prefix of s
+static size_t
+node_match(struct ptrie_node *n, const char *s)
+{
+	size_t k = 0;
+
+	while(k < n->len && s[k] == n->label[k]) k++;
+	return k;
+}
+
+static struct ptrie_node *
+node_child(struct ptrie_node *n, char first)
+{
+	struct ptrie_node * c = n->child;
+
+	while(c != NULL && (unsigned char)c->label[0] < (unsigned char)first) c = c->sibling;
+	if(c == NULL || c->label[0] != first) return NULL;
+	return c;
+}
+
+//sets the count of s below n, whose label was already matched, to count
+//(PTRIE_INCREMENT adds one to it). Returns -1 if we ran out of memory,
+//otherwise 1 if s was in the trie, 0 if not
+#define PTRIE_INCREMENT -1
+static int
+node_update(struct ptrie *pt, struct ptrie_node *n, const char *s, int count)
+{
+	int ret;
+
+	if(*s == '\0')
+	{
+		ret = n->count > 0;
+		n->count = count == PTRIE_INCREMENT ? n->count + 1 : count;
+	}
+	else
+	{
+		struct ptrie_node ** link = &n->child;
+		struct ptrie_node * c;
+		size_t k;
+
+		while(*link != NULL && (unsigned char)(*link)->label[0] < (unsigned char)*s) link = &(*link)->sibling;
+		c = *link;
+		k = (c != NULL && c->label[0] == *s) ? node_match(c, s) : 0;
+
+		if(count == 0 && (k == 0 || k < c->len)) return 0; //nothing to remove
+		if(k == 0)
+		{
+			//nothing shares a first character with s: a new leaf
+			c = node_new(pt, s, strlen(s));
+			if(c == NULL) return -1;
+			c->count = c->best = count == PTRIE_INCREMENT ? 1 : count;
+			c->sibling = *link;
+			*link = c;
+			ret = 0;
+		}
+		else
+		{
+			if(k < c->len)
+			{
+				//s branches off in the middle of the label: split it
+				struct ptrie_node * rest = arena_alloc(pt, sizeof(struct ptrie_node), alignof(struct ptrie_node));
+
+				if(rest == NULL) return -1;
+				*rest = *c;
+				rest->label += k;
+				rest->len -= k;
+				rest->sibling = NULL;
+				c->len = k;
+				c->count = 0;
+				c->child = rest;
+			}
+			ret = node_update(pt, c, s + k, count);
+		}
+	}
+	node_best(n);
+
+	return ret;
+}
+
+//the node under which the strings starting with s are, and how many
+//characters of its label s matched
+static struct ptrie_node *
+node_find(struct ptrie *pt, const char *s, size_t *matched)
+{
+	struct ptrie_node * n = &pt->root;
+
+	*matched = 0;
+	while(*s != '\0')
+	{
+		size_t k;
+
+		n = node_child(n, *s);
+		if(n == NULL) return NULL;
+		k = node_match(n, s);
+		if(s[k] == '\0')
+		{
+			*matched = k;
+			return n;
+		}
+		if(k < n->len) return NULL;
+		s += k;
+	}
+	*matched = n->len;
+
+	return n;
+}
+
+static int
+buf_append(struct ptrie_buf *b, const char *s, size_t len)
+{
+	if(b->len + len + 1 > b->cap)
+	{
+		size_t cap = b->cap == 0 ? 64 : b->cap;
+		char * grown;
+
+		while(b->len + len + 1 > cap) cap *= 2;
+		grown = realloc(b->s, cap);
+		if(grown == NULL) return -1;
+		b->s = grown;
+		b->cap = cap;
+	}
+	memcpy(b->s + b->len, s, len);
+	b->len += len;
+	b->s[b->len] = '\0';
+
+	return 0;
+}
+
+struct foreach_state {
+	struct ptrie_buf buf;
+	int left;
+	ptrie_foreach_fn_t fn;
+	void * data;
+};
+
+static void
+node_foreach(struct ptrie_node *n, struct foreach_state *st)
+{
+	if(n->best == 0 || st->left == 0) return;
+	if(n->count > 0)
+	{
+		st->fn(st->buf.s, n->count, st->data);
+		st->left--;
+	}
+
+	for(struct ptrie_node * c = n->child; c != NULL && st->left > 0; c = c->sibling)
+	{
+		size_t len = st->buf.len;
+
+		if(buf_append(&st->buf, c->label, c->len) == -1)
+		{
+			st->left = 0;
+			break;
+		}
+		node_foreach(c, st);
+		st->buf.len = len;
+		st->buf.s[len] = '\0';
+	}
+}
+
+static void
+print_one(const char *str, int count, void *data)
+{
+	(void) data;
+	printf("%s %d\n", str, count);
+}
+//end of helper functions
+
+struct ptrie *
+ptrie_allocate(void)
+{
+	struct ptrie * pt = calloc(1, sizeof(struct ptrie));
+
+	if(pt == NULL) return NULL;
+	pt->root.label = "";
+
+	return pt;
+}
+
+void
+ptrie_free(struct ptrie *pt)
+{
+	if(pt == NULL) return;
+	while(pt->chunks != NULL)
+	{
+		struct ptrie_chunk * c = pt->chunks;
+
+		pt->chunks = c->next;
+		free(c);
+	}
+	free(pt);
+}
+
+int
+ptrie_add(struct ptrie *pt, const char *str)
+{
+	return node_update(pt, &pt->root, str, PTRIE_INCREMENT) == -1 ? -1 : 0;
+}
+
+int
+ptrie_remove(struct ptrie *pt, const char *str)
+{
+	//nodes aren't freed: they go back to the arena with the trie
+	return node_update(pt, &pt->root, str, 0) == 1;
+}
+
+int
+ptrie_set(struct ptrie *pt, const char *str, int count)
+{
+	if(count < 0) return -1;
+	return node_update(pt, &pt->root, str, count) == -1 ? -1 : 0;
+}
+
+int
+ptrie_count(struct ptrie *pt, const char *str)
+{
+	size_t matched;
+	struct ptrie_node * n = node_find(pt, str, &matched);
+
+	if(n == NULL || matched < n->len) return 0;
+	return n->count;
+}
+
+char *
+ptrie_autocomplete(struct ptrie *pt, const char *str)
+{
+	struct ptrie_buf b = { 0 };
+	size_t matched;
+	struct ptrie_node * n = node_find(pt, str, &matched);
+
+	if(n == NULL || n->best == 0) return strdup(str);
+
+	if(buf_append(&b, str, strlen(str)) == -1 || buf_append(&b, n->label + matched, n->len - matched) == -1)
+	{
+		free(b.s);
+		return NULL;
+	}
+	//follow the best count down, stopping at the shortest string having it
+	while(n->count < n->best)
+	{
+		struct ptrie_node * c = n->child;
+
+		while(c->best != n->best) c = c->sibling;
+		if(buf_append(&b, c->label, c->len) == -1)
+		{
+			free(b.s);
+			return NULL;
+		}
+		n = c;
+	}
+
+	return b.s;
+}
+
+int
+ptrie_foreach(struct ptrie *pt, const char *prefix, int max, ptrie_foreach_fn_t fn, void *data)
+{
+	struct foreach_state st = { .left = max, .fn = fn, .data = data };
+	size_t matched;
+	struct ptrie_node * n = node_find(pt, prefix, &matched);
+
+	if(n == NULL || max <= 0) return 0;
+	if(buf_append(&st.buf, prefix, strlen(prefix)) == 0 && buf_append(&st.buf, n->label + matched, n->len - matched) == 0)
+	{
+		node_foreach(n, &st);
+	}
+	free(st.buf.s);
+
+	return max - st.left;
+}
+
+void
+ptrie_print(struct ptrie *pt)
+{
+	ptrie_foreach(pt, "", INT_MAX, print_one, NULL);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stddef.h>
+
+/***
+ * A prefix trie of strings, used for autocompletion. Each string has
+ * a count of how many times it was added, and `ptrie_autocomplete`
+ * completes a prefix to the string with the highest count.
+ *
+ * The trie is path-compressed: a node holds a whole run of
+ * characters that no other string branches off of, so a lookup
+ * compares characters with `memcmp`-like runs rather than hopping a
+ * node per character. Nodes and their characters are carved out of
+ * large arena chunks, and are all freed at once by `ptrie_free`.
+ *
+ * A trie is not synchronized: callers sharing one between threads
+ * must lock around it.
+ */
+
+struct ptrie;
+
+/**
+ * `ptrie_allocate` allocates an empty trie.
+ *
+ * - `@return` - the trie, or `NULL` on failure.
+ */
+struct ptrie *ptrie_allocate(void);
+
+/**
+ * `ptrie_free` frees the trie, and all of the strings in it.
+ */
+void ptrie_free(struct ptrie *pt);
+
+/**
+ * `ptrie_add` adds a string to the trie, or increments its count if
+ * it is already in it.
+ *
+ * - `@pt` - the trie.
+ * - `@str` - the borrowed string, copied into the trie.
+ * - `@return` - `0` on success, `-1` if memory couldn't be allocated.
+ */
+int ptrie_add(struct ptrie *pt, const char *str);
+
+/**
+ * `ptrie_remove` removes a string from the trie, whatever its count.
+ *
+ * - `@return` - `1` if the string was in the trie, `0` otherwise.
+ */
+int ptrie_remove(struct ptrie *pt, const char *str);
+
+/**
+ * `ptrie_set` sets the count of a string, adding it to the trie if
+ * needed. A count of `0` removes it. Counts needn't be counts: any
+ * weight the strings are ranked by for `ptrie_autocomplete` will do.
+ *
+ * - `@pt` - the trie.
+ * - `@str` - the borrowed string, copied into the trie.
+ * - `@count` - the count, `>= 0`.
+ * - `@return` - `0` on success, `-1` on failure.
+ */
+int ptrie_set(struct ptrie *pt, const char *str, int count);
+
+/**
+ * `ptrie_count` returns how many times a string was added to the
+ * trie, `0` if it isn't in it.
+ */
+int ptrie_count(struct ptrie *pt, const char *str);
+
+/**
+ * `ptrie_autocomplete` completes a prefix to the string with the
+ * highest count in the trie. Ties go to the shortest string, then to
+ * the first one in `strcmp` order.
+ *
+ * - `@pt` - the trie.
+ * - `@str` - the borrowed prefix.
+ * - `@return` - the completed string, to be `free`d, which is a copy
+ *     of `str` if no string starts with it (or `NULL` on allocation
+ *     failure).
+ */
+char *ptrie_autocomplete(struct ptrie *pt, const char *str);
+
+/**
+ * `ptrie_foreach` calls `fn` for the strings starting with `prefix`,
+ * in `strcmp` order.
+ *
+ * - `@pt` - the trie.
+ * - `@prefix` - the borrowed prefix, `""` for every string.
+ * - `@max` - the maximum number of strings to call `fn` for.
+ * - `@fn` - called with each string (borrowed for the duration of the
+ *     call), its count, and `data`.
+ * - `@return` - the number of strings `fn` was called for.
+ */
+typedef void (*ptrie_foreach_fn_t)(const char *str, int count, void *data);
+int ptrie_foreach(struct ptrie *pt, const char *prefix, int max, ptrie_foreach_fn_t fn, void *data);
+
+/**
+ * `ptrie_print` prints every string in the trie, with its count, to
+ * the standard output. Useful to debug.
+ */
+void ptrie_print(struct ptrie *pt);
@@ -99,12 +99,49 @@ seq_pline(void)
 	return SUNIT_SUCCESS;
 }
 
+sunit_ret_t
+seq_reuse(void)
+{
+	struct msh_sequence *s;
+	struct msh_pipeline *p;
+	msh_err_t ret;
+
+	s = msh_sequence_alloc();
+	SUNIT_ASSERT("sequence allocation", s != NULL);
+	ret = msh_sequence_parse("hello ; world", s);
+	SUNIT_ASSERT("first input parsed", ret == 0);
+	p = msh_sequence_pipeline(s);
+	SUNIT_ASSERT("hello pipeline", p != NULL);
+	msh_pipeline_free(p);
+
+	ret = msh_sequence_parse("again", s);
+	SUNIT_ASSERT("parse with a queued pipeline is busy", ret == MSH_ERR_SEQ_BUSY);
+
+	p = msh_sequence_pipeline(s);
+	SUNIT_ASSERT("world pipeline", p != NULL);
+	msh_pipeline_free(p);
+	SUNIT_ASSERT("sequence is empty", msh_sequence_pipeline(s) == NULL);
+
+	ret = msh_sequence_parse("again", s);
+	SUNIT_ASSERT("second input parsed", ret == 0);
+	p = msh_sequence_pipeline(s);
+	SUNIT_ASSERT("again pipeline", p != NULL);
+	SUNIT_ASSERT("again command program", strcmp(msh_command_program(msh_pipeline_command(p, 0)), "again") == 0);
+	msh_pipeline_free(p);
+	SUNIT_ASSERT("sequence is empty again", msh_sequence_pipeline(s) == NULL);
+
+	msh_sequence_free(s);
+
+	return SUNIT_SUCCESS;
+}
+
 int
 main(void)
 {
 	struct sunit_test tests[] = {
 		SUNIT_TEST("simple sequences", seq),
 		SUNIT_TEST("sequence of pipelines", seq_pline),
+		SUNIT_TEST("sequence reused for the next input", seq_reuse),
 		SUNIT_TEST_TERM
 	};
 
@@ -1,12 +1,46 @@
 #include <sunit.h>
 #include <msh_parse.h>
 
+#include <stdlib.h>
 #include <string.h>
 
+/* parse an input, which must leave the sequence empty if it is erroneous */
+static int
+parse_err(const char *input, msh_err_t expected, size_t expected_pos)
+{
+	struct msh_sequence *s;
+	struct msh_pipeline *p;
+	char *str = strdup(input);
+	msh_err_t ret;
+	size_t pos;
+	int ok;
+
+	s = msh_sequence_alloc();
+	if (s == NULL || str == NULL) return 0;
+	ret = msh_sequence_parse(str, s);
+	p = msh_sequence_pipeline(s);
+	ok = ret == expected && msh_sequence_error(s, &pos) == expected && pos == expected_pos && (p == NULL) == (expected != 0);
+	if (p != NULL) msh_pipeline_free(p);
+	msh_sequence_free(s);
+	free(str);
+
+	return ok;
+}
+
 sunit_ret_t
-nocmd(void)
+nocmd_after(void)
 {
-	/* add your own tests here. */
+	SUNIT_ASSERT("| at the end", parse_err("hello |", MSH_ERR_PIPE_MISSING_CMD, 0));
+	SUNIT_ASSERT("| with only spaces after", parse_err("ok ; hello | world |  | a", MSH_ERR_PIPE_MISSING_CMD, 20));
+
+	return 0;
+}
+
+sunit_ret_t
+nocmd_before(void)
+{
+	SUNIT_ASSERT("| at the start", parse_err("  | hello", MSH_ERR_PIPE_MISSING_CMD, 0));
+	SUNIT_ASSERT("| at the start of a later pipeline", parse_err("a ;| hello", MSH_ERR_PIPE_MISSING_CMD, 3));
 
 	return 0;
 }
@@ -14,7 +48,12 @@ nocmd(void)
 sunit_ret_t
 too_many_cmd(void)
 {
-	/* add your own tests here. */
+	char input[4 * (MSH_MAXCMNDS + 1)] = "a";
+
+	for (int i = 0; i < MSH_MAXCMNDS; i++) strcat(input, " | a");
+	SUNIT_ASSERT("MSH_MAXCMNDS + 1 commands", parse_err(input, MSH_ERR_TOO_MANY_CMDS, 4 * MSH_MAXCMNDS - 1));
+	input[strlen(input) - 4] = '\0';
+	SUNIT_ASSERT("MSH_MAXCMNDS commands parse", parse_err(input, 0, 0));
 
 	return 0;
 }
@@ -22,7 +61,20 @@ too_many_cmd(void)
 sunit_ret_t
 too_many_args(void)
 {
-	/* add your own tests here. */
+	char input[2 * (MSH_MAXARGS + 3)] = "a";
+
+	for (int i = 0; i < MSH_MAXARGS + 1; i++) strcat(input, " b");
+	SUNIT_ASSERT("MSH_MAXARGS + 1 arguments", parse_err(input, MSH_ERR_TOO_MANY_ARGS, 2 * (MSH_MAXARGS + 1)));
+	input[strlen(input) - 2] = '\0';
+	SUNIT_ASSERT("MSH_MAXARGS arguments parse", parse_err(input, 0, 0));
+
+	return 0;
+}
+
+sunit_ret_t
+misused_background(void)
+{
+	SUNIT_ASSERT("& before the end", parse_err("sleep 1 & ; ls & b", MSH_ERR_MISUSED_BACKGROUND, 8));
 
 	return 0;
 }
@@ -31,10 +83,11 @@ int
 main(void)
 {
 	struct sunit_test tests[] = {
-		SUNIT_TEST("pipeline with no command after |", nocmd),
-		SUNIT_TEST("pipeline with no command before |", nocmd),
+		SUNIT_TEST("pipeline with no command after |", nocmd_after),
+		SUNIT_TEST("pipeline with no command before |", nocmd_before),
 		SUNIT_TEST("too many commands", too_many_cmd),
 		SUNIT_TEST("too many args", too_many_args),
+		SUNIT_TEST("& not ending a pipeline", misused_background),
 		/* add your own tests here... */
 		SUNIT_TEST_TERM
 	};